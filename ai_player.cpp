@@ -0,0 +1,90 @@
+#include "ai_player.h"
+
+AiPlayer::AiPlayer(char seat, bool b_is_pre_committing,
+    int32_t search_budget_ms, int32_t search_threads,
+    std::shared_ptr<const PolicyTable> policy)
+    : seat{seat}, b_is_pre_committing{b_is_pre_committing}, model{},
+    search{search_budget_ms > 0 ? std::make_unique<MonteCarlo>(
+    search_budget_ms, search_threads) : nullptr}, policy{std::move(policy)},
+    deal_type{0},
+    trick_number{1}, got_score{false}, got_total{false} {}
+
+int16_t AiPlayer::get_trick_number() const { return trick_number; }
+
+bool AiPlayer::is_finished() const { return got_score && got_total; }
+
+void AiPlayer::report_search(std::ostream& stream) const
+{
+    if (search) { search->report(stream); }
+}
+
+string AiPlayer::handle_message(const frames::Message& message)
+{
+    if ((message.type == frames::Type::TAKEN_FRAME ||
+        message.type == frames::Type::TRICK_FRAME) &&
+        message.number != trick_number) { return ""; }
+
+    switch (message.type)
+    {
+        case frames::Type::DEAL_FRAME:
+            deal_type = message.number;
+            trick_number = 1;
+            got_score = false;
+            got_total = false;
+            model.deal(seating::from_char(seat), message.cards,
+                message.seat);
+            return pre_commit(seating::to_char(message.seat) == seat);
+        case frames::Type::TAKEN_FRAME:
+            model.taken(message.cards, message.seat);
+            ++trick_number;
+            return pre_commit(seating::to_char(message.seat) == seat);
+        case frames::Type::SCORE_FRAME:
+            got_score = true;
+            return "";
+        case frames::Type::TOTAL_FRAME:
+            got_total = true;
+            return "";
+        case frames::Type::TRICK_FRAME:
+            model.trick(message.cards);
+            return strategy();
+        default:
+            return "";
+    }
+}
+
+string AiPlayer::strategy()
+{
+    uint8_t card = model.first_dealt(model.get_led_suit());
+    if (card == NO_CARD) { card = model.last_dealt(); }
+    card_set_t hand = model.get_hand();
+    uint8_t led_suit = model.get_led_suit();
+    // Leads, or cannot follow.
+    if (policy && (hand & CardModel::suit_cards(led_suit)) == 0)
+    {
+        PolicyTable::Decision decision = model.get_table().empty() ?
+            PolicyTable::Decision::LEAD : PolicyTable::Decision::DISCARD;
+        uint8_t suit = policy->lookup(deal_type, decision, hand);
+        uint8_t policy_card = suit == PolicyTable::NO_POLICY ? NO_CARD :
+            PolicyTable::policy_card(decision, hand, suit);
+        if (policy_card != NO_CARD) { card = policy_card; }
+    }
+    if (search)
+    {
+        card = search->choose(model, deal_type, trick_number, card);
+    }
+    char result[4];
+    if (!frames::decode_card(card, result)) { return ""; }
+    return result;
+}
+
+string AiPlayer::pre_commit(bool b_leads)
+{
+    card_set_t hand = model.get_hand();
+    // A searched lead would hold the answer to the TRICK that comes at
+    // once anyway; only the last card is sent ahead then.
+    bool b_is_forced = (hand & (hand - 1)) == 0;
+    if (!b_is_pre_committing || hand == 0 || trick_number > 13 ||
+        (!b_is_forced && (!b_leads || search))) { return ""; }
+    // Nobody played yet, so it is the card of the strategy.
+    return strategy();
+}
@@ -0,0 +1,82 @@
+#ifndef AI_PLAYER_H
+#define AI_PLAYER_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "card_model.h"
+#include "frames.h"
+#include "monte_carlo.h"
+#include "policy_table.h"
+
+using std::string;
+
+/*
+* Game state and play of one AI seat, without any I/O: it takes the
+* decoded messages of the server and tells which card to send back, so one
+* thread can drive any number of seats. Plays the first card of the led
+* color dealt, otherwise the last card dealt that is still in the hand;
+* given a policy table, it leads and throws cards away as the table says
+* where it has an entry, and given a search budget, it plays what
+* MonteCarlo finds instead.
+*/
+class AiPlayer
+{
+public:
+    AiPlayer() = delete;
+    AiPlayer(char seat, bool b_is_pre_committing,
+        int32_t search_budget_ms = 0, int32_t search_threads = 0,
+        std::shared_ptr<const PolicyTable> policy = nullptr);
+    ~AiPlayer() = default;
+    AiPlayer(AiPlayer&&) = default;
+    AiPlayer& operator=(AiPlayer&&) = default;
+
+    /*
+    * Updates the game with a message from the server. Returns the card
+    * to send in a TRICK of get_trick_number(), empty if there is none:
+    * the answer to a TRICK, or a pre-commit (PRE capability) after DEAL
+    * and TAKEN. TRICK and TAKEN of another trick are ignored.
+    */
+    string handle_message(const frames::Message& message);
+
+    int16_t get_trick_number() const;
+
+    /*
+    * Checks if SCORE and TOTAL of the deal came, after which the server
+    * may close the connection.
+    */
+    bool is_finished() const;
+
+    /*
+    * Writes the statistics of the search, if the AI searches.
+    */
+    void report_search(std::ostream& stream) const;
+
+private:
+    /*
+    * Picks the card to play in the current trick.
+    */
+    string strategy();
+
+    /*
+    * The card the AI plays in the current trick when it does not depend
+    * on the table: it leads or has one card left. It stays in hand.
+    */
+    string pre_commit(bool b_leads);
+
+    char seat;
+    bool b_is_pre_committing;
+
+    CardModel model;
+    std::unique_ptr<MonteCarlo> search;
+    std::shared_ptr<const PolicyTable> policy;
+    int16_t deal_type;
+    int16_t trick_number;
+
+    bool got_score;
+    bool got_total;
+};
+
+#endif // AI_PLAYER_H
@@ -0,0 +1,181 @@
+#include "alloc_stats.h"
+
+#include <atomic>
+#include <array>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+
+using std::array;
+using std::atomic;
+using std::memory_order_relaxed;
+
+namespace
+{
+    // Plain thread-locals, so counting never allocates or locks.
+    thread_local uint64_t thread_allocations = 0;
+    thread_local uint64_t thread_bytes = 0;
+
+    atomic<uint64_t> process_allocations{0};
+    atomic<uint64_t> process_bytes{0};
+
+    struct ScopeStats
+    {
+        atomic<uint64_t> events{0};
+        atomic<uint64_t> allocations{0};
+        atomic<uint64_t> bytes{0};
+        atomic<uint64_t> max_allocations{0};
+    };
+
+    array<ScopeStats, static_cast<size_t>(alloc_stats::Scope::COUNT)> scopes;
+
+    const char* scope_names[] = {"send IAM", "send BUSY", "send DEAL",
+        "send TRICK", "send WRONG", "send TAKEN", "send SCORE",
+        "send TOTAL", "receive", "log line", "trick", "deal"};
+
+    static_assert(sizeof(scope_names) / sizeof(scope_names[0]) ==
+        static_cast<size_t>(alloc_stats::Scope::COUNT));
+
+    [[maybe_unused]] void count(size_t size)
+    {
+        ++thread_allocations;
+        thread_bytes += size;
+        process_allocations.fetch_add(1, memory_order_relaxed);
+        process_bytes.fetch_add(size, memory_order_relaxed);
+    }
+} // namespace
+
+alloc_stats::Counters alloc_stats::thread_counters()
+{
+    return {thread_allocations, thread_bytes};
+}
+
+alloc_stats::Counters alloc_stats::process_counters()
+{
+    return {process_allocations.load(memory_order_relaxed),
+        process_bytes.load(memory_order_relaxed)};
+}
+
+void alloc_stats::record(Scope scope, const Counters& delta)
+{
+    ScopeStats& stats = scopes[static_cast<size_t>(scope)];
+    stats.events.fetch_add(1, memory_order_relaxed);
+    stats.allocations.fetch_add(delta.allocations, memory_order_relaxed);
+    stats.bytes.fetch_add(delta.bytes, memory_order_relaxed);
+    uint64_t max = stats.max_allocations.load(memory_order_relaxed);
+    while (delta.allocations > max && !stats.max_allocations
+        .compare_exchange_weak(max, delta.allocations, memory_order_relaxed))
+    {}
+}
+
+void alloc_stats::dump(std::ostream& out)
+{
+    // snprintf to a stack buffer, so the dump itself does not allocate.
+    char line[128];
+    out << "Heap allocations (per event averages):\n";
+    snprintf(line, sizeof(line), "%-12s %10s %12s %12s %10s\n", "scope",
+        "events", "allocs", "bytes", "max allocs");
+    out << line;
+    for (size_t i = 0; i < scopes.size(); ++i)
+    {
+        uint64_t events = scopes[i].events.load(memory_order_relaxed);
+        if (events == 0) { continue; }
+        snprintf(line, sizeof(line), "%-12s %10lu %12.2f %12.2f %10lu\n",
+            scope_names[i], events,
+            (double)scopes[i].allocations.load(memory_order_relaxed) / events,
+            (double)scopes[i].bytes.load(memory_order_relaxed) / events,
+            scopes[i].max_allocations.load(memory_order_relaxed));
+        out << line;
+    }
+    Counters total = process_counters();
+    snprintf(line, sizeof(line), "%-12s %10s %12lu %12lu\n", "process", "",
+        total.allocations, total.bytes);
+    out << line;
+}
+
+alloc_stats::ThreadScope::ThreadScope(Scope scope)
+    : scope{scope}, start{thread_counters()} {}
+
+alloc_stats::ThreadScope::~ThreadScope()
+{
+    Counters end = thread_counters();
+    record(scope, {end.allocations - start.allocations,
+        end.bytes - start.bytes});
+}
+
+alloc_stats::ProcessScope::ProcessScope(Scope scope)
+    : scope{scope}, start{process_counters()} {}
+
+alloc_stats::ProcessScope::~ProcessScope()
+{
+    Counters end = process_counters();
+    record(scope, {end.allocations - start.allocations,
+        end.bytes - start.bytes});
+}
+
+#ifdef ALLOC_STATS
+
+void* operator new(size_t size)
+{
+    count(size);
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) { throw std::bad_alloc(); }
+    return pointer;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    count(size);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    count(size);
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, static_cast<size_t>(alignment),
+        size == 0 ? 1 : size) != 0) { throw std::bad_alloc(); }
+    return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+
+void operator delete[](void* pointer) noexcept { free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    free(pointer);
+}
+
+#endif // ALLOC_STATS
@@ -0,0 +1,106 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+
+/*
+* Heap allocation counting, compiled in only with -DALLOC_STATS
+* (make ALLOC_STATS=1). The build replaces the global operator new and
+* delete with versions that count allocations in thread-local and
+* process-wide counters. Scopes below attribute the counted allocations
+* to protocol messages, tricks and deals; without ALLOC_STATS the scope
+* macros expand to nothing.
+*/
+namespace alloc_stats
+{
+    struct Counters
+    {
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    /*
+    * What a measured piece of code is doing.
+    */
+    enum class Scope : uint8_t
+    {
+        SEND_IAM,
+        SEND_BUSY,
+        SEND_DEAL,
+        SEND_TRICK,
+        SEND_WRONG,
+        SEND_TAKEN,
+        SEND_SCORE,
+        SEND_TOTAL,
+        RECEIVE,     // reading and parsing a client message
+        LOG,         // one line of the message log
+        PER_TRICK,   // whole trick, all threads
+        PER_DEAL,    // whole deal, all threads
+        COUNT
+    };
+
+    /*
+    * Allocations made by the calling thread since it started.
+    */
+    Counters thread_counters();
+
+    /*
+    * Allocations made by all threads since the process started.
+    */
+    Counters process_counters();
+
+    /*
+    * Adds one occurrence of the scope that made the given allocations.
+    */
+    void record(Scope scope, const Counters& delta);
+
+    /*
+    * Prints the statistics of every scope that occurred at least once.
+    */
+    void dump(std::ostream& out);
+
+    /*
+    * Records allocations made by the current thread during its lifetime.
+    */
+    class ThreadScope
+    {
+    public:
+        explicit ThreadScope(Scope scope);
+        ~ThreadScope();
+
+    private:
+        Scope scope;
+        Counters start;
+    };
+
+    /*
+    * Records allocations made by all threads during its lifetime.
+    */
+    class ProcessScope
+    {
+    public:
+        explicit ProcessScope(Scope scope);
+        ~ProcessScope();
+
+    private:
+        Scope scope;
+        Counters start;
+    };
+} // namespace alloc_stats
+
+#define ALLOC_STATS_CONCAT_(a, b) a##b
+#define ALLOC_STATS_CONCAT(a, b) ALLOC_STATS_CONCAT_(a, b)
+
+#ifdef ALLOC_STATS
+#define ALLOC_STATS_THREAD_SCOPE(scope) alloc_stats::ThreadScope \
+    ALLOC_STATS_CONCAT(alloc_stats_scope_, __LINE__){scope}
+#define ALLOC_STATS_PROCESS_SCOPE(scope) alloc_stats::ProcessScope \
+    ALLOC_STATS_CONCAT(alloc_stats_scope_, __LINE__){scope}
+#else
+#define ALLOC_STATS_THREAD_SCOPE(scope)
+#define ALLOC_STATS_PROCESS_SCOPE(scope)
+#endif
+
+#endif // ALLOC_STATS_H
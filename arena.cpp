@@ -0,0 +1,234 @@
+#include "arena.h"
+
+#include <cmath>
+#include <random>
+
+#include "ai_player.h"
+#include "common.h"
+#include "frames.h"
+#include "seat.h"
+
+namespace
+{
+    constexpr double ELO_START = 1500;
+    // Small, as ratings come from millions of games.
+    constexpr double ELO_K = 2;
+    // Of the normal distribution, for a 95% interval.
+    constexpr double Z_95 = 1.96;
+
+    uint64_t mix(uint64_t value)
+    {
+        // splitmix64.
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    string card_text(uint8_t card)
+    {
+        char text[4];
+        frames::decode_card(card, text);
+        return text;
+    }
+
+    /*
+    * The card the player answered with if the server would take it,
+    * otherwise the first card it may play (and an error is printed).
+    */
+    uint8_t legal_card(const string& answer, card_set_t hand,
+        uint8_t led_suit)
+    {
+        card_set_t following = hand & CardModel::suit_cards(led_suit);
+        card_set_t legal = following != 0 ? following : hand;
+        uint8_t card = frames::encode_card(answer);
+        if (card < NO_CARD && (legal & (1ULL << card)) != 0) { return card; }
+        common::print_error("A strategy played " + answer +
+            ", which the server would not take.");
+        return __builtin_ctzll(legal);
+    }
+
+    /*
+    * Plays the deal with an AiPlayer of the strategy of every seat,
+    * telling them what the server would. Returns the points of the
+    * seats.
+    */
+    array<int32_t, 4> play_deal(const array<uint8_t, NO_CARD>& deck,
+        Seat first, int16_t deal_type,
+        const array<const arena::Strategy*, 4>& strategies)
+    {
+        vector<AiPlayer> players;
+        players.reserve(4);
+        array<card_set_t, 4> hands{};
+        frames::Message message{};
+        message.type = frames::Type::DEAL_FRAME;
+        message.number = deal_type;
+        message.seat = first;
+        for (Seat seat : seating::ALL_SEATS)
+        {
+            size_t index = seating::index(seat);
+            message.cards.clear();
+            for (size_t i = 0; i < 13; ++i)
+            {
+                uint8_t card = deck[index * 13 + i];
+                hands[index] |= 1ULL << card;
+                message.cards.push_back(card_text(card));
+            }
+            const arena::Strategy& strategy = *strategies[index];
+            // Pre-commits would only repeat the answers to TRICK.
+            players.emplace_back(seating::to_char(seat), false,
+                strategy.search_budget_ms, 1, strategy.policy);
+            players[index].handle_message(message);
+        }
+
+        array<int32_t, 4> points{};
+        Seat leader = first;
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            message.number = trick;
+            message.cards.clear();
+            card_set_t table = 0;
+            uint8_t led_suit = 4;
+            uint8_t top = NO_CARD;
+            Seat taker = leader;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                Seat seat = seating::next(leader, i);
+                size_t index = seating::index(seat);
+                message.type = frames::Type::TRICK_FRAME;
+                uint8_t card = legal_card(players[index].handle_message(
+                    message), hands[index], led_suit);
+                hands[index] &= ~(1ULL << card);
+                message.cards.push_back(card_text(card));
+                table |= 1ULL << card;
+                if (i == 0) { led_suit = card % 4; }
+                // Cards of a suit grow with the rank.
+                if (card % 4 == led_suit && (top == NO_CARD || card > top))
+                {
+                    top = card;
+                    taker = seat;
+                }
+            }
+            points[seating::index(taker)] += CardModel::trick_points(
+                deal_type, trick, table);
+            message.type = frames::Type::TAKEN_FRAME;
+            message.seat = taker;
+            for (AiPlayer& player : players)
+            {
+                player.handle_message(message);
+            }
+            leader = taker;
+        }
+        return points;
+    }
+} // namespace
+
+vector<arena::Strategy> arena::strategies(
+    std::shared_ptr<const PolicyTable> policy, int32_t search_budget_ms)
+{
+    vector<Strategy> result{{"ai", 0, nullptr}};
+    if (policy) { result.push_back({"policy", 0, policy}); }
+    if (search_budget_ms > 0)
+    {
+        result.push_back({"search", search_budget_ms, nullptr});
+    }
+    return result;
+}
+
+arena::Ratings::Ratings(size_t entrants)
+    : ratings(entrants, Rating{0, 0, 0, ELO_START}), tables{0} {}
+
+void arena::Ratings::update(const array<array<size_t, 4>, 4>& seats,
+    const array<array<int32_t, 4>, 4>& points)
+{
+    ProfiledLock lock(mutex);
+    for (size_t play = 0; play < seats.size(); ++play)
+    {
+        add_play(seats[play], points[play]);
+    }
+    ++tables;
+}
+
+uint64_t arena::Ratings::get_tables()
+{
+    ProfiledLock lock(mutex);
+    return tables;
+}
+
+void arena::Ratings::add_play(const array<size_t, 4>& seats,
+    const array<int32_t, 4>& points)
+{
+    double table_mean =
+        (points[0] + points[1] + points[2] + points[3]) / 4.0;
+    for (size_t seat = 0; seat < 4; ++seat)
+    {
+        Rating& rating = ratings[seats[seat]];
+        double value = points[seat] - table_mean;
+        ++rating.plays;
+        double delta = value - rating.mean;
+        rating.mean += delta / rating.plays;
+        rating.m2 += delta * (value - rating.mean);
+    }
+    for (size_t a = 0; a < 4; ++a)
+    {
+        for (size_t b = a + 1; b < 4; ++b)
+        {
+            if (seats[a] == seats[b]) { continue; }
+            Rating& first = ratings[seats[a]];
+            Rating& second = ratings[seats[b]];
+            double expected = 1 /
+                (1 + std::pow(10, (second.elo - first.elo) / 400));
+            double score = points[a] < points[b] ? 1 :
+                points[a] == points[b] ? 0.5 : 0;
+            first.elo += ELO_K * (score - expected);
+            second.elo -= ELO_K * (score - expected);
+        }
+    }
+}
+
+void arena::Ratings::report(std::ostream& stream,
+    span<const Strategy> entrants)
+{
+    ProfiledLock lock(mutex);
+    for (size_t i = 0; i < ratings.size(); ++i)
+    {
+        const Rating& rating = ratings[i];
+        double interval = rating.plays > 1 ? Z_95 *
+            std::sqrt(rating.m2 / (rating.plays - 1) / rating.plays) : 0;
+        stream << "{\"strategy\":\"" << entrants[i].name
+            << "\",\"plays\":" << rating.plays << ",\"mean\":"
+            << rating.mean << ",\"ci95\":[" << rating.mean - interval
+            << "," << rating.mean + interval << "],\"elo\":" << rating.elo
+            << "}\n";
+    }
+}
+
+void arena::play_table(span<const Strategy> entrants, int16_t deal_type,
+    uint64_t seed, uint64_t table, Ratings& ratings)
+{
+    std::mt19937_64 random(mix(seed ^ mix(table)));
+    array<uint8_t, NO_CARD> deck;
+    for (uint8_t card = 0; card < NO_CARD; ++card) { deck[card] = card; }
+    for (size_t i = NO_CARD - 1; i > 0; --i)
+    {
+        std::swap(deck[i], deck[random() % (i + 1)]);
+    }
+    int16_t type = deal_type != 0 ? deal_type : 1 + random() % 7;
+    Seat first = seating::ALL_SEATS[random() % 4];
+    array<size_t, 4> lineup;
+    for (size_t& entrant : lineup) { entrant = random() % entrants.size(); }
+
+    array<array<size_t, 4>, 4> seats;
+    array<array<int32_t, 4>, 4> points;
+    for (size_t shift = 0; shift < 4; ++shift)
+    {
+        array<const Strategy*, 4> strategies;
+        for (size_t seat = 0; seat < 4; ++seat)
+        {
+            seats[shift][seat] = lineup[(seat + shift) % 4];
+            strategies[seat] = &entrants[seats[shift][seat]];
+        }
+        points[shift] = play_deal(deck, first, type, strategies);
+    }
+    ratings.update(seats, points);
+}
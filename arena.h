@@ -0,0 +1,119 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "card_model.h"
+#include "lock_stats.h"
+#include "policy_table.h"
+
+using std::array;
+using std::span;
+using std::string;
+using std::vector;
+
+/*
+* Tournament of the strategies of the AI client over seeded random deals.
+* Every entrant is an AiPlayer set up as kierki-klient sets it up, fed at
+* its seat the messages the server would send it (DEAL, TRICK, TAKEN), so
+* the code rated is the code that plays. Every table deals one deal and
+* draws four of the entrants, with repeats, to its seats; the deal is
+* then played four times, the entrants moved one seat on each time, so
+* every entrant plays every hand. Points are counted by the scoring of
+* the server (CardModel::trick_points, which counts as PointsCalculator
+* does).
+*/
+namespace arena
+{
+    /*
+    * Set-up of the AI of the client, as its options give it.
+    */
+    struct Strategy
+    {
+        string name;
+        // Search budget of a move for MonteCarlo (-t), 0 for no search.
+        int32_t search_budget_ms;
+        // Table of leads and discards (-L), if any.
+        std::shared_ptr<const PolicyTable> policy;
+    };
+
+    /*
+    * Every strategy that can enter: ai plays as the AI with no options
+    * (the bot of the server plays the same cards), policy with the
+    * table if there is one, search with MonteCarlo if the budget is
+    * positive. The search runs on the thread of the table.
+    */
+    vector<Strategy> strategies(std::shared_ptr<const PolicyTable> policy,
+        int32_t search_budget_ms);
+
+    /*
+    * Ratings of the entrants, updated by every table as it ends, with
+    * no history kept. For every entrant:
+    * - the mean, and its variance (Welford), of the points it took in a
+    *   deal less the mean of the four seats, so deal types compare;
+    * - an Elo rating from every pair of seats of different entrants
+    *   (fewer points wins), in the order the tables end.
+    * Thread-safe.
+    */
+    class Ratings
+    {
+    public:
+        Ratings() = delete;
+        explicit Ratings(size_t entrants);
+        ~Ratings() = default;
+
+        /*
+        * Adds the plays of a table: the entrant and the points of every
+        * seat in each play.
+        */
+        void update(const array<array<size_t, 4>, 4>& seats,
+            const array<array<int32_t, 4>, 4>& points);
+
+        /*
+        * Tables added so far.
+        */
+        uint64_t get_tables();
+
+        /*
+        * Writes a JSON line per entrant: plays, the mean with its 95%
+        * confidence interval and the Elo rating.
+        */
+        void report(std::ostream& stream, span<const Strategy> entrants);
+
+    private:
+        struct Rating
+        {
+            uint64_t plays;
+            double mean;
+            double m2;
+            double elo;
+        };
+
+        /*
+        * Adds one play of a deal; the mutex is held.
+        */
+        void add_play(const array<size_t, 4>& seats,
+            const array<int32_t, 4>& points);
+
+        ProfiledMutex mutex;
+        vector<Rating> ratings;
+        uint64_t tables;
+    };
+
+    /*
+    * Plays table number table of the tournament with the seed; deal_type
+    * 0 draws the type of every table. The same seed, table and entrants
+    * give the same deal and seats, and the same points unless an entrant
+    * searches: the search depends on the time it gets.
+    */
+    void play_table(span<const Strategy> entrants, int16_t deal_type,
+        uint64_t seed, uint64_t table, Ratings& ratings);
+} // namespace arena
+
+#endif // ARENA_H
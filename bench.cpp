@@ -0,0 +1,28 @@
+#include "bench.h"
+
+#include <cstdio>
+
+void bench::Runner::report(std::ostream& out) const
+{
+    char line[256];
+    out << "{\"unit\":\"ns/op\",\"benchmarks\":[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        snprintf(line, sizeof(line), "{\"name\":\"%s\",\"iterations\":%lu,"
+            "\"ops_per_iteration\":%lu,\"median\":%.2f,\"min\":%.2f,"
+            "\"max\":%.2f,\"ops_per_s\":%.0f", result.name.c_str(),
+            result.iterations, result.operations, result.median_ns,
+            result.min_ns, result.max_ns,
+            result.median_ns > 0 ? 1e9 / result.median_ns : 0.0);
+        out << line;
+        if (result.bytes > 0)
+        {
+            snprintf(line, sizeof(line), ",\"bytes_per_op\":%.2f",
+                (double)result.bytes / result.operations);
+            out << line;
+        }
+        out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+}
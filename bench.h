@@ -0,0 +1,111 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/*
+* Minimal microbenchmark harness. Every benchmark is a callable run in a
+* loop; the loop length is calibrated so one sample takes about the given
+* time, and the reported cost is the median (plus min and max) of several
+* samples. Results are printed as JSON, so runs can be compared by scripts.
+*/
+namespace bench
+{
+    /*
+    * Keeps the compiler from optimizing away a computed value.
+    */
+    template<typename T>
+    inline void do_not_optimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    struct Result
+    {
+        string name;
+        uint64_t iterations;  // calls of the body per sample
+        uint64_t operations;  // per call of the body
+        double median_ns;     // per operation
+        double min_ns;
+        double max_ns;
+        uint64_t bytes;       // on the wire per call of the body, 0 if none
+    };
+
+    class Runner
+    {
+    public:
+        Runner() = delete;
+        Runner(const string& filter, int32_t sample_time, int32_t samples)
+            : filter{filter}, sample_time{sample_time * 1000000ll},
+            samples{samples}, results{} {}
+        ~Runner() = default;
+
+        /*
+        * Runs the benchmark unless its name does not contain the filter.
+        * One call of the body counts as the given number of operations
+        * and, if it is not 0, moves the given number of bytes.
+        */
+        template<typename F>
+        void run(const string& name, F&& body, uint64_t operations = 1,
+            uint64_t bytes = 0)
+        {
+            if (name.find(filter) == string::npos) { return; }
+
+            uint64_t iterations = 1;
+            for (;;)
+            {
+                int64_t elapsed = measure(body, iterations);
+                if (elapsed >= sample_time || iterations >= (1ull << 40))
+                {
+                    break;
+                }
+                // Aim a bit above the sample time to need few rounds.
+                uint64_t next = elapsed <= 0 ? iterations * 100 :
+                    iterations * 1.2 * sample_time / elapsed;
+                iterations = std::max(iterations * 2, next);
+            }
+
+            vector<double> per_operation;
+            for (int32_t i = 0; i < samples; ++i)
+            {
+                per_operation.push_back((double)measure(body, iterations) /
+                    (iterations * operations));
+            }
+            std::sort(per_operation.begin(), per_operation.end());
+            results.push_back(Result{name, iterations, operations,
+                per_operation[per_operation.size() / 2],
+                per_operation.front(), per_operation.back(), bytes});
+        }
+
+        /*
+        * Prints all the results as one JSON object.
+        */
+        void report(std::ostream& out) const;
+
+    private:
+        template<typename F>
+        static int64_t measure(F& body, uint64_t iterations)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) { body(); }
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>
+                (end - start).count();
+        }
+
+        string filter;
+        int64_t sample_time; // ns
+        int32_t samples;
+        vector<Result> results;
+    };
+} // namespace bench
+
+#endif // BENCH_H
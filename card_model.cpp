@@ -0,0 +1,178 @@
+#include "card_model.h"
+
+#include "frames.h"
+
+namespace
+{
+    // Bits of the clubs; the other suits are this shifted by the suit.
+    constexpr card_set_t CLUBS = 0x1111111111111ULL;
+    // Bits of the four cards of a rank, shifted by 4 * rank.
+    constexpr card_set_t RANK = 0xFULL;
+    constexpr card_set_t HEARTS = CLUBS << 2;
+    constexpr card_set_t QUEENS = RANK << (4 * 10);
+    constexpr card_set_t MISTERS = (RANK << (4 * 9)) | (RANK << (4 * 11));
+    constexpr card_set_t KING_OF_HEARTS = 1ULL << (4 * 11 + 2);
+    constexpr uint8_t NO_SUIT = 4;
+} // namespace
+
+CardModel::CardModel()
+    : seat{Seat::NONE}, hand{0}, played{0}, voids{}, leader{Seat::NONE},
+    led_suit{NO_SUIT}, table{}, on_table{0}, positions{}, suit_positions{},
+    dealt{}, hand_positions{0} {}
+
+uint8_t CardModel::suit_index(char suit)
+{
+    switch (suit)
+    {
+        case 'C': return 0;
+        case 'D': return 1;
+        case 'H': return 2;
+        case 'S': return 3;
+        default: return NO_SUIT;
+    }
+}
+
+card_set_t CardModel::suit_cards(uint8_t suit)
+{
+    return suit < NO_SUIT ? CLUBS << suit : 0;
+}
+
+uint8_t CardModel::top_card(card_set_t cards, uint8_t suit)
+{
+    card_set_t held = cards & suit_cards(suit);
+    if (held == 0) { return NO_CARD; }
+    return 63 - __builtin_clzll(held);
+}
+
+int32_t CardModel::trick_points(int16_t deal_type, int16_t trick,
+    card_set_t cards)
+{
+    switch (deal_type)
+    {
+        case 1: return 1;
+        case 2: return __builtin_popcountll(cards & HEARTS);
+        case 3: return 5 * __builtin_popcountll(cards & QUEENS);
+        case 4: return 2 * __builtin_popcountll(cards & MISTERS);
+        case 5: return (cards & KING_OF_HEARTS) ? 18 : 0;
+        // 10 for each of the four cards.
+        case 6: return trick == 7 || trick == 13 ? 40 : 0;
+        case 7:
+        {
+            int32_t points = 0;
+            for (int16_t type = 1; type <= 6; ++type)
+            {
+                points += trick_points(type, trick, cards);
+            }
+            return points;
+        }
+        default: return -1;
+    }
+}
+
+size_t CardModel::bot_position(span<const uint8_t> hand, uint8_t led_suit)
+{
+    for (size_t i = 0; i < hand.size(); ++i)
+    {
+        if (hand[i] % 4 == led_suit) { return i; }
+    }
+    return hand.size() - 1;
+}
+
+void CardModel::deal(Seat seat, span<const string> cards, Seat first)
+{
+    this->seat = seat;
+    hand = 0;
+    played = 0;
+    voids.fill(0);
+    leader = first;
+    led_suit = NO_SUIT;
+    on_table = 0;
+    suit_positions.fill(0);
+    hand_positions = 0;
+    for (size_t i = 0; i < cards.size() && i < dealt.size(); ++i)
+    {
+        uint8_t card = frames::encode_card(cards[i]);
+        if (card == NO_CARD) { continue; }
+        hand |= 1ULL << card;
+        positions[card] = i;
+        dealt[i] = card;
+        suit_positions[card % 4] |= 1 << i;
+        hand_positions |= 1 << i;
+    }
+}
+
+void CardModel::trick(span<const string> cards)
+{
+    for (size_t i = on_table; i < cards.size() && i < 4; ++i)
+    {
+        play(seating::next(leader, i), frames::encode_card(cards[i]));
+    }
+}
+
+void CardModel::taken(span<const string> cards, Seat taker)
+{
+    for (size_t i = on_table; i < cards.size() && i < 4; ++i)
+    {
+        play(seating::next(leader, i), frames::encode_card(cards[i]));
+    }
+    leader = taker;
+    led_suit = NO_SUIT;
+    on_table = 0;
+}
+
+Seat CardModel::get_seat() const { return seat; }
+
+card_set_t CardModel::get_hand() const { return hand; }
+
+card_set_t CardModel::get_played() const { return played; }
+
+card_set_t CardModel::get_out() const
+{
+    return ~(hand | played) & ((1ULL << NO_CARD) - 1);
+}
+
+uint8_t CardModel::get_led_suit() const { return led_suit; }
+
+Seat CardModel::get_leader() const { return leader; }
+
+span<const uint8_t> CardModel::get_table() const
+{
+    return {table.data(), on_table};
+}
+
+bool CardModel::is_void(Seat seat, uint8_t suit) const
+{
+    return (voids[seating::index(seat)] >> suit) & 1;
+}
+
+uint8_t CardModel::first_dealt(uint8_t suit) const
+{
+    if (suit >= NO_SUIT) { return NO_CARD; }
+    uint16_t held = hand_positions & suit_positions[suit];
+    if (held == 0) { return NO_CARD; }
+    return dealt[__builtin_ctz(held)];
+}
+
+uint8_t CardModel::last_dealt() const
+{
+    if (hand_positions == 0) { return NO_CARD; }
+    return dealt[31 - __builtin_clz(hand_positions)];
+}
+
+void CardModel::play(Seat seat, uint8_t card)
+{
+    table[on_table++] = card;
+    if (card == NO_CARD) { return; }
+    uint8_t suit = card % 4;
+    if (led_suit == NO_SUIT) { led_suit = suit; }
+    else if (suit != led_suit)
+    {
+        voids[seating::index(seat)] |= 1 << led_suit;
+    }
+    played |= 1ULL << card;
+    if (hand & (1ULL << card))
+    {
+        hand &= ~(1ULL << card);
+        hand_positions &= ~(1 << positions[card]);
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef CARD_MODEL_H
+#define CARD_MODEL_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "seat.h"
+
+using std::array;
+using std::span;
+using std::string;
+
+// Set of cards, bit i is the card of byte i of the frames (rank * 4 + suit,
+// suits in the order C, D, H, S).
+typedef uint64_t card_set_t;
+
+// No card, as frames::encode_card tells it.
+#define NO_CARD 52
+
+/*
+* What one seat knows of a deal, kept as card sets: its hand, the cards
+* played, the cards still out (in the other hands) and the suits each
+* seat showed to be void in, by not following them. Every message updates
+* it in constant time per card and every question is a few bit operations,
+* so a strategy can ask e.g. what hearts are still out at no cost.
+* The cards of a trick count as played as soon as they are seen; the hand
+* loses its card only with TAKEN, so a TRICK sent again after WRONG finds
+* the card still there.
+*/
+class CardModel
+{
+public:
+    CardModel();
+    ~CardModel() = default;
+
+    /*
+    * Suit of the protocol character, 4 if there is no such suit.
+    */
+    static uint8_t suit_index(char suit);
+
+    static card_set_t suit_cards(uint8_t suit);
+
+    /*
+    * Highest card of the suit among the cards, NO_CARD if there is none:
+    * the one that takes a trick led in the suit.
+    */
+    static uint8_t top_card(card_set_t cards, uint8_t suit);
+
+    /*
+    * Points of a trick with the given cards under the deal type, counted
+    * as PointsCalculator does.
+    */
+    static int32_t trick_points(int16_t deal_type, int16_t trick,
+        card_set_t cards);
+
+    /*
+    * Index of the card the bot of the server plays from the hand, given
+    * in the order of the deal: the first card of the led suit, otherwise
+    * the last card (4 is no suit, for the leader). The hand must not be
+    * empty.
+    */
+    static size_t bot_position(span<const uint8_t> hand, uint8_t led_suit);
+
+    /*
+    * Starts a deal with the hand of the seat; first leads the first trick.
+    */
+    void deal(Seat seat, span<const string> cards, Seat first);
+
+    /*
+    * Cards of the current trick so far, in the order of play, as a TRICK
+    * shows them.
+    */
+    void trick(span<const string> cards);
+
+    /*
+    * Ends the trick with its four cards; taker leads the next one.
+    */
+    void taken(span<const string> cards, Seat taker);
+
+    Seat get_seat() const;
+    card_set_t get_hand() const;
+    card_set_t get_played() const;
+
+    /*
+    * Cards neither in the hand nor played, i.e. in the other hands.
+    */
+    card_set_t get_out() const;
+
+    /*
+    * Suit of the current trick, 4 if nobody played yet.
+    */
+    uint8_t get_led_suit() const;
+
+    /*
+    * Seat that leads the current trick and the cards played in it so far,
+    * in the order of play.
+    */
+    Seat get_leader() const;
+    span<const uint8_t> get_table() const;
+
+    bool is_void(Seat seat, uint8_t suit) const;
+
+    /*
+    * The card of the suit dealt first of those in the hand, NO_CARD if
+    * the hand has none.
+    */
+    uint8_t first_dealt(uint8_t suit) const;
+
+    /*
+    * The card of the hand dealt last, NO_CARD if the hand is empty.
+    */
+    uint8_t last_dealt() const;
+
+private:
+    /*
+    * Marks the card of the seat as played, the seat void in the led suit
+    * if it did not follow it.
+    */
+    void play(Seat seat, uint8_t card);
+
+    Seat seat;
+    card_set_t hand;
+    card_set_t played;
+    // Suits by seat, bit per suit index.
+    array<uint8_t, 4> voids;
+
+    Seat leader;
+    uint8_t led_suit;
+    // Cards of the current trick already played.
+    array<uint8_t, 4> table;
+    uint8_t on_table;
+
+    // The hand as bits of the order of the DEAL, so the strategy can keep
+    // playing the cards in that order: position of every card of the
+    // hand, and the positions of every suit.
+    array<uint8_t, NO_CARD> positions;
+    array<uint16_t, 4> suit_positions;
+    array<uint8_t, 13> dealt;
+    uint16_t hand_positions;
+};
+
+#endif // CARD_MODEL_H
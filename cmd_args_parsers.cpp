@@ -9,7 +9,10 @@ using std::pair;
 namespace po = boost::program_options;
 
 int16_t parser::parse_server_args(int argc, char* argv[], int32_t& port, 
-    string& game_file_name, int32_t& timeout)
+    string& game_file_name, int32_t& timeout, string& metrics_path,
+    string& trace_path, string& record_path, string& replay_path,
+    bool& b_is_replay_fast, string& game_log_path, int32_t& bot_grace,
+    bool& b_is_bot_table)
 {
     try 
     {
@@ -38,7 +41,23 @@ int16_t parser::parse_server_args(int argc, char* argv[], int32_t& port,
         desc.add_options()
             (",p", po::value<vector<int32_t>>()->multitoken(), "port number")
             (",f", po::value<vector<string>>()->multitoken(), "game file name")
-            (",t", po::value<vector<int32_t>>()->multitoken(), "timeout");
+            (",t", po::value<vector<int32_t>>()->multitoken(), "timeout")
+            (",m", po::value<vector<string>>()->multitoken(),
+                "metrics socket path")
+            (",T", po::value<vector<string>>()->multitoken(),
+                "trace output file")
+            (",r", po::value<vector<string>>()->multitoken(),
+                "record network input to a journal")
+            (",P", po::value<vector<string>>()->multitoken(),
+                "replay a journal")
+            (",F", po::value<vector<bool>>()->zero_tokens()->composing(),
+                "replay as fast as possible")
+            (",w", po::value<vector<string>>()->multitoken(),
+                "game log to resume from and write to")
+            (",b", po::value<vector<int32_t>>()->multitoken(),
+                "ms after which the server plays a vacant seat")
+            (",B", po::value<vector<bool>>()->zero_tokens()->composing(),
+                "bot table, skip resends and barriers after tricks");
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
         po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
@@ -65,6 +84,39 @@ int16_t parser::parse_server_args(int argc, char* argv[], int32_t& port,
                 throw invalid_argument("Timeout must be non-negative");
             }
         }
+
+        if (vm.count("-m")) { metrics_path = vm["-m"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-T")) { trace_path = vm["-T"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-r")) { record_path = vm["-r"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-P"))
+        {
+            replay_path = vm["-P"].as<vector<string>>()[0];
+            // The replay connects to the port, it has to be known.
+            if (port == 0)
+            {
+                throw invalid_argument("Replay needs a port number");
+            }
+        }
+        if (vm.count("-F")) { b_is_replay_fast = true; }
+
+        if (vm.count("-w")) { game_log_path = vm["-w"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-b"))
+        {
+            bot_grace = vm["-b"].as<vector<int32_t>>()[0];
+            if (bot_grace < 0)
+            {
+                throw invalid_argument("Bot grace must be non-negative");
+            }
+        }
+        if (vm.count("-B")) { b_is_bot_table = true; }
     }
     catch(exception& e) 
     {
@@ -97,7 +149,10 @@ namespace po = boost::program_options;
 using namespace std;
 
 int16_t parser::parse_client_args(int argc, char* argv[], string& host, 
-    int32_t& port_number, int16_t& IP_v, string& seat, bool& is_AI)
+    int32_t& port_number, int16_t& IP_v, string& seat, bool& is_AI,
+    bool& b_is_bot, bool& b_is_pre, bool& b_is_binary, int32_t& seats,
+    bool& b_is_multiplexed, int32_t& timeout, int32_t& threads,
+    string& policy_path)
 {
     try
     {
@@ -135,8 +190,6 @@ int16_t parser::parse_client_args(int argc, char* argv[], string& host,
             else { throw invalid_argument("Invalid argument: " + arg); }
         }
 
-        if (seat_order.size() > 0) {seat = seat_order[0];}
-        else {throw invalid_argument("Seat must be provided");}
         if (ip_order.size() > 0) { IP_v = ip_order[0] == "-4" ? 4 : 6; }
 
         po::options_description desc("Allowed options");
@@ -144,7 +197,23 @@ int16_t parser::parse_client_args(int argc, char* argv[], string& host,
             (",h", po::value<vector<string>>()->multitoken(), "host name")
             (",p", po::value<vector<int32_t>>()->multitoken(), "port number")
             (",a", po::value<vector<bool>>()->zero_tokens()
-                ->composing(), "AI");
+                ->composing(), "AI")
+            (",B", po::value<vector<bool>>()->zero_tokens()
+                ->composing(), "announce a bot, for bot tables")
+            (",P", po::value<vector<bool>>()->zero_tokens()
+                ->composing(), "AI sends the cards it knows ahead")
+            (",C", po::value<vector<bool>>()->zero_tokens()
+                ->composing(), "binary protocol if the server has it")
+            ("seats", po::value<vector<int32_t>>()->multitoken(),
+                "AI seats played from one thread, 4 per table from the port")
+            (",M", po::value<vector<bool>>()->zero_tokens()
+                ->composing(), "seats of a table share one connection")
+            (",t", po::value<vector<int32_t>>()->multitoken(),
+                "timeout of the server; the AI searches its moves")
+            (",j", po::value<vector<int32_t>>()->multitoken(),
+                "threads of the search")
+            (",L", po::value<vector<string>>()->multitoken(),
+                "policy table of the AI, made by kierki-policy");
 
         po::variables_map vm;
         // Parse remaining arguments with Boost
@@ -174,6 +243,443 @@ int16_t parser::parse_client_args(int argc, char* argv[], string& host,
 
         // Count occurrences of -a
         if (vm.count("-a")) { is_AI = true; }
+        if (vm.count("-B")) { b_is_bot = true; }
+        if (vm.count("-P")) { b_is_pre = true; }
+        if (vm.count("-C")) { b_is_binary = true; }
+        if (vm.count("seats"))
+        {
+            seats = vm["seats"].as<vector<int32_t>>()[0];
+            if (seats <= 0 || port_number + (seats - 1) / 4 > 65535)
+            {
+                throw invalid_argument("Invalid number of seats");
+            }
+        }
+        if (vm.count("-M")) { b_is_multiplexed = true; }
+        // Hosted seats share one thread, a search would stall all of them.
+        if (seats > 0 && (vm.count("-t") || vm.count("-j")))
+        {
+            throw invalid_argument("-t and -j cannot be used with --seats");
+        }
+        if (vm.count("-t"))
+        {
+            timeout = vm["-t"].as<vector<int32_t>>()[0];
+            if (timeout < 0)
+            {
+                throw invalid_argument("Timeout must be non-negative");
+            }
+        }
+        if (vm.count("-j"))
+        {
+            threads = vm["-j"].as<vector<int32_t>>()[0];
+            if (threads <= 0)
+            {
+                throw invalid_argument("Number of threads must be positive");
+            }
+        }
+        if (vm.count("-L")) { policy_path = vm["-L"]
+            .as<vector<string>>()[0]; }
+
+        // Hosted seats are given by their number.
+        if (seat_order.size() > 0) {seat = seat_order[0];}
+        else if (seats == 0)
+        {
+            throw invalid_argument("Seat must be provided");
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_loadgen_args(int argc, char* argv[], string& host,
+    int32_t& port, int32_t& tables, int32_t& think_time,
+    int32_t& connect_rate, int32_t& duration)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",h", po::value<vector<string>>()->multitoken(), "host name")
+            (",p", po::value<vector<int32_t>>()->multitoken(),
+                "port of the first table")
+            (",n", po::value<vector<int32_t>>()->multitoken(),
+                "number of tables")
+            (",t", po::value<vector<int32_t>>()->multitoken(),
+                "think time in milliseconds")
+            (",r", po::value<vector<int32_t>>()->multitoken(),
+                "connections per second")
+            (",d", po::value<vector<int32_t>>()->multitoken(),
+                "duration in seconds");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-h")) { host = vm["-h"].as<vector<string>>()[0]; }
+
+        if (vm.count("-p")) { port = vm["-p"].as<vector<int32_t>>()[0]; }
+        else { throw invalid_argument("Port number must be provided"); }
+        if (port <= 0)
+        {
+            throw invalid_argument("Port number must be positive");
+        }
+
+        if (vm.count("-n")) { tables = vm["-n"].as<vector<int32_t>>()[0]; }
+        if (tables <= 0 || port + tables - 1 > 65535)
+        {
+            throw invalid_argument("Invalid number of tables");
+        }
+
+        // The remaining options are non-negative, 0 turns them off.
+        const pair<const char*, int32_t*> values[] = {{"-t", &think_time},
+            {"-r", &connect_rate}, {"-d", &duration}};
+        for (const auto& [name, value] : values)
+        {
+            if (vm.count(name)) { *value = vm[name]
+                .as<vector<int32_t>>()[0]; }
+            if (*value < 0)
+            {
+                throw invalid_argument(string(name) +
+                    " must be non-negative");
+            }
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_bench_args(int argc, char* argv[], string& filter,
+    int32_t& sample_time, int32_t& samples, int32_t& deals)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",f", po::value<vector<string>>()->multitoken(),
+                "run only benchmarks whose name contains this")
+            (",t", po::value<vector<int32_t>>()->multitoken(),
+                "time of one sample in milliseconds")
+            (",s", po::value<vector<int32_t>>()->multitoken(),
+                "number of samples")
+            (",n", po::value<vector<int32_t>>()->multitoken(),
+                "deals in the FileReader benchmark file");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-f")) { filter = vm["-f"].as<vector<string>>()[0]; }
+
+        const pair<const char*, int32_t*> values[] = {{"-t", &sample_time},
+            {"-s", &samples}, {"-n", &deals}};
+        for (const auto& [name, value] : values)
+        {
+            if (vm.count(name)) { *value = vm[name]
+                .as<vector<int32_t>>()[0]; }
+            if (*value <= 0)
+            {
+                throw invalid_argument(string(name) + " must be positive");
+            }
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_solver_args(int argc, char* argv[],
+    string& game_file_name, int32_t& table_size_log2, int32_t& tricks)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",f", po::value<vector<string>>()->multitoken(), "game file")
+            (",x", po::value<vector<int32_t>>()->multitoken(),
+                "log2 of the entries of the transposition table")
+            (",k", po::value<vector<int32_t>>()->multitoken(),
+                "last tricks to solve");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-f")) { game_file_name = vm["-f"]
+            .as<vector<string>>()[0]; }
+        else { throw invalid_argument("Game file name must be provided"); }
+
+        if (vm.count("-x"))
+        {
+            table_size_log2 = vm["-x"].as<vector<int32_t>>()[0];
+            if (table_size_log2 < 10 || table_size_log2 > 30)
+            {
+                throw invalid_argument("Table size must be from 10 to 30");
+            }
+        }
+
+        if (vm.count("-k"))
+        {
+            tricks = vm["-k"].as<vector<int32_t>>()[0];
+            if (tricks < 1 || tricks > 13)
+            {
+                throw invalid_argument("Tricks must be from 1 to 13");
+            }
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_batch_args(int argc, char* argv[],
+    string& game_file_name, string& output_file_name, string& job_name,
+    int32_t& threads, int32_t& table_size_log2, int32_t& tricks)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",f", po::value<vector<string>>()->multitoken(), "game file")
+            (",o", po::value<vector<string>>()->multitoken(),
+                "output file, the standard output if none")
+            (",m", po::value<vector<string>>()->multitoken(),
+                "job: solve, simulate or score")
+            (",j", po::value<vector<int32_t>>()->multitoken(),
+                "threads")
+            (",x", po::value<vector<int32_t>>()->multitoken(),
+                "log2 of the entries of the transposition table")
+            (",k", po::value<vector<int32_t>>()->multitoken(),
+                "last tricks to solve");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-f")) { game_file_name = vm["-f"]
+            .as<vector<string>>()[0]; }
+        else { throw invalid_argument("Game file name must be provided"); }
+
+        if (vm.count("-o")) { output_file_name = vm["-o"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-m")) { job_name = vm["-m"].as<vector<string>>()[0]; }
+        if (job_name != "solve" && job_name != "simulate" &&
+            job_name != "score")
+        {
+            throw invalid_argument("Job must be solve, simulate or score");
+        }
+
+        if (vm.count("-j"))
+        {
+            threads = vm["-j"].as<vector<int32_t>>()[0];
+            if (threads <= 0)
+            {
+                throw invalid_argument("Number of threads must be positive");
+            }
+        }
+
+        if (vm.count("-x"))
+        {
+            table_size_log2 = vm["-x"].as<vector<int32_t>>()[0];
+            if (table_size_log2 < 10 || table_size_log2 > 30)
+            {
+                throw invalid_argument("Table size must be from 10 to 30");
+            }
+        }
+
+        if (vm.count("-k"))
+        {
+            tricks = vm["-k"].as<vector<int32_t>>()[0];
+            if (tricks < 1 || tricks > 13)
+            {
+                throw invalid_argument("Tricks must be from 1 to 13");
+            }
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_arena_args(int argc, char* argv[], uint64_t& tables,
+    uint64_t& seed, int32_t& threads, int16_t& deal_type,
+    vector<string>& entrants, string& policy_path,
+    int32_t& search_budget_ms)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",n", po::value<vector<uint64_t>>()->multitoken(), "tables")
+            (",s", po::value<vector<uint64_t>>()->multitoken(), "seed")
+            (",j", po::value<vector<int32_t>>()->multitoken(),
+                "threads")
+            (",d", po::value<vector<int16_t>>()->multitoken(),
+                "deal type, 0 for a random one at every table")
+            (",p", po::value<vector<string>>()->multitoken(),
+                "strategies taking part")
+            (",L", po::value<vector<string>>()->multitoken(),
+                "policy table of the policy strategy")
+            (",t", po::value<vector<int32_t>>()->multitoken(),
+                "search budget of a move of the search strategy, in ms");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-n"))
+        {
+            tables = vm["-n"].as<vector<uint64_t>>()[0];
+            if (tables == 0)
+            {
+                throw invalid_argument("Number of tables must be positive");
+            }
+        }
+
+        if (vm.count("-s")) { seed = vm["-s"].as<vector<uint64_t>>()[0]; }
+
+        if (vm.count("-j"))
+        {
+            threads = vm["-j"].as<vector<int32_t>>()[0];
+            if (threads <= 0)
+            {
+                throw invalid_argument("Number of threads must be positive");
+            }
+        }
+
+        if (vm.count("-d"))
+        {
+            deal_type = vm["-d"].as<vector<int16_t>>()[0];
+            if (deal_type < 0 || deal_type > 7)
+            {
+                throw invalid_argument("Deal type must be from 0 to 7");
+            }
+        }
+
+        if (vm.count("-p")) { entrants = vm["-p"].as<vector<string>>(); }
+
+        if (vm.count("-L")) { policy_path = vm["-L"]
+            .as<vector<string>>()[0]; }
+
+        if (vm.count("-t"))
+        {
+            search_budget_ms = vm["-t"].as<vector<int32_t>>()[0];
+            if (search_budget_ms <= 0)
+            {
+                throw invalid_argument("Search budget must be positive");
+            }
+        }
+    }
+    catch(const exception& e) 
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    catch(...) 
+    {
+        common::print_error("Exception of unknown type!");
+        return 1;
+    }
+
+    return 0;
+}
+
+int16_t parser::parse_policy_args(int argc, char* argv[],
+    string& output_file_name, uint64_t& deals, uint64_t& seed,
+    int32_t& threads, int32_t& min_choices)
+{
+    try
+    {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            (",o", po::value<vector<string>>()->multitoken(),
+                "policy table file")
+            (",n", po::value<vector<uint64_t>>()->multitoken(), "deals")
+            (",s", po::value<vector<uint64_t>>()->multitoken(), "seed")
+            (",j", po::value<vector<int32_t>>()->multitoken(),
+                "threads")
+            (",m", po::value<vector<int32_t>>()->multitoken(),
+                "choices of every suit needed for an entry");
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("-o")) { output_file_name = vm["-o"]
+            .as<vector<string>>()[0]; }
+        else
+        {
+            throw invalid_argument("Policy table file must be provided");
+        }
+
+        if (vm.count("-n"))
+        {
+            deals = vm["-n"].as<vector<uint64_t>>()[0];
+            if (deals == 0)
+            {
+                throw invalid_argument("Number of deals must be positive");
+            }
+        }
+
+        if (vm.count("-s")) { seed = vm["-s"].as<vector<uint64_t>>()[0]; }
+
+        if (vm.count("-j"))
+        {
+            threads = vm["-j"].as<vector<int32_t>>()[0];
+            if (threads <= 0)
+            {
+                throw invalid_argument("Number of threads must be positive");
+            }
+        }
+
+        if (vm.count("-m"))
+        {
+            min_choices = vm["-m"].as<vector<int32_t>>()[0];
+            if (min_choices <= 0)
+            {
+                throw invalid_argument("Number of choices must be positive");
+            }
+        }
     }
     catch(const exception& e) 
     {
@@ -17,14 +17,50 @@
 namespace parser
 {
     using std::string;
+    using std::vector;
 
     /* Parses command line arguments for the server. */
     int16_t parse_server_args(int argc, char* argv[], int32_t& port, 
-        string& game_file_name, int32_t& timeout);
+        string& game_file_name, int32_t& timeout, string& metrics_path,
+        string& trace_path, string& record_path, string& replay_path,
+        bool& b_is_replay_fast, string& game_log_path, int32_t& bot_grace,
+        bool& b_is_bot_table);
 
     /* Parses command line arguments for the client. */
     int16_t parse_client_args(int argc, char* argv[], string& host, 
-        int32_t& port_number, int16_t& IP_v, string& seat, bool& is_AI);
+        int32_t& port_number, int16_t& IP_v, string& seat, bool& is_AI,
+        bool& b_is_bot, bool& b_is_pre, bool& b_is_binary, int32_t& seats,
+        bool& b_is_multiplexed, int32_t& timeout, int32_t& threads,
+        string& policy_path);
+
+    /* Parses command line arguments for the load generator. */
+    int16_t parse_loadgen_args(int argc, char* argv[], string& host,
+        int32_t& port, int32_t& tables, int32_t& think_time,
+        int32_t& connect_rate, int32_t& duration);
+
+    /* Parses command line arguments for the benchmarks. */
+    int16_t parse_bench_args(int argc, char* argv[], string& filter,
+        int32_t& sample_time, int32_t& samples, int32_t& deals);
+
+    /* Parses command line arguments for the solver. */
+    int16_t parse_solver_args(int argc, char* argv[],
+        string& game_file_name, int32_t& table_size_log2, int32_t& tricks);
+
+    /* Parses command line arguments for the batch runner. */
+    int16_t parse_batch_args(int argc, char* argv[], string& game_file_name,
+        string& output_file_name, string& job_name, int32_t& threads,
+        int32_t& table_size_log2, int32_t& tricks);
+
+    /* Parses command line arguments for the arena. */
+    int16_t parse_arena_args(int argc, char* argv[], uint64_t& tables,
+        uint64_t& seed, int32_t& threads, int16_t& deal_type,
+        vector<string>& entrants, string& policy_path,
+        int32_t& search_budget_ms);
+
+    /* Parses command line arguments for the policy table generator. */
+    int16_t parse_policy_args(int argc, char* argv[],
+        string& output_file_name, uint64_t& deals, uint64_t& seed,
+        int32_t& threads, int32_t& min_choices);
 } // namespace parser
 
 #pragma GCC diagnostic pop
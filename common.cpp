@@ -1,6 +1,15 @@
 #include "common.h"
+#include "alloc_stats.h"
+#include "trace.h"
 
-std::string get_time()
+#include <fcntl.h>
+#include <poll.h>
+
+/*
+ * Writes the current time in the log format into the buffer.
+ * Uses only the stack, so logging does not allocate.
+ */
+void format_time(char* buffer, size_t buffer_size)
 {
     auto now = std::chrono::system_clock::now();
     std::time_t now_c = std::chrono::system_clock::to_time_t(now);
@@ -8,63 +17,85 @@ std::string get_time()
     localtime_r(&now_c, &now_tm);
     auto ms = std::chrono::duration_cast<std::chrono
         ::milliseconds>(now.time_since_epoch()) % 1000;
-    std::stringstream ss;
-    ss << std::put_time(&now_tm, "%Y-%m-%dT%H:%M:%S");
-    ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    return ss.str();
+    size_t length = strftime(buffer, buffer_size,
+        "%Y-%m-%dT%H:%M:%S", &now_tm);
+    snprintf(buffer + length, buffer_size - length, ".%03d",
+        static_cast<int>(ms.count()));
 }
 
 void log(const struct sockaddr_in& source_addr,
     const struct sockaddr_in& dest_addr, const string& message)
 {
+    char time[TIME_BUFFER_SIZE];
+    format_time(time, sizeof(time));
     cout << "[" << inet_ntoa(source_addr.sin_addr) << ":" 
         << ntohs(source_addr.sin_port);
     cout << "," << inet_ntoa(dest_addr.sin_addr) << ":" 
         << ntohs(dest_addr.sin_port) << ",";
-    cout << get_time() << "] " << message;
+    cout << time << "] " << message;
     cout.flush();
 }
 
 void log(const struct sockaddr_in6& source_addr,
     const struct sockaddr_in6& dest_addr, const string& message)
 {
-    char* str = (char*)malloc(INET6_ADDRSTRLEN);
-    inet_ntop(AF_INET6, &source_addr.sin6_addr, str, INET6_ADDRSTRLEN);
-    string src{str};
-    inet_ntop(AF_INET6, &dest_addr.sin6_addr, str, INET6_ADDRSTRLEN);
-    string dest{str};
-    free(str);
+    char src[INET6_ADDRSTRLEN];
+    char dest[INET6_ADDRSTRLEN];
+    char time[TIME_BUFFER_SIZE];
+    inet_ntop(AF_INET6, &source_addr.sin6_addr, src, INET6_ADDRSTRLEN);
+    inet_ntop(AF_INET6, &dest_addr.sin6_addr, dest, INET6_ADDRSTRLEN);
+    format_time(time, sizeof(time));
 
     cout << "[" << src << ":" << ntohs(source_addr.sin6_port);
     cout << "," << dest << ":" << ntohs(dest_addr.sin6_port) << ",";
-    cout << get_time() << "] " << message;
+    cout << time << "] " << message;
     cout.flush();
 }
 
+void common::print_log(const struct sockaddr_in6& src_addr,
+    const struct sockaddr_in6& dest_addr, const string& message)
+{
+    if (message == "") { return; }
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::LOG);
+    TRACE_SPAN("log_write");
+    log(src_addr, dest_addr, message);
+    if (!message.ends_with("\r\n")) { cout << "\n"; }
+}
+
+void common::print_log(const struct sockaddr_in& src_addr,
+    const struct sockaddr_in& dest_addr, const string& message)
+{
+    if (message == "") { return; }
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::LOG);
+    TRACE_SPAN("log_write");
+    log(src_addr, dest_addr, message);
+    if (!message.ends_with("\r\n")) { cout << "\n"; }
+}
+
 void common::print_log(const struct sockaddr_in6& src_addr,
     const struct sockaddr_in6& dest_addr, const string& message,
-    mutex& log_mutex, bool is_ai)
+    ProfiledMutex& log_mutex, bool is_ai)
 {
     if (is_ai && message != "")
     {
+        tracing::Span wait_span("log_wait");
         log_mutex.lock();
-        log(src_addr, dest_addr, message);
-        if (message.size() < 2 || message.substr(message.size() - 2, 2) != 
-            "\r\n") { cout << "\n"; }
+        wait_span.end();
+        print_log(src_addr, dest_addr, message);
         log_mutex.unlock();
     }
 }
 
 void common::print_log(const struct sockaddr_in& src_addr,
     const struct sockaddr_in& dest_addr, const string& message,
-    mutex& log_mutex, bool is_ai)
+    ProfiledMutex& log_mutex, bool is_ai)
 {
     if (is_ai && message != "")
     {
+        tracing::Span wait_span("log_wait");
         log_mutex.lock();
-        log(src_addr, dest_addr, message);
-        if (message.size() < 2 || 
-            message.substr(message.size() - 2, 2) != "\r\n") { cout << "\n"; }
+        wait_span.end();
+        print_log(src_addr, dest_addr, message);
         log_mutex.unlock();
     }
 }
@@ -76,7 +107,8 @@ void common::print_error(const string& error_message)
     else {cerr << "\n";}
 }
 
-void common::print_error(const string& message, mutex& error_mutex)
+void common::print_error(const string& message,
+    ProfiledMutex& error_mutex)
 {
     error_mutex.lock();
     print_error(message);
@@ -120,10 +152,10 @@ ssize_t common::read_from_pipe(int32_t pipe_fd, string& buffer)
     return bytes_read;
 }
 
-ssize_t common::write_to_socket(int32_t socket_fd, char* buffer,
+ssize_t common::write_to_socket(int32_t socket_fd, const char* buffer,
     size_t buffer_length)
 {
-    char* iter_ptr = buffer;
+    const char* iter_ptr = buffer;
     ssize_t store_buff_len = buffer_length;
     while (buffer_length > 0) 
     {
@@ -291,6 +323,171 @@ ssize_t common::get_server_unknown_addr(char const *host, int32_t port,
     return -1;
 }
 
+ssize_t common::get_server_addresses(char const *host, int32_t port,
+    int32_t family, vector<struct sockaddr_storage>& addresses)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    struct addrinfo *address_result = nullptr;
+    int32_t errcode = getaddrinfo(host, NULL, &hints, &address_result);
+    if (errcode != 0)
+    {
+        print_error("getaddrinfo failed: " + string(gai_strerror(errcode)));
+        if (address_result != nullptr) { freeaddrinfo(address_result); }
+        return -1;
+    }
+
+    // Both families in the order of getaddrinfo, then taking turns.
+    vector<struct sockaddr_storage> v4_addresses;
+    vector<struct sockaddr_storage> v6_addresses;
+    int32_t first_family = AF_UNSPEC;
+    for (struct addrinfo *result = address_result; result != nullptr;
+        result = result->ai_next)
+    {
+        struct sockaddr_storage address;
+        memset(&address, 0, sizeof(address));
+        if (result->ai_family == AF_INET)
+        {
+            struct sockaddr_in* v4_addr = (struct sockaddr_in*)&address;
+            *v4_addr = *(struct sockaddr_in*)result->ai_addr;
+            v4_addr->sin_port = htons(port);
+            v4_addresses.push_back(address);
+        }
+        else if (result->ai_family == AF_INET6)
+        {
+            struct sockaddr_in6* v6_addr = (struct sockaddr_in6*)&address;
+            *v6_addr = *(struct sockaddr_in6*)result->ai_addr;
+            v6_addr->sin6_port = htons(port);
+            v6_addresses.push_back(address);
+        }
+        else { continue; }
+        if (first_family == AF_UNSPEC) { first_family = result->ai_family; }
+    }
+    freeaddrinfo(address_result);
+
+    vector<struct sockaddr_storage>& first = first_family == AF_INET6 ?
+        v6_addresses : v4_addresses;
+    vector<struct sockaddr_storage>& second = first_family == AF_INET6 ?
+        v4_addresses : v6_addresses;
+    addresses.clear();
+    for (size_t i = 0; i < first.size() || i < second.size(); ++i)
+    {
+        if (i < first.size()) { addresses.push_back(first[i]); }
+        if (i < second.size()) { addresses.push_back(second[i]); }
+    }
+    if (addresses.empty())
+    {
+        print_error("Failed to find IPv4 or IPv6 address.");
+        return -1;
+    }
+    return 0;
+}
+
+int32_t common::connect_first(
+    const vector<struct sockaddr_storage>& addresses, size_t& winner)
+{
+    using clock = std::chrono::steady_clock;
+    // The attempts going on and the addresses they are to.
+    vector<struct pollfd> attempts;
+    vector<size_t> attempted;
+    size_t next = 0;
+    clock::time_point next_start = clock::now();
+    // Of the last attempt that failed, for the message.
+    int32_t last_error = 0;
+
+    auto close_attempts = [&]()
+    {
+        for (const struct pollfd& attempt : attempts)
+        {
+            assert_close(attempt.fd);
+        }
+    };
+
+    while (true)
+    {
+        clock::time_point now = clock::now();
+        if (next < addresses.size() &&
+            (now >= next_start || attempts.empty()))
+        {
+            const struct sockaddr_storage& address = addresses[next];
+            socklen_t length = address.ss_family == AF_INET ?
+                sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+            int32_t socket_fd = socket(address.ss_family,
+                SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (socket_fd < 0) { print_error("Failed to create socket."); }
+            else if (connect(socket_fd, (const struct sockaddr*)&address,
+                length) == 0 || errno == EINPROGRESS)
+            {
+                attempts.push_back({socket_fd, POLLOUT, 0});
+                attempted.push_back(next);
+            }
+            else
+            {
+                last_error = errno;
+                assert_close(socket_fd);
+            }
+            ++next;
+            next_start = now +
+                std::chrono::milliseconds(CONNECT_ATTEMPT_DELAY_MS);
+            continue;
+        }
+        if (attempts.empty())
+        {
+            errno = last_error;
+            print_error("Failed to connect to server.");
+            return -1;
+        }
+
+        int32_t timeout = -1;
+        if (next < addresses.size())
+        {
+            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_start - now).count() + 1;
+        }
+        int32_t ready = poll(attempts.data(), attempts.size(), timeout);
+        if (ready < 0)
+        {
+            if (errno == EINTR) { continue; }
+            print_error("Failed to poll the connection attempts.");
+            close_attempts();
+            return -1;
+        }
+
+        for (size_t i = 0; i < attempts.size(); )
+        {
+            if (attempts[i].revents == 0)
+            {
+                ++i;
+                continue;
+            }
+            int32_t socket_fd = attempts[i].fd;
+            int32_t error = 0;
+            socklen_t error_length = sizeof(error);
+            getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error,
+                &error_length);
+            if (error == 0)
+            {
+                winner = attempted[i];
+                attempts.erase(attempts.begin() + i);
+                close_attempts();
+                fcntl(socket_fd, F_SETFL,
+                    fcntl(socket_fd, F_GETFL) & ~O_NONBLOCK);
+                return socket_fd;
+            }
+            // A failed attempt lets the next one start at once.
+            last_error = error;
+            assert_close(socket_fd);
+            attempts.erase(attempts.begin() + i);
+            attempted.erase(attempted.begin() + i);
+            next_start = clock::now();
+        }
+    }
+}
+
 int32_t common::setup_server_socket(int32_t port, int32_t queue_size,
     struct sockaddr_in6& server_addr)
 {
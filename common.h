@@ -14,16 +14,19 @@
 #include <mutex>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <vector>
+
+#include "lock_stats.h"
 
 #define QUEUE_SIZE 69
 
 #define MAX_BUFFER_SIZE 90 // for uint64_t max
 
+#define TIME_BUFFER_SIZE 32 // "YYYY-MM-DDTHH:MM:SS.mmm" with a margin
+
 #define MISSING_CLIENT_BARRIER 0
 #define END_OF_TRICK_BARRIER 1
 
-#define CONNECTIONS_THREAD "K"
-
 #define DISCONNECTED "c"
 #define CARD_PLAY "p"
 #define BARRIER_RESPONSE "b"
@@ -35,12 +38,17 @@
 #define DEAL "l"
 #define END "f"
 #define BARRIER_END "r"
+#define TAKEN_AND_TRICK "k"
 #define DELIMETER "\r\n"
 
+// Between the starts of connection attempts (RFC 8305).
+#define CONNECT_ATTEMPT_DELAY_MS 250
+
 using std::string;
 using std::cout;
 using std::cerr;
 using std::mutex;
+using std::vector;
 
 namespace common
 {
@@ -60,7 +68,7 @@ namespace common
      * Write buffer to socket.
      * Returns number of bytes written.
      */
-    ssize_t write_to_socket(int32_t socket_fd, char* buffer, 
+    ssize_t write_to_socket(int32_t socket_fd, const char* buffer, 
         size_t buffer_length);
 
     /* 
@@ -117,6 +125,26 @@ namespace common
     ssize_t get_server_unknown_addr(char const *host, int32_t port, 
         struct sockaddr_in& v4_addr, struct sockaddr_in6& v6_addr);
 
+    /*
+    * Gets every TCP address of the host of the family (AF_INET, AF_INET6
+    * or AF_UNSPEC for both), ordered as RFC 8305 asks: the families take
+    * turns, starting with the one resolved first.
+    * Returns 0 on success, -1 on failure.
+    */
+    ssize_t get_server_addresses(char const *host, int32_t port,
+        int32_t family, vector<struct sockaddr_storage>& addresses);
+
+    /*
+    * Connects to the first of the addresses to answer (Happy Eyeballs,
+    * RFC 8305): a non-blocking attempt starts every
+    * CONNECT_ATTEMPT_DELAY_MS, or at once when the previous ones failed,
+    * while the earlier ones go on; the first connected socket wins and
+    * the others are closed. Sets winner to the index of its address.
+    * Returns the socket, blocking again, or -1 if no address connected.
+    */
+    int32_t connect_first(const vector<struct sockaddr_storage>& addresses,
+        size_t& winner);
+
     /*
     * Utility function to check return value of the close().
     * On error prints error message.
@@ -133,21 +161,32 @@ namespace common
     * Utility function to print error message.
     * If errno is set, it will print it. Memory-safe version.
     */
-    void print_error(const string& error_message, mutex& error_mutex);
+    void print_error(const string& error_message,
+        ProfiledMutex& error_mutex);
+
+    /*
+    * Utility functions to print log message without locking, for
+    * single-threaded clients.
+    */
+    void print_log(const struct sockaddr_in& source_addr,
+        const struct sockaddr_in& dest_addr, const string& message);
+
+    void print_log(const struct sockaddr_in6& source_addr,
+        const struct sockaddr_in6& dest_addr, const string& message);
 
     /*
     * Utility function to print log message for IPv4 addresses.
     */
     void print_log(const struct sockaddr_in& source_addr, 
         const struct sockaddr_in& dest_addr, const string& message, 
-        mutex& log_mutex, bool is_ai = true);
+        ProfiledMutex& log_mutex, bool is_ai = true);
 
     /*
     * Utility function to print log message for IPv6 addresses.
     */
     void print_log(const struct sockaddr_in6& source_addr, 
         const struct sockaddr_in6& dest_addr, const string& message,
-        mutex& log_mutex, bool is_ai = true);
+        ProfiledMutex& log_mutex, bool is_ai = true);
 } // namespace common
 
 #endif // COMMON_H
@@ -0,0 +1,51 @@
+#include "deal_arena.h"
+
+DealArena::CountingResource::CountingResource
+    (std::pmr::memory_resource* upstream)
+    : stats{0, 0}, upstream{upstream} {}
+
+void* DealArena::CountingResource::do_allocate(size_t bytes,
+    size_t alignment)
+{
+    ++stats.allocations;
+    stats.bytes += bytes;
+    return upstream->allocate(bytes, alignment);
+}
+
+void DealArena::CountingResource::do_deallocate(void* pointer, size_t bytes,
+    size_t alignment)
+{
+    upstream->deallocate(pointer, bytes, alignment);
+}
+
+bool DealArena::CountingResource::do_is_equal
+    (const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+DealArena::DealArena()
+    : buffer{}, overflow{std::pmr::new_delete_resource()},
+    monotonic{buffer.data(), buffer.size(), &overflow},
+    counting{&monotonic}, total{0, 0} {}
+
+std::pmr::memory_resource* DealArena::resource() { return &counting; }
+
+void DealArena::reset()
+{
+    total.allocations += counting.stats.allocations;
+    total.bytes += counting.stats.bytes;
+    counting.stats = {0, 0};
+    overflow.stats = {0, 0};
+    monotonic.release();
+}
+
+DealArena::Stats DealArena::deal_stats() const { return counting.stats; }
+
+DealArena::Stats DealArena::overflow_stats() const { return overflow.stats; }
+
+DealArena::Stats DealArena::total_stats() const
+{
+    return {total.allocations + counting.stats.allocations,
+        total.bytes + counting.stats.bytes};
+}
@@ -0,0 +1,94 @@
+#ifndef DEAL_ARENA_H
+#define DEAL_ARENA_H
+
+#include <memory_resource>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using std::array;
+using std::size_t;
+
+// Enough for both copies of the hands, taken tricks and the table
+// of one deal, so a normal deal never reaches the global allocator.
+#define DEAL_ARENA_SIZE 16384
+
+/*
+* Memory of the game state that lives for one deal. Allocations are served
+* from a monotonic buffer embedded in the object and are all released
+* in one step by reset(). Not thread-safe; callers synchronize access.
+*/
+class DealArena
+{
+public:
+    /*
+    * Number and total size of allocations.
+    */
+    struct Stats
+    {
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    DealArena();
+    ~DealArena() = default;
+    DealArena(const DealArena&) = delete;
+    DealArena& operator=(const DealArena&) = delete;
+
+    /*
+    * Resource that containers of the deal state should be created with.
+    */
+    std::pmr::memory_resource* resource();
+
+    /*
+    * Releases all the memory handed out since the last reset.
+    * Every container using the arena must be empty (without any
+    * capacity) before this is called.
+    */
+    void reset();
+
+    /*
+    * Allocations made through the arena since the last reset.
+    */
+    Stats deal_stats() const;
+
+    /*
+    * Allocations the arena had to pass to the global allocator
+    * (because the buffer was too small) since the last reset.
+    */
+    Stats overflow_stats() const;
+
+    /*
+    * Allocations made through the arena since it was created.
+    */
+    Stats total_stats() const;
+
+private:
+    /*
+    * Resource that forwards everything upstream and counts allocations.
+    */
+    class CountingResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream);
+
+        Stats stats;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes,
+            size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other)
+            const noexcept override;
+
+        std::pmr::memory_resource* upstream;
+    };
+
+    alignas(std::max_align_t) array<std::byte, DEAL_ARENA_SIZE> buffer;
+    CountingResource overflow;
+    std::pmr::monotonic_buffer_resource monotonic;
+    CountingResource counting;
+    Stats total;
+};
+
+#endif // DEAL_ARENA_H
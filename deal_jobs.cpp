@@ -0,0 +1,198 @@
+#include "deal_jobs.h"
+
+#include <chrono>
+
+#include "frames.h"
+#include "points_calculator.h"
+#include "regex.h"
+
+namespace
+{
+    // Cards of the tricks of a deal played by the bot, by trick and in
+    // the order of play, and the seats leading them.
+    struct BotPlay
+    {
+        array<array<string, 4>, 13> tricks;
+        array<Seat, 13> leaders;
+    };
+
+    /*
+    * Plays one trick as the bot of the server plays, the cards to cards
+    * in the order of play. Returns the seat taking it.
+    */
+    Seat play_bot_trick(array<vector<uint8_t>, 4>& hands, Seat leader,
+        array<uint8_t, 4>& cards)
+    {
+        uint8_t led_suit = 4;
+        uint8_t top = NO_CARD;
+        Seat taker = leader;
+        for (size_t i = 0; i < seating::SEATS_NUMBER; ++i)
+        {
+            Seat seat = seating::next(leader, i);
+            vector<uint8_t>& hand = hands[seating::index(seat)];
+            auto card = hand.begin() +
+                CardModel::bot_position(hand, led_suit);
+            cards[i] = *card;
+            if (i == 0) { led_suit = *card % 4; }
+            // Cards of a suit grow with the rank.
+            if (*card % 4 == led_suit && (top == NO_CARD || *card > top))
+            {
+                top = *card;
+                taker = seat;
+            }
+            hand.erase(card);
+        }
+        return taker;
+    }
+
+    BotPlay play_bot_deal(const deal_jobs::Deal& deal)
+    {
+        BotPlay play;
+        array<vector<uint8_t>, 4> hands = deal.hands;
+        Seat leader = deal.first;
+        for (size_t trick = 0; trick < 13; ++trick)
+        {
+            play.leaders[trick] = leader;
+            array<uint8_t, 4> cards;
+            leader = play_bot_trick(hands, leader, cards);
+            for (size_t i = 0; i < cards.size(); ++i)
+            {
+                char text[4];
+                frames::decode_card(cards[i], text);
+                play.tricks[trick][i] = text;
+            }
+        }
+        return play;
+    }
+
+    /*
+    * Points of the seats under the deal type for the play of the bot,
+    * and the tricks they took.
+    */
+    array<int32_t, 4> count_points(const BotPlay& play, int16_t deal_type,
+        array<int32_t, 4>* taken = nullptr)
+    {
+        array<int32_t, 4> points{};
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            PointsCalculator calculator(play.tricks[trick - 1],
+                play.leaders[trick - 1], deal_type, trick);
+            auto [taker, trick_points] = calculator.calculate_points();
+            points[seating::index(taker)] += trick_points;
+            if (taken != nullptr) { ++(*taken)[seating::index(taker)]; }
+        }
+        return points;
+    }
+
+    string json_array(const array<int32_t, 4>& values)
+    {
+        return "[" + std::to_string(values[0]) + "," +
+            std::to_string(values[1]) + "," + std::to_string(values[2]) +
+            "," + std::to_string(values[3]) + "]";
+    }
+} // namespace
+
+deal_jobs::DealText deal_jobs::deal_text(const FileReader& reader)
+{
+    return DealText{reader.get_trick_type(), reader.get_seat(),
+        reader.get_cards()};
+}
+
+bool deal_jobs::parse_deal(const DealText& text, int32_t number,
+    Deal& deal)
+{
+    deal.number = number;
+    deal.deal_type = text.deal_type;
+    deal.first = text.seat.empty() ? Seat::NONE :
+        seating::from_char(text.seat[0]);
+    card_set_t all = 0;
+    for (size_t i = 0; i < text.cards.size(); ++i)
+    {
+        deal.hands[i].clear();
+        for (const string& card : regex::extract_cards(text.cards[i]))
+        {
+            uint8_t byte = frames::encode_card(card);
+            if (byte == NO_CARD || (all >> byte & 1)) { return false; }
+            all |= 1ULL << byte;
+            deal.hands[i].push_back(byte);
+        }
+        if (deal.hands[i].size() != 13) { return false; }
+    }
+    return seating::index(deal.first) < seating::SEATS_NUMBER &&
+        deal.deal_type >= 1 && deal.deal_type <= 7;
+}
+
+card_set_t deal_jobs::card_set(const vector<uint8_t>& hand)
+{
+    card_set_t cards = 0;
+    for (uint8_t card : hand) { cards |= 1ULL << card; }
+    return cards;
+}
+
+Seat deal_jobs::play_bot_tricks(array<vector<uint8_t>, 4>& hands,
+    Seat first, int32_t tricks)
+{
+    Seat leader = first;
+    array<uint8_t, 4> cards;
+    for (int32_t trick = 0; trick < tricks; ++trick)
+    {
+        leader = play_bot_trick(hands, leader, cards);
+    }
+    return leader;
+}
+
+string deal_jobs::solve(const Deal& deal, Solver& solver, int32_t tricks)
+{
+    array<vector<uint8_t>, 4> left = deal.hands;
+    Seat first = play_bot_tricks(left, deal.first, 13 - tricks);
+    array<card_set_t, 4> hands;
+    for (size_t i = 0; i < hands.size(); ++i)
+    {
+        hands[i] = card_set(left[i]);
+    }
+
+    uint64_t nodes = solver.get_nodes();
+    auto start = std::chrono::steady_clock::now();
+    string points;
+    for (int16_t type = 1; type <= 7; ++type)
+    {
+        array<int32_t, 4> type_points;
+        for (Seat seat : seating::ALL_SEATS)
+        {
+            type_points[seating::index(seat)] = solver.solve(hands, first,
+                type, seat);
+        }
+        points += (type == 1 ? "" : ",") + json_array(type_points);
+    }
+    std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - start;
+    return "{\"deal\":" + std::to_string(deal.number) + ",\"tricks\":" +
+        std::to_string(tricks) + ",\"first\":\"" + seating::to_char(first) +
+        "\",\"points\":[" + points + "],\"nodes\":" +
+        std::to_string(solver.get_nodes() - nodes) + ",\"ms\":" +
+        std::to_string(time.count()) + "}";
+}
+
+string deal_jobs::simulate(const Deal& deal)
+{
+    array<int32_t, 4> taken{};
+    array<int32_t, 4> points = count_points(play_bot_deal(deal),
+        deal.deal_type, &taken);
+    return "{\"deal\":" + std::to_string(deal.number) + ",\"type\":" +
+        std::to_string(deal.deal_type) + ",\"first\":\"" +
+        seating::to_char(deal.first) + "\",\"taken\":" + json_array(taken) +
+        ",\"points\":" + json_array(points) + "}";
+}
+
+string deal_jobs::score(const Deal& deal)
+{
+    BotPlay play = play_bot_deal(deal);
+    string points;
+    for (int16_t type = 1; type <= 7; ++type)
+    {
+        points += (type == 1 ? "" : ",") +
+            json_array(count_points(play, type));
+    }
+    return "{\"deal\":" + std::to_string(deal.number) + ",\"first\":\"" +
+        seating::to_char(deal.first) + "\",\"points\":[" + points + "]}";
+}
@@ -0,0 +1,85 @@
+#ifndef DEAL_JOBS_H
+#define DEAL_JOBS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "card_model.h"
+#include "file_reader.h"
+#include "seat.h"
+#include "solver.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+/*
+* Work done on single deals of a game file, apart from any table or
+* network: solving them, playing them out with the bot of the server and
+* scoring that play. Every job turns a deal into one JSON line.
+*/
+namespace deal_jobs
+{
+    /*
+    * Deal of a game file, hands as card bytes in the order of the deal.
+    */
+    struct Deal
+    {
+        int32_t number;
+        int16_t deal_type;
+        Seat first;
+        array<vector<uint8_t>, 4> hands;
+    };
+
+    /*
+    * Deal as the game file has it, before its cards are parsed.
+    */
+    struct DealText
+    {
+        int16_t deal_type;
+        string seat;
+        array<string, 4> cards;
+    };
+
+    DealText deal_text(const FileReader& reader);
+
+    /*
+    * Parses the deal, numbered number. Returns false if it is not a valid
+    * deal: 13 cards in every hand, all 52 together, a seat leading the
+    * first trick and a deal type.
+    */
+    bool parse_deal(const DealText& text, int32_t number, Deal& deal);
+
+    card_set_t card_set(const vector<uint8_t>& hand);
+
+    /*
+    * Plays the first tricks of the deal as the bot of the server plays.
+    * The hands lose the cards played; returns the seat leading the next
+    * trick.
+    */
+    Seat play_bot_tricks(array<vector<uint8_t>, 4>& hands, Seat first,
+        int32_t tricks);
+
+    /*
+    * Points each seat can hold itself to under each deal type when the
+    * three others play against it, solving the last tricks only (the
+    * ones before played by the bot).
+    */
+    string solve(const Deal& deal, Solver& solver, int32_t tricks);
+
+    /*
+    * The deal played out by the bot under its own type: tricks and points
+    * every seat took, counted by PointsCalculator.
+    */
+    string simulate(const Deal& deal);
+
+    /*
+    * Points every seat takes under each deal type when the bot plays the
+    * deal; the bot plays the same cards whatever the type.
+    */
+    string score(const Deal& deal);
+} // namespace deal_jobs
+
+#endif // DEAL_JOBS_H
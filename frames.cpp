@@ -0,0 +1,376 @@
+#include "frames.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "common.h"
+#include "regex.h"
+
+namespace
+{
+    using std::string;
+    using std::vector;
+
+    const char* const RANKS[] = {"2", "3", "4", "5", "6", "7", "8", "9",
+        "10", "J", "Q", "K", "A"};
+    // RANKS of one character; 10 would come between 9 and J.
+    const char RANK_CHARACTERS[] = "23456789JQKA";
+    const char SUITS[] = "CDHS";
+    constexpr uint8_t CARDS_NUMBER = 52;
+
+    void begin_frame(string& frame, frames::Type type, size_t payload_size)
+    {
+        frame += (char)(payload_size + 1);
+        frame += (char)type;
+    }
+
+    void put_cards(string& frame, std::span<const string> cards)
+    {
+        for (const string& card : cards)
+        {
+            frame += (char)frames::encode_card(card);
+        }
+    }
+
+    bool is_trick_number(uint8_t number)
+    {
+        return number >= 1 && number <= 13;
+    }
+
+    bool get_cards(const string& frame, size_t begin, size_t count,
+        vector<string>& cards)
+    {
+        char card[4];
+        cards.clear();
+        for (size_t i = begin; i < begin + count; ++i)
+        {
+            if (!frames::decode_card(frame[i], card)) { return false; }
+            cards.emplace_back(card);
+        }
+        return true;
+    }
+} // namespace
+
+uint8_t frames::encode_card(const string& card)
+{
+    if (card.size() < 2 || card.size() > 3) { return CARDS_NUMBER; }
+    const char* suit = strchr(SUITS, card.back());
+    if (suit == nullptr || *suit == '\0') { return CARDS_NUMBER; }
+    uint8_t rank = 8;
+    if (card.size() == 3)
+    {
+        if (card[0] != '1' || card[1] != '0') { return CARDS_NUMBER; }
+    }
+    else
+    {
+        const char* figure = strchr(RANK_CHARACTERS, card[0]);
+        if (figure == nullptr || *figure == '\0') { return CARDS_NUMBER; }
+        rank = figure - RANK_CHARACTERS;
+        if (rank >= 8) { ++rank; }
+    }
+    return rank * 4 + (suit - SUITS);
+}
+
+bool frames::decode_card(uint8_t byte, char destination[4])
+{
+    if (byte >= CARDS_NUMBER) { return false; }
+    const char* rank = RANKS[byte / 4];
+    size_t rank_size = strlen(rank);
+    memcpy(destination, rank, rank_size);
+    destination[rank_size] = SUITS[byte % 4];
+    destination[rank_size + 1] = '\0';
+    return true;
+}
+
+void frames::encode_busy(string& frame, const string& seats)
+{
+    begin_frame(frame, Type::BUSY_FRAME, seats.size());
+    for (char seat : seats)
+    {
+        frame += (char)seating::index(seating::from_char(seat));
+    }
+}
+
+void frames::encode_deal(string& frame, int16_t deal_type, Seat start_seat,
+    span<const string> cards)
+{
+    begin_frame(frame, Type::DEAL_FRAME, 2 + cards.size());
+    frame += (char)deal_type;
+    frame += (char)seating::index(start_seat);
+    put_cards(frame, cards);
+}
+
+void frames::encode_trick(string& frame, int16_t trick_number,
+    span<const string> cards)
+{
+    begin_frame(frame, Type::TRICK_FRAME, 1 + cards.size());
+    frame += (char)trick_number;
+    put_cards(frame, cards);
+}
+
+void frames::encode_wrong(string& frame, int16_t trick_number)
+{
+    begin_frame(frame, Type::WRONG_FRAME, 1);
+    frame += (char)trick_number;
+}
+
+void frames::encode_taken(string& frame, int16_t trick_number,
+    span<const string> cards, Seat taking_seat)
+{
+    begin_frame(frame, Type::TAKEN_FRAME, 2 + cards.size());
+    frame += (char)trick_number;
+    put_cards(frame, cards);
+    frame += (char)seating::index(taking_seat);
+}
+
+void frames::encode_scores(string& frame, Type type,
+    const array<int32_t, 4>& scores)
+{
+    begin_frame(frame, type, 4 * scores.size());
+    for (int32_t score : scores)
+    {
+        for (int32_t shift = 24; shift >= 0; shift -= 8)
+        {
+            frame += (char)((uint32_t)score >> shift);
+        }
+    }
+}
+
+bool frames::decode(const string& frame, Message& message)
+{
+    if (frame.size() < 2 || (size_t)(uint8_t)frame[0] + 1 != frame.size())
+    {
+        return false;
+    }
+    message.type = static_cast<Type>(frame[1]);
+    size_t payload = frame.size() - 2;
+    switch (message.type)
+    {
+        case Type::BUSY_FRAME:
+            if (payload > 4) { return false; }
+            message.seats.clear();
+            for (size_t i = 2; i < frame.size(); ++i)
+            {
+                if ((uint8_t)frame[i] >= seating::SEATS_NUMBER)
+                {
+                    return false;
+                }
+                message.seats +=
+                    seating::to_char(static_cast<Seat>(frame[i]));
+            }
+            return true;
+        case Type::DEAL_FRAME:
+            if (payload != 15) { return false; }
+            message.number = (uint8_t)frame[2];
+            message.seat = static_cast<Seat>(frame[3]);
+            return message.number >= 1 && message.number <= 7 &&
+                seating::index(message.seat) < seating::SEATS_NUMBER &&
+                get_cards(frame, 4, 13, message.cards);
+        case Type::TRICK_FRAME:
+            if (payload < 1 || payload > 4) { return false; }
+            message.number = (uint8_t)frame[2];
+            return is_trick_number(message.number) &&
+                get_cards(frame, 3, payload - 1, message.cards);
+        case Type::WRONG_FRAME:
+            if (payload != 1) { return false; }
+            message.number = (uint8_t)frame[2];
+            return is_trick_number(message.number);
+        case Type::TAKEN_FRAME:
+            if (payload != 6) { return false; }
+            message.number = (uint8_t)frame[2];
+            message.seat = static_cast<Seat>(frame[7]);
+            return is_trick_number(message.number) &&
+                seating::index(message.seat) < seating::SEATS_NUMBER &&
+                get_cards(frame, 3, 4, message.cards);
+        case Type::SCORE_FRAME:
+        case Type::TOTAL_FRAME:
+            if (payload != 16) { return false; }
+            for (size_t i = 0; i < 4; ++i)
+            {
+                uint32_t score = 0;
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    score = (score << 8) | (uint8_t)frame[2 + 4 * i + j];
+                }
+                message.scores[i] = score;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool frames::decode_trick(const string& frame, int16_t& trick_number,
+    char card[4])
+{
+    if (frame.size() != 4 || frame[0] != 3 ||
+        static_cast<Type>(frame[1]) != Type::TRICK_FRAME ||
+        !is_trick_number(frame[2]))
+    {
+        return false;
+    }
+    trick_number = frame[2];
+    return decode_card(frame[3], card);
+}
+
+bool frames::parse_text(const string& text, int16_t trick_number,
+    Message& message)
+{
+    if (regex::BUSY_check(text))
+    {
+        message.type = Type::BUSY_FRAME;
+        message.seats = text.substr(4, text.size() - 6);
+    }
+    else if (regex::DEAL_check(text))
+    {
+        message.type = Type::DEAL_FRAME;
+        message.number = text[4] - '0';
+        message.seat = seating::from_char(text[5]);
+        message.cards = regex::extract_cards(text.substr(6,
+            text.size() - 8));
+    }
+    else if (regex::WRONG_check(text))
+    {
+        message.type = Type::WRONG_FRAME;
+        message.number = stoi(text.substr(5, text.size() - 7));
+    }
+    else if (regex::TAKEN_check(text, trick_number))
+    {
+        message.type = Type::TAKEN_FRAME;
+        message.number = trick_number;
+        message.seat = seating::from_char(text[text.size() - 3]);
+        // Cards are between the trick number and the taker.
+        size_t begin = trick_number < 10 ? 6 : 7;
+        message.cards = regex::extract_cards(text.substr(begin,
+            text.size() - begin - 3));
+    }
+    else if (regex::SCORE_check(text) || regex::TOTAL_check(text))
+    {
+        message.type = text[0] == 'S' ? Type::SCORE_FRAME :
+            Type::TOTAL_FRAME;
+        for (const string& seat_score : regex::extract_seat_score(text))
+        {
+            Seat seat = seating::from_char(seat_score[0]);
+            message.scores[seating::index(seat)] =
+                stoi(seat_score.substr(1));
+        }
+    }
+    else if (regex::TRICK_check(text, trick_number))
+    {
+        message.type = Type::TRICK_FRAME;
+        message.number = trick_number;
+        size_t begin = trick_number < 10 ? 6 : 7;
+        message.cards = regex::extract_cards(text.substr(begin,
+            text.size() - begin - 2));
+    }
+    else { return false; }
+    return true;
+}
+
+void frames::to_text(const Message& message, string& text)
+{
+    switch (message.type)
+    {
+        case Type::BUSY_FRAME:
+            text.assign("BUSY");
+            text += message.seats;
+            break;
+        case Type::DEAL_FRAME:
+            text.assign("DEAL");
+            text += std::to_string(message.number);
+            text += seating::to_char(message.seat);
+            break;
+        case Type::TRICK_FRAME:
+            text.assign("TRICK");
+            text += std::to_string(message.number);
+            break;
+        case Type::WRONG_FRAME:
+            text.assign("WRONG");
+            text += std::to_string(message.number);
+            break;
+        case Type::TAKEN_FRAME:
+            text.assign("TAKEN");
+            text += std::to_string(message.number);
+            break;
+        case Type::SCORE_FRAME:
+        case Type::TOTAL_FRAME:
+            text.assign(message.type == Type::SCORE_FRAME ? "SCORE" : "TOTAL");
+            for (Seat seat : seating::ALL_SEATS)
+            {
+                text += seating::to_char(seat);
+                text += std::to_string(message.scores[seating::index(seat)]);
+            }
+            break;
+    }
+    if (message.type == Type::DEAL_FRAME ||
+        message.type == Type::TRICK_FRAME ||
+        message.type == Type::TAKEN_FRAME)
+    {
+        for (const string& card : message.cards) { text += card; }
+    }
+    if (message.type == Type::TAKEN_FRAME)
+    {
+        text += seating::to_char(message.seat);
+    }
+    text += DELIMETER;
+}
+
+int16_t frames::next_message(const string& input, size_t& position,
+    bool b_is_binary, string& message)
+{
+    if (position >= input.size()) { return 0; }
+    if (b_is_binary)
+    {
+        size_t length = (uint8_t)input[position];
+        if (length == 0 || length + 1 > MAX_FRAME_SIZE) { return -1; }
+        if (input.size() - position < length + 1) { return 0; }
+        message.assign(input, position, length + 1);
+        position += length + 1;
+        return 1;
+    }
+    size_t end = input.find(DELIMETER, position);
+    if (end == string::npos)
+    {
+        return input.size() - position > MAX_BUFFER_SIZE ? -1 : 0;
+    }
+    message.assign(input, position, end + 2 - position);
+    position = end + 2;
+    return 1;
+}
+
+bool frames::parse(string& message, bool b_is_binary, int16_t trick_number,
+    Message& parsed)
+{
+    if (!b_is_binary) { return parse_text(message, trick_number, parsed); }
+    if (!decode(message, parsed))
+    {
+        message.assign("(invalid frame)\r\n");
+        return false;
+    }
+    to_text(parsed, message);
+    return true;
+}
+
+ssize_t frames::read_frame(int32_t socket_fd, string& buffer)
+{
+    size_t begin = buffer.size();
+    size_t length = 0;
+    size_t total = 1;
+    while (buffer.size() - begin < total)
+    {
+        char chunk[MAX_FRAME_SIZE];
+        ssize_t bytes_read = read(socket_fd, chunk,
+            total - (buffer.size() - begin));
+        if (bytes_read <= 0) { return bytes_read; }
+        buffer.append(chunk, bytes_read);
+        if (length == 0)
+        {
+            // The length byte is in, the rest of the frame is known.
+            length = (uint8_t)buffer[begin];
+            total = length + 1;
+            if (length == 0 || total > MAX_FRAME_SIZE) { return -1; }
+        }
+    }
+    return total;
+}
@@ -0,0 +1,154 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "seat.h"
+
+// Longest frame with its length byte; SCORE and TOTAL take 18 bytes.
+#define MAX_FRAME_SIZE 32
+
+/*
+* Compact binary protocol, negotiated with the BIN capability in IAM.
+*
+* Every message is a frame: one byte with the length of the rest, one
+* byte of type and the payload. Trick numbers, deal types and seats take
+* one byte, a card takes one byte (rank * 4 + suit, ranks from 2 to A,
+* suits in the order C, D, H, S) and a score four bytes in network order:
+*   BUSY: seats; DEAL: deal type, first seat, 13 cards;
+*   TRICK: trick number, cards; WRONG: trick number;
+*   TAKEN: trick number, 4 cards, taker; SCORE and TOTAL: 4 scores.
+*
+* IAM stays text. A server that speaks the protocol answers a BIN client
+* only with frames; since the length byte is below ' ', a client tells
+* a text server by the first byte it gets and falls back to text.
+*/
+namespace frames
+{
+    using std::string;
+    using std::vector;
+    using std::array;
+    using std::span;
+
+    // Suffixed, the plain names are the messages of the pipes.
+    enum class Type : uint8_t
+    {
+        BUSY_FRAME = 1,
+        DEAL_FRAME = 2,
+        TRICK_FRAME = 3,
+        WRONG_FRAME = 4,
+        TAKEN_FRAME = 5,
+        SCORE_FRAME = 6,
+        TOTAL_FRAME = 7
+    };
+
+    /*
+    * Decoded frame; which fields are set depends on the type.
+    */
+    struct Message
+    {
+        Type type;
+        int16_t number;  // deal type of DEAL, trick number otherwise
+        Seat seat;       // first seat of DEAL, taker of TAKEN
+        vector<string> cards;
+        array<int32_t, 4> scores;
+        string seats;    // seats of BUSY, as in the text protocol
+    };
+
+    /*
+    * Checks if the first byte received comes from a frame, not a text
+    * message.
+    */
+    constexpr bool is_frame_start(char c)
+    {
+        return (unsigned char)c < ' ';
+    }
+
+    /*
+    * Byte of the card, 52 if it is not a card.
+    */
+    uint8_t encode_card(const string& card);
+
+    /*
+    * Writes the card of the byte, null-terminated, to destination.
+    * Returns false if the byte is not a card.
+    */
+    bool decode_card(uint8_t byte, char destination[4]);
+
+    /*
+    * The encoders append the frame, so several can go in one write.
+    */
+    void encode_busy(string& frame, const string& seats);
+
+    void encode_deal(string& frame, int16_t deal_type, Seat start_seat,
+        span<const string> cards);
+
+    void encode_trick(string& frame, int16_t trick_number,
+        span<const string> cards);
+
+    void encode_wrong(string& frame, int16_t trick_number);
+
+    void encode_taken(string& frame, int16_t trick_number,
+        span<const string> cards, Seat taking_seat);
+
+    void encode_scores(string& frame, Type type,
+        const array<int32_t, 4>& scores);
+
+    /*
+    * Decodes a whole frame, length byte included.
+    * Returns false if it is not a valid frame.
+    */
+    bool decode(const string& frame, Message& message);
+
+    /*
+    * Decodes the TRICK a client sends, with exactly one card, without
+    * allocating. Returns false if the frame is anything else.
+    */
+    bool decode_trick(const string& frame, int16_t& trick_number,
+        char card[4]);
+
+    /*
+    * Decodes a text message from the server into the same form as
+    * a frame; TRICK and TAKEN must be of the given trick.
+    * Returns false if the message is not valid.
+    */
+    bool parse_text(const string& text, int16_t trick_number,
+        Message& message);
+
+    /*
+    * Writes the text message the decoded frame stands for; the logs and
+    * the printer of the client work on text.
+    */
+    void to_text(const Message& message, string& text);
+
+    /*
+    * Takes the next complete message of a stream, a frame or a text
+    * line, from position of input and moves position past it.
+    * Returns 1 if one was taken, 0 if it is not complete yet, -1 if
+    * the stream is broken.
+    */
+    int16_t next_message(const string& input, size_t& position,
+        bool b_is_binary, string& message);
+
+    /*
+    * Decodes a message from the server, a frame or a text line; a frame
+    * is replaced by its text, for the logs. Returns false if the message
+    * is not valid.
+    */
+    bool parse(string& message, bool b_is_binary, int16_t trick_number,
+        Message& parsed);
+
+    /*
+    * Reads one frame, length byte included, appending it to buffer.
+    * Returns the number of bytes read, 0 if the peer closed the
+    * connection, -1 on error or a frame longer than MAX_FRAME_SIZE.
+    */
+    ssize_t read_frame(int32_t socket_fd, string& buffer);
+} // namespace frames
+
+#endif // FRAMES_H
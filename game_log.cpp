@@ -0,0 +1,376 @@
+#include "game_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace
+{
+    void put_varint(string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += (char)((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    /*
+    * Reads a varint at position; returns false if the input ends first.
+    */
+    bool get_varint(const string& in, size_t& position, uint64_t& value)
+    {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= in.size()) { return false; }
+            uint8_t byte = in[position++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) { return true; }
+        }
+        return false;
+    }
+
+    uint32_t fnv1a(uint8_t type, const char* data, size_t length)
+    {
+        uint32_t hash = 2166136261u;
+        hash = (hash ^ type) * 16777619u;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    void put_record(string& out, game_log::Record type, const string& payload)
+    {
+        out += (char)type;
+        put_varint(out, payload.size());
+        out += payload;
+        uint32_t hash = fnv1a((uint8_t)type, payload.data(), payload.size());
+        for (int32_t i = 0; i < 4; ++i) { out += (char)(hash >> (8 * i)); }
+    }
+
+    string snapshot_payload(uint64_t deals_finished,
+        const array<int32_t, 4>& total_scores)
+    {
+        string payload;
+        put_varint(payload, deals_finished);
+        for (int32_t score : total_scores) { put_varint(payload, score); }
+        return payload;
+    }
+
+    string event_payload(const game_log::Event& event)
+    {
+        string payload;
+        switch (event.type)
+        {
+            case game_log::Record::DEAL_START:
+                put_varint(payload, event.deal);
+                break;
+            case game_log::Record::PLAY:
+                payload += (char)event.seat;
+                payload += event.card;
+                break;
+            case game_log::Record::TRICK_END:
+                payload += (char)event.seat;
+                put_varint(payload, event.points);
+                break;
+            default:
+                break;
+        }
+        return payload;
+    }
+
+    /*
+    * Decodes the payload of a deal record; returns false if it is broken.
+    */
+    bool parse_event(game_log::Record type, const string& payload,
+        game_log::Event& event)
+    {
+        event = game_log::Event{type, 0, Seat::NONE, {}, 0};
+        size_t position = 0;
+        uint64_t value = 0;
+        switch (type)
+        {
+            case game_log::Record::DEAL_START:
+                if (!get_varint(payload, position, value)) { return false; }
+                event.deal = value;
+                return position == payload.size();
+            case game_log::Record::PLAY:
+                if (payload.size() < 3 || payload.size() > 4) { return false; }
+                event.seat = static_cast<Seat>(payload[0]);
+                payload.copy(event.card, payload.size() - 1, 1);
+                event.card[payload.size() - 1] = '\0';
+                return seating::index(event.seat) < seating::SEATS_NUMBER;
+            case game_log::Record::TRICK_END:
+                if (payload.empty()) { return false; }
+                event.seat = static_cast<Seat>(payload[0]);
+                position = 1;
+                if (!get_varint(payload, position, value)) { return false; }
+                event.points = value;
+                return position == payload.size() &&
+                    seating::index(event.seat) < seating::SEATS_NUMBER;
+            default:
+                return false;
+        }
+    }
+} // namespace
+
+int16_t game_log::recover(const string& file_name, RecoveredGame& game)
+{
+    game = RecoveredGame{0, {}, {}};
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) { return 0; }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    string content = buffer.str();
+    if (content.compare(0, strlen(GAME_LOG_MAGIC), GAME_LOG_MAGIC) != 0)
+    {
+        common::print_error("Not a game log file.");
+        return -1;
+    }
+
+    size_t position = strlen(GAME_LOG_MAGIC);
+    bool b_has_snapshot = false;
+    while (position < content.size())
+    {
+        Record type = static_cast<Record>(content[position++]);
+        uint64_t length = 0;
+        if (!get_varint(content, position, length) ||
+            position + length + 4 > content.size())
+        {
+            break;
+        }
+        string payload = content.substr(position, length);
+        position += length;
+        uint32_t hash = 0;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            hash |= (uint32_t)(uint8_t)content[position++] << (8 * i);
+        }
+        if (hash != fnv1a((uint8_t)type, payload.data(), payload.size()))
+        {
+            break;
+        }
+
+        if (type == Record::SNAPSHOT)
+        {
+            // Only the first record is a snapshot.
+            if (b_has_snapshot) { break; }
+            size_t at = 0;
+            uint64_t value = 0;
+            bool b_is_valid = get_varint(payload, at, game.deals_finished);
+            for (size_t i = 0; i < 4 && b_is_valid; ++i)
+            {
+                b_is_valid = get_varint(payload, at, value);
+                game.total_scores[i] = value;
+            }
+            if (!b_is_valid) { break; }
+            b_has_snapshot = true;
+            continue;
+        }
+        Event event;
+        if (!b_has_snapshot || !parse_event(type, payload, event)) { break; }
+        game.events.push_back(event);
+    }
+    if (position < content.size())
+    {
+        // Expected after a crash in the middle of a write.
+        common::print_error("Game log ends with a broken record.");
+    }
+    if (!b_has_snapshot)
+    {
+        common::print_error("Game log has no snapshot.");
+        return -1;
+    }
+    return 1;
+}
+
+game_log::GameLog::GameLog()
+    : file_name{}, fd{-1}, writer_thread{}, pending_mutex{}, pending_ready{},
+    pending{}, pending_snapshot{}, pending_records{0}, b_is_closing{false},
+    records{0}, commits{0} {}
+
+game_log::GameLog::~GameLog() { close(); }
+
+int16_t game_log::GameLog::open(const string& file_name,
+    const RecoveredGame& game)
+{
+    this->file_name = file_name;
+    string content;
+    put_record(content, Record::SNAPSHOT,
+        snapshot_payload(game.deals_finished, game.total_scores));
+    for (const Event& event : game.events)
+    {
+        put_record(content, event.type, event_payload(event));
+    }
+    if (replace_file(content) < 0) { return -1; }
+
+    try { writer_thread = std::thread(&GameLog::run, this); }
+    catch (const std::system_error& e)
+    {
+        common::print_error(e.what());
+        common::assert_close(fd);
+        fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void game_log::GameLog::log_deal_start(uint64_t deal)
+{
+    string payload;
+    put_varint(payload, deal);
+    append(Record::DEAL_START, payload);
+}
+
+void game_log::GameLog::log_play(Seat seat, const string& card)
+{
+    string payload(1, (char)seat);
+    payload += card;
+    append(Record::PLAY, payload);
+}
+
+void game_log::GameLog::log_trick_end(Seat taker, int32_t points)
+{
+    string payload(1, (char)taker);
+    put_varint(payload, points);
+    append(Record::TRICK_END, payload);
+}
+
+void game_log::GameLog::snapshot(uint64_t deals_finished,
+    const array<int32_t, 4>& total_scores)
+{
+    string content;
+    put_record(content, Record::SNAPSHOT,
+        snapshot_payload(deals_finished, total_scores));
+    pending_mutex.lock();
+    // Records not written yet belong to the finished deal.
+    pending.clear();
+    pending_snapshot = content;
+    ++pending_records;
+    pending_mutex.unlock();
+    pending_ready.notify_one();
+}
+
+void game_log::GameLog::append(Record type, const string& payload)
+{
+    pending_mutex.lock();
+    put_record(pending, type, payload);
+    ++pending_records;
+    pending_mutex.unlock();
+    pending_ready.notify_one();
+}
+
+void game_log::GameLog::run()
+{
+    // Swapped with pending, so both buffers keep their capacity.
+    string batch;
+    string snapshot_batch;
+    ProfiledLock lock(pending_mutex);
+    for (;;)
+    {
+        pending_ready.wait(lock, [this]()
+        {
+            return b_is_closing || !pending.empty() ||
+                !pending_snapshot.empty();
+        });
+        if (pending.empty() && pending_snapshot.empty()) { break; }
+        batch.swap(pending);
+        snapshot_batch.swap(pending_snapshot);
+        records += pending_records;
+        pending_records = 0;
+        lock.unlock();
+
+        if (!snapshot_batch.empty() && replace_file(snapshot_batch) < 0)
+        {
+            common::print_error("Failed to replace the game log.");
+        }
+        if (!batch.empty())
+        {
+            if (common::write_to_socket(fd, batch.data(), batch.size()) !=
+                (ssize_t)batch.size() || fdatasync(fd) < 0)
+            {
+                common::print_error("Failed to write the game log.");
+            }
+        }
+        ++commits;
+        batch.clear();
+        snapshot_batch.clear();
+        lock.lock();
+    }
+}
+
+int16_t game_log::GameLog::replace_file(const string& content)
+{
+    string temporary = file_name + ".tmp";
+    int32_t new_fd = ::open(temporary.c_str(),
+        O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (new_fd < 0)
+    {
+        common::print_error("Failed to create game log file.");
+        return -1;
+    }
+    string data = GAME_LOG_MAGIC + content;
+    if (common::write_to_socket(new_fd, data.data(), data.size()) !=
+        (ssize_t)data.size() || fdatasync(new_fd) < 0 ||
+        rename(temporary.c_str(), file_name.c_str()) < 0)
+    {
+        common::print_error("Failed to write game log file.");
+        common::assert_close(new_fd);
+        unlink(temporary.c_str());
+        return -1;
+    }
+
+    // Make the rename itself durable.
+    size_t slash = file_name.rfind('/');
+    string directory = slash == string::npos ? "." :
+        file_name.substr(0, slash + 1);
+    int32_t directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directory_fd >= 0)
+    {
+        fsync(directory_fd);
+        common::assert_close(directory_fd);
+    }
+
+    if (fd >= 0) { common::assert_close(fd); }
+    fd = new_fd;
+    return 0;
+}
+
+void game_log::GameLog::close()
+{
+    if (writer_thread.joinable())
+    {
+        pending_mutex.lock();
+        b_is_closing = true;
+        pending_mutex.unlock();
+        pending_ready.notify_one();
+        writer_thread.join();
+        std::cerr << "Game log: " << records << " records in " << commits
+            << " commits\n";
+    }
+    if (fd >= 0)
+    {
+        common::assert_close(fd);
+        fd = -1;
+    }
+}
+
+void game_log::GameLog::finish()
+{
+    close();
+    if (!file_name.empty() && unlink(file_name.c_str()) < 0 &&
+        errno != ENOENT)
+    {
+        common::print_error("Failed to remove the game log file.");
+    }
+}
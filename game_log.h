@@ -0,0 +1,156 @@
+#ifndef GAME_LOG_H
+#define GAME_LOG_H
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lock_stats.h"
+#include "seat.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+// First bytes of every game log file.
+#define GAME_LOG_MAGIC "KIERKIW1"
+
+/*
+* Write-ahead log of the game state, so a restarted server can resume
+* the game where the previous one died.
+*
+* The log starts with a snapshot (deals finished and total scores) and
+* continues with the records of the deal in progress: its start, every
+* card played and every trick taken. At the end of a deal the whole file
+* is replaced by a new snapshot, so the log never holds more than one deal
+* and recovery reads a few hundred bytes at most.
+*
+* Records are only appended to memory by the game thread; a writer thread
+* writes whatever accumulated and syncs it in one go (group commit), so
+* no trick waits for the disk. A crash loses at most the last batch.
+*
+* Record layout (integers are LEB128 varints):
+*   type (1 byte), payload length, payload, FNV-1a of type and payload
+*   (4 bytes); a record that does not check ends the log.
+* Payloads:
+*   SNAPSHOT: deals finished, four total scores;
+*   DEAL_START: index of the deal in the game file;
+*   PLAY: seat (1 byte), the card;
+*   TRICK_END: taker (1 byte), points.
+*/
+namespace game_log
+{
+    enum class Record : uint8_t
+    {
+        SNAPSHOT = 1,
+        DEAL_START = 2,
+        PLAY = 3,
+        TRICK_END = 4
+    };
+
+    /*
+    * One record of the deal in progress. Fixed size, so appending it
+    * does not allocate.
+    */
+    struct Event
+    {
+        Record type;
+        uint64_t deal;   // DEAL_START
+        Seat seat;       // PLAY, TRICK_END
+        char card[4];    // PLAY; null-terminated, the longest is "10H"
+        int32_t points;  // TRICK_END
+    };
+
+    /*
+    * State read back from a log.
+    */
+    struct RecoveredGame
+    {
+        uint64_t deals_finished;
+        array<int32_t, 4> total_scores;
+        // Records written after the snapshot, in order.
+        vector<Event> events;
+    };
+
+    /*
+    * Reads the log. Returns 1 if there is a game to resume, 0 if the file
+    * does not exist, -1 if it is not a game log.
+    */
+    int16_t recover(const string& file_name, RecoveredGame& game);
+
+    class GameLog
+    {
+    public:
+        GameLog();
+        ~GameLog();
+        GameLog(const GameLog&) = delete;
+        GameLog& operator=(const GameLog&) = delete;
+
+        /*
+        * Writes a fresh log holding the given state (dropping a broken
+        * tail of a recovered one) and starts the writer thread.
+        * Returns 0 if successful, -1 otherwise.
+        */
+        int16_t open(const string& file_name, const RecoveredGame& game);
+
+        void log_deal_start(uint64_t deal);
+
+        void log_play(Seat seat, const string& card);
+
+        void log_trick_end(Seat taker, int32_t points);
+
+        /*
+        * Replaces the log with a snapshot taken at the end of a deal;
+        * everything logged before is no longer needed.
+        */
+        void snapshot(uint64_t deals_finished,
+            const array<int32_t, 4>& total_scores);
+
+        /*
+        * Writes what is pending, stops the writer thread and prints how
+        * many records went in how many commits; safe to call more than once.
+        */
+        void close();
+
+        /*
+        * Closes the log and removes the file, the game is over.
+        */
+        void finish();
+
+    private:
+        void append(Record type, const string& payload);
+
+        /*
+        * Writer thread: writes and syncs everything appended so far.
+        */
+        void run();
+
+        /*
+        * Atomically replaces the file with one holding the header and
+        * the given records. Called by the writer thread or before it runs.
+        * Returns 0 if successful, -1 otherwise.
+        */
+        int16_t replace_file(const string& content);
+
+        string file_name;
+        int32_t fd;
+        std::thread writer_thread;
+        ProfiledMutex pending_mutex;
+        std::condition_variable_any pending_ready;
+        // Protected by pending_mutex; a non-empty snapshot replaces
+        // the file before the pending records are written.
+        string pending;
+        string pending_snapshot;
+        uint64_t pending_records;
+        bool b_is_closing;
+
+        // Used by the writer thread only.
+        uint64_t records;
+        uint64_t commits;
+    };
+} // namespace game_log
+
+#endif // GAME_LOG_H
@@ -0,0 +1,408 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace
+{
+    thread_local uint64_t bound_connection = 0;
+    thread_local uint64_t sent_bytes = 0;
+
+    // Replay gives up when the server sends nothing for that long.
+    const int64_t STALL_LIMIT_NS = 10000000000ll;
+
+    uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void put_varint(string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += (char)((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    /*
+    * Reads a varint at position; returns false if the input ends first.
+    */
+    bool get_varint(const string& in, size_t& position, uint64_t& value)
+    {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= in.size()) { return false; }
+            uint8_t byte = in[position++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) { return true; }
+        }
+        return false;
+    }
+
+    struct ReplayRecord
+    {
+        journal::Record type;
+        uint64_t connection;
+        uint64_t time;   // since the start of the recording
+        uint64_t sent;   // bytes the server had sent before
+        size_t data_begin;
+        size_t data_length;
+    };
+
+    struct ReplayConnection
+    {
+        int32_t fd;
+        uint64_t received;
+        bool b_is_closed_by_server;
+    };
+} // namespace
+
+void journal::bind_connection(uint64_t connection)
+{
+    bound_connection = connection;
+    sent_bytes = 0;
+}
+
+void journal::count_sent(size_t bytes) { sent_bytes += bytes; }
+
+journal::JournalWriter::JournalWriter()
+    : file{nullptr}, last_time{0}, file_mutex{} {}
+
+journal::JournalWriter::~JournalWriter() { close(); }
+
+int16_t journal::JournalWriter::open(const string& file_name)
+{
+    file = fopen(file_name.c_str(), "wb");
+    if (file == nullptr)
+    {
+        common::print_error("Failed to open journal file.");
+        return -1;
+    }
+    if (fwrite(JOURNAL_MAGIC, 1, strlen(JOURNAL_MAGIC), file) !=
+        strlen(JOURNAL_MAGIC))
+    {
+        common::print_error("Failed to write journal file.");
+        close();
+        return -1;
+    }
+    last_time = now();
+    return 0;
+}
+
+bool journal::JournalWriter::is_open() const { return file != nullptr; }
+
+void journal::JournalWriter::record_accept(uint64_t connection)
+{
+    write_record(Record::ACCEPT, connection, nullptr, false);
+}
+
+void journal::JournalWriter::record_data(const string& data)
+{
+    write_record(Record::DATA, bound_connection, &data, true);
+}
+
+void journal::JournalWriter::record_close()
+{
+    write_record(Record::CLOSE, bound_connection, nullptr, true);
+}
+
+void journal::JournalWriter::write_record(Record type, uint64_t connection,
+    const string* data, bool b_has_sent)
+{
+    string record;
+    // Longest header: type and four varints of at most 10 bytes.
+    record.reserve(41 + (data ? data->size() : 0));
+    record += (char)type;
+    put_varint(record, connection);
+
+    file_mutex.lock();
+    if (file == nullptr)
+    {
+        file_mutex.unlock();
+        return;
+    }
+    // Taking the time under the lock keeps the deltas non-negative.
+    uint64_t time = now();
+    put_varint(record, time - last_time);
+    last_time = time;
+    if (b_has_sent) { put_varint(record, sent_bytes); }
+    if (data != nullptr)
+    {
+        put_varint(record, data->size());
+        record += *data;
+    }
+    if (fwrite(record.data(), 1, record.size(), file) != record.size())
+    {
+        common::print_error("Failed to write journal file.");
+    }
+    file_mutex.unlock();
+}
+
+void journal::JournalWriter::close()
+{
+    file_mutex.lock();
+    if (file != nullptr && fclose(file) != 0)
+    {
+        common::print_error("Failed to close journal file.");
+    }
+    file = nullptr;
+    file_mutex.unlock();
+}
+
+journal::JournalReplayer::JournalReplayer(const string& file_name,
+    int32_t port, bool b_is_fast)
+    : file_name{file_name}, port{port}, b_is_fast{b_is_fast}, content{},
+    replay_thread{}, b_did_fail{false} {}
+
+journal::JournalReplayer::~JournalReplayer()
+{
+    if (replay_thread.joinable()) { replay_thread.join(); }
+}
+
+int16_t journal::JournalReplayer::start()
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open())
+    {
+        common::print_error("Failed to open journal file.");
+        return -1;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    if (content.compare(0, strlen(JOURNAL_MAGIC), JOURNAL_MAGIC) != 0)
+    {
+        common::print_error("Not a journal file.");
+        return -1;
+    }
+
+    try { replay_thread = std::thread(&JournalReplayer::run, this); }
+    catch (const std::system_error& e)
+    {
+        common::print_error(e.what());
+        return -1;
+    }
+    return 0;
+}
+
+int16_t journal::JournalReplayer::join()
+{
+    try { replay_thread.join(); }
+    catch (const std::system_error& e)
+    {
+        common::print_error(e.what());
+        return 1;
+    }
+    return b_did_fail;
+}
+
+void journal::JournalReplayer::run()
+{
+    // Decode everything first, so the replay itself only does I/O.
+    std::vector<ReplayRecord> records;
+    size_t position = strlen(JOURNAL_MAGIC);
+    uint64_t time = 0;
+    while (position < content.size())
+    {
+        ReplayRecord record{};
+        record.type = static_cast<Record>(content[position++]);
+        uint64_t delta = 0;
+        bool b_is_valid = get_varint(content, position, record.connection) &&
+            get_varint(content, position, delta);
+        time += delta;
+        record.time = time;
+        if (b_is_valid && record.type != Record::ACCEPT)
+        {
+            b_is_valid = get_varint(content, position, record.sent);
+        }
+        if (b_is_valid && record.type == Record::DATA)
+        {
+            uint64_t length = 0;
+            b_is_valid = get_varint(content, position, length) &&
+                position + length <= content.size();
+            record.data_begin = position;
+            record.data_length = length;
+            position += length;
+        }
+        if (!b_is_valid || (record.type != Record::ACCEPT &&
+            record.type != Record::DATA && record.type != Record::CLOSE))
+        {
+            // A crash can cut the last record; replay what is complete.
+            common::print_error("Journal ends with a broken record.");
+            break;
+        }
+        records.push_back(record);
+    }
+
+    struct sockaddr_in server_address{};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &server_address.sin_addr);
+
+    std::map<uint64_t, ReplayConnection> connections;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    size_t replayed = 0;
+    char discard[4096];
+    std::vector<struct pollfd> poll_descriptors;
+    uint64_t start = now();
+    uint64_t last_progress = start;
+
+    for (const ReplayRecord& record : records)
+    {
+        // Wait until the record is due and the server caught up.
+        for (;;)
+        {
+            uint64_t current = now();
+            auto iter = connections.find(record.connection);
+            bool b_has_caught_up = record.type == Record::ACCEPT ||
+                iter == connections.end() ||
+                iter->second.received >= record.sent ||
+                iter->second.b_is_closed_by_server;
+            bool b_is_due = b_is_fast || current >= start + record.time;
+            if (b_has_caught_up && b_is_due) { break; }
+            // Only waiting for the server can stall, counted from when
+            // the record fell due; a recorded gap is not a stall.
+            uint64_t waiting_since = b_is_fast ? last_progress :
+                std::max(last_progress, start + record.time);
+            if (!b_has_caught_up && current > waiting_since &&
+                current - waiting_since > STALL_LIMIT_NS)
+            {
+                common::print_error("Replay stalled, the server does not "
+                    "answer as recorded (same game file?).");
+                b_did_fail = true;
+                break;
+            }
+
+            poll_descriptors.clear();
+            for (auto& [id, connection] : connections)
+            {
+                if (!connection.b_is_closed_by_server)
+                {
+                    poll_descriptors.push_back({connection.fd, POLLIN, 0});
+                }
+            }
+            int32_t timeout = 100;
+            if (!b_is_due && b_has_caught_up)
+            {
+                timeout = (start + record.time - current) / 1000000 + 1;
+            }
+            if (poll(poll_descriptors.data(), poll_descriptors.size(),
+                timeout) < 0 && errno != EINTR)
+            {
+                common::print_error("Failed to poll in replay.");
+                b_did_fail = true;
+                break;
+            }
+            for (auto& [id, connection] : connections)
+            {
+                if (connection.b_is_closed_by_server) { continue; }
+                for (;;)
+                {
+                    ssize_t result = read(connection.fd, discard,
+                        sizeof(discard));
+                    if (result > 0)
+                    {
+                        connection.received += result;
+                        bytes_received += result;
+                        last_progress = now();
+                        continue;
+                    }
+                    if (result == 0) { connection.b_is_closed_by_server = true; }
+                    break;
+                }
+            }
+        }
+        if (b_did_fail) { break; }
+
+        if (record.type == Record::ACCEPT)
+        {
+            int32_t fd = -1;
+            // The server may still be starting its connection thread.
+            for (int32_t attempt = 0; attempt < 500 && fd < 0; ++attempt)
+            {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                if (fd < 0) { break; }
+                if (connect(fd, (struct sockaddr*)&server_address,
+                    sizeof(server_address)) < 0)
+                {
+                    common::assert_close(fd);
+                    fd = -1;
+                    usleep(10000);
+                }
+            }
+            if (fd < 0)
+            {
+                common::print_error("Replay failed to connect.");
+                b_did_fail = true;
+                break;
+            }
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            connections[record.connection] = ReplayConnection{fd, 0, false};
+        }
+        else
+        {
+            auto iter = connections.find(record.connection);
+            if (iter == connections.end()) { continue; }
+            ReplayConnection& connection = iter->second;
+            if (record.type == Record::DATA)
+            {
+                size_t written = 0;
+                while (written < record.data_length)
+                {
+                    ssize_t result = write(connection.fd, content.data() +
+                        record.data_begin + written,
+                        record.data_length - written);
+                    if (result < 0 && (errno == EAGAIN || errno == EINTR))
+                    {
+                        usleep(100);
+                        continue;
+                    }
+                    if (result <= 0) { break; }
+                    written += result;
+                }
+                bytes_sent += written;
+            }
+            else
+            {
+                common::assert_close(connection.fd);
+                connections.erase(iter);
+                if (b_is_fast) { usleep(JOURNAL_CLOSE_PAUSE_MS * 1000); }
+            }
+        }
+        ++replayed;
+        last_progress = now();
+    }
+
+    for (auto& [id, connection] : connections)
+    {
+        common::assert_close(connection.fd);
+    }
+
+    double seconds = (now() - start) / 1e9;
+    char line[256];
+    snprintf(line, sizeof(line), "Replay: %lu of %lu records, %lu bytes "
+        "sent, %lu bytes received in %.3f s (%.0f records/s)\n", replayed,
+        records.size(), bytes_sent, bytes_received, seconds,
+        seconds > 0 ? replayed / seconds : 0.0);
+    cerr << line;
+    if (replayed != records.size()) { b_did_fail = true; }
+}
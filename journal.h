@@ -0,0 +1,134 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "lock_stats.h"
+
+using std::string;
+
+// First bytes of every journal file.
+#define JOURNAL_MAGIC "KIERKIJ1"
+// Pause after closing a connection when replaying as fast as possible,
+// so the server frees the seat before the next connection asks for it.
+#define JOURNAL_CLOSE_PAUSE_MS 10
+
+/*
+* Record and replay of the server's network input.
+*
+* The journal holds, in the order the server saw them, the accepted
+* connections, every message read from a client and the closed
+* connections, each with the time since the previous record. Every message
+* also stores how many bytes the server had sent on that connection
+* before it arrived, which makes the replay causal: a message is sent only
+* after the replaying client received what the original one had.
+*
+* Record layout (integers are LEB128 varints):
+*   type (1 byte), connection, time delta in ns,
+*   DATA: bytes sent before, length, the bytes;
+*   CLOSE: bytes sent before.
+*/
+namespace journal
+{
+    enum class Record : uint8_t
+    {
+        ACCEPT = 1,
+        DATA = 2,
+        CLOSE = 3
+    };
+
+    /*
+    * Makes the calling thread the one of the given connection and starts
+    * its count of sent bytes from zero. The server reads from and writes
+    * to a connection only from that connection's thread.
+    */
+    void bind_connection(uint64_t connection);
+
+    /*
+    * Adds bytes successfully sent on the calling thread's connection.
+    */
+    void count_sent(size_t bytes);
+
+    class JournalWriter
+    {
+    public:
+        JournalWriter();
+        ~JournalWriter();
+        JournalWriter(const JournalWriter&) = delete;
+        JournalWriter& operator=(const JournalWriter&) = delete;
+
+        /*
+        * Creates the file and writes the header.
+        * Returns 0 if successful, -1 otherwise.
+        */
+        int16_t open(const string& file_name);
+
+        bool is_open() const;
+
+        void record_accept(uint64_t connection);
+
+        /*
+        * Records a message read on the calling thread's connection.
+        */
+        void record_data(const string& data);
+
+        /*
+        * Records the end of the calling thread's connection.
+        */
+        void record_close();
+
+        /*
+        * Flushes and closes the file; safe to call more than once.
+        */
+        void close();
+
+    private:
+        void write_record(Record type, uint64_t connection,
+            const string* data, bool b_has_sent);
+
+        FILE* file;
+        uint64_t last_time;
+        ProfiledMutex file_mutex;
+    };
+
+    /*
+    * Plays a journal against a server listening on the given port of the
+    * loopback, from its own thread, either with the recorded timing or as
+    * fast as the causal order allows.
+    */
+    class JournalReplayer
+    {
+    public:
+        JournalReplayer() = delete;
+        JournalReplayer(const string& file_name, int32_t port,
+            bool b_is_fast);
+        ~JournalReplayer();
+
+        /*
+        * Reads the journal and starts the replaying thread.
+        * Returns 0 if successful, -1 otherwise.
+        */
+        int16_t start();
+
+        /*
+        * Waits for the replay to finish and prints its statistics.
+        * Returns 0 if the whole journal was replayed, 1 otherwise.
+        */
+        int16_t join();
+
+    private:
+        void run();
+
+        string file_name;
+        int32_t port;
+        bool b_is_fast;
+        string content;
+        std::thread replay_thread;
+        bool b_did_fail;
+    };
+} // namespace journal
+
+#endif // JOURNAL_H
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "cmd_args_parsers.h"
+#include "common.h"
+#include "policy_table.h"
+#include "work_pool.h"
+
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+
+namespace
+{
+    // Tables of one job of the pool, so the queues stay short.
+    constexpr uint64_t TABLES_PER_JOB = 1024;
+} // namespace
+
+/*
+* Tournament of the strategies of the AI client over seeded deals, on all
+* the cores: -n tables, each deal played four times with the seats
+* rotated. The policy strategy plays with the table of -L, the search one
+* with the budget of -t milliseconds a move. The ratings are updated as
+* every table ends; the progress goes to the standard error every second
+* and the ratings, as JSON lines, to the standard output at the end. The
+* same seed gives the same deals.
+*/
+int main(int argc, char* argv[])
+{
+    uint64_t tables = 100000;
+    uint64_t seed = 1;
+    // hardware_concurrency is 0 when the number of cores is not known.
+    int32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    int16_t deal_type = 0;
+    vector<string> entrant_names;
+    string policy_path;
+    int32_t search_budget_ms = 0;
+
+    int16_t result = parser::parse_arena_args(argc, argv, tables, seed,
+        threads, deal_type, entrant_names, policy_path, search_budget_ms);
+    if (result != 0) {return result;}
+
+    std::shared_ptr<PolicyTable> policy;
+    if (!policy_path.empty())
+    {
+        policy = std::make_shared<PolicyTable>();
+        if (policy->map(policy_path) != 0) {return 1;}
+    }
+    vector<arena::Strategy> strategies = arena::strategies(policy,
+        search_budget_ms);
+    vector<arena::Strategy> entrants;
+    for (const string& name : entrant_names)
+    {
+        auto strategy = std::find_if(strategies.begin(), strategies.end(),
+            [&name](const arena::Strategy& known)
+            { return known.name == name; });
+        if (strategy == strategies.end())
+        {
+            common::print_error("No strategy " + name +
+                " (policy needs -L, search needs -t).");
+            return 1;
+        }
+        entrants.push_back(*strategy);
+    }
+    if (entrants.empty()) { entrants = strategies; }
+
+    auto start = std::chrono::steady_clock::now();
+    arena::Ratings ratings(entrants.size());
+    WorkPool pool(threads);
+    pool.start((tables + TABLES_PER_JOB - 1) / TABLES_PER_JOB,
+        [&](size_t job, size_t)
+    {
+        uint64_t end = std::min(tables, (job + 1) * TABLES_PER_JOB);
+        for (uint64_t table = job * TABLES_PER_JOB; table < end; ++table)
+        {
+            arena::play_table(entrants, deal_type, seed, table, ratings);
+        }
+    });
+
+    auto reported = start;
+    uint64_t done;
+    while ((done = ratings.get_tables()) < tables)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1))
+        {
+            reported = now;
+            double seconds = std::chrono::duration<double>(
+                now - start).count();
+            cerr << "Arena: " << done << " of " << tables << " tables, "
+                << (uint64_t)(done / seconds) << " tables/s\n";
+        }
+    }
+    pool.wait();
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    cerr << "Arena: " << tables << " tables in " << seconds << " s, "
+        << (uint64_t)(seconds > 0 ? tables / seconds : 0)
+        << " tables/s on " << pool.get_threads() << " threads\n";
+    ratings.report(cout, entrants);
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cmd_args_parsers.h"
+#include "common.h"
+#include "deal_jobs.h"
+#include "file_reader.h"
+#include "solver.h"
+#include "work_pool.h"
+
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+/*
+* Runs a job on every deal of a game file on a work-stealing pool of
+* threads: solving the deal (-m solve, as kierki-solver does), playing it
+* out with the bot of the server (-m simulate) or scoring that play under
+* every deal type (-m score). Results go to the output file, or to the
+* standard output, one JSON line per deal in the order of the file,
+* as soon as the deals before are done; the progress and the throughput
+* go to the standard error every second.
+*/
+int main(int argc, char* argv[])
+{
+    string game_file_name;
+    string output_file_name;
+    string job_name = "simulate";
+    // hardware_concurrency is 0 when the number of cores is not known.
+    int32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    int32_t table_size_log2 = 22;
+    int32_t tricks = 13;
+
+    int16_t result = parser::parse_batch_args(argc, argv, game_file_name,
+        output_file_name, job_name, threads, table_size_log2, tricks);
+    if (result != 0) {return result;}
+
+    // The cards are parsed by the jobs, so reading the file is all that
+    // is left to one thread.
+    FileReader reader(game_file_name);
+    vector<deal_jobs::DealText> deals;
+    ssize_t read_result;
+    while ((read_result = reader.read_next_deal()) > 0)
+    {
+        deals.push_back(deal_jobs::deal_text(reader));
+    }
+    if (read_result < 0)
+    {
+        common::print_error("Failed to open the game file.");
+        return 1;
+    }
+
+    std::ofstream output_file;
+    if (!output_file_name.empty())
+    {
+        output_file.open(output_file_name);
+        if (!output_file)
+        {
+            common::print_error("Failed to open the output file.");
+            return 1;
+        }
+    }
+    std::ostream& output = output_file_name.empty() ? cout : output_file;
+
+    // The solvers of all the threads share one table.
+    std::unique_ptr<TranspositionTable> table;
+    vector<std::unique_ptr<Solver>> solvers;
+    if (job_name == "solve")
+    {
+        table = std::make_unique<TranspositionTable>(table_size_log2);
+        for (int32_t i = 0; i < threads; ++i)
+        {
+            solvers.push_back(std::make_unique<Solver>(*table));
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    OrderedResults results(deals.size());
+    WorkPool pool(threads);
+    pool.start(deals.size(), [&](size_t index, size_t worker)
+    {
+        deal_jobs::Deal deal;
+        int32_t number = index + 1;
+        if (!deal_jobs::parse_deal(deals[index], number, deal))
+        {
+            common::print_error("Deal " + std::to_string(number) +
+                " is not valid.");
+            results.put(index, "{\"deal\":" + std::to_string(number) +
+                ",\"error\":\"not valid\"}");
+        }
+        else if (job_name == "solve")
+        {
+            results.put(index, deal_jobs::solve(deal, *solvers[worker],
+                tricks));
+        }
+        else if (job_name == "simulate")
+        {
+            results.put(index, deal_jobs::simulate(deal));
+        }
+        else { results.put(index, deal_jobs::score(deal)); }
+    });
+
+    vector<string> ready;
+    size_t written = 0;
+    double reported = 0;
+    while (written < deals.size())
+    {
+        written += results.take(ready, std::chrono::milliseconds(1000));
+        for (const string& line : ready) { output << line << '\n'; }
+        ready.clear();
+        double seconds = seconds_since(start);
+        if (seconds - reported >= 1)
+        {
+            reported = seconds;
+            size_t done = results.get_done();
+            cerr << "Batch: " << done << " of " << deals.size()
+                << " deals, " << (uint64_t)(done / seconds) << " deals/s\n";
+        }
+    }
+    pool.wait();
+    output.flush();
+
+    double seconds = seconds_since(start);
+    cerr << "Batch: " << deals.size() << " deals in " << seconds << " s, "
+        << (uint64_t)(seconds > 0 ? deals.size() / seconds : 0)
+        << " deals/s on " << pool.get_threads() << " threads, "
+        << pool.get_steals() << " stolen\n";
+    if (!output)
+    {
+        common::print_error("Failed to write the results.");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,434 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <array>
+#include <vector>
+#include <memory_resource>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "bench.h"
+#include "cmd_args_parsers.h"
+#include "common.h"
+#include "regex.h"
+#include "senders.h"
+#include "points_calculator.h"
+#include "file_reader.h"
+#include "frames.h"
+#include "ai_player.h"
+
+using std::cout;
+using std::cerr;
+using std::string;
+using std::array;
+using std::vector;
+
+namespace
+{
+    const string HAND_13 = "QSJCKHJD4CAH8DKCJH7C5HAS6S";
+    const array<string, 4> TABLE = {"QH", "KH", "10S", "2H"};
+
+    void bench_regex(bench::Runner& runner)
+    {
+        const array<std::pair<const char*, string>, 7> checks = {{
+            {"IAM_check", "IAMN\r\n"},
+            {"BUSY_check", "BUSYNES\r\n"},
+            {"DEAL_check", "DEAL1N" + HAND_13 + "\r\n"},
+            {"TRICK_client_check", "TRICK1210H\r\n"},
+            {"WRONG_check", "WRONG12\r\n"},
+            {"SCORE_check", "SCOREN12E0S7W104\r\n"},
+            {"TOTAL_check", "TOTALN120E10S70W1040\r\n"}}};
+        bool (*functions[])(const string&) = {regex::IAM_check,
+            regex::BUSY_check, regex::DEAL_check, regex::TRICK_client_check,
+            regex::WRONG_check, regex::SCORE_check, regex::TOTAL_check};
+        for (size_t i = 0; i < checks.size(); ++i)
+        {
+            const string& message = checks[i].second;
+            auto function = functions[i];
+            runner.run(string("regex/") + checks[i].first, [&]()
+            {
+                bench::do_not_optimize(function(message));
+            });
+        }
+
+        const string trick = "TRICK12QH10S\r\n";
+        runner.run("regex/TRICK_check", [&]()
+        {
+            bench::do_not_optimize(regex::TRICK_check(trick, 12));
+        });
+        const string taken = "TAKEN12QHKH10S2HN\r\n";
+        runner.run("regex/TAKEN_check", [&]()
+        {
+            bench::do_not_optimize(regex::TAKEN_check(taken, 12));
+        });
+
+        runner.run("regex/extract_cards", [&]()
+        {
+            vector<string> cards = regex::extract_cards(HAND_13);
+            bench::do_not_optimize(cards.data());
+        });
+        std::pmr::vector<string> cards;
+        runner.run("regex/extract_cards_pmr", [&]()
+        {
+            cards.clear();
+            regex::extract_cards(HAND_13, cards);
+            bench::do_not_optimize(cards.data());
+        });
+        runner.run("regex/extract_trick_nr", [&]()
+        {
+            string number = regex::extract_trick_nr(trick);
+            bench::do_not_optimize(number.data());
+        });
+        const string score = "N12E0S7W104";
+        runner.run("regex/extract_seat_score", [&]()
+        {
+            vector<string> scores = regex::extract_seat_score(score);
+            bench::do_not_optimize(scores.data());
+        });
+    }
+
+    void bench_senders(bench::Runner& runner, int32_t null_fd)
+    {
+        string message;
+        vector<string> hand = regex::extract_cards(HAND_13);
+        const array<int32_t, 4> scores = {12, 0, 7, 104};
+        const string seat = "N";
+        const string seats = "NES";
+        const string card = "10H";
+
+        runner.run("senders/send_iam", [&]()
+        {
+            bench::do_not_optimize(senders::send_iam(null_fd, seat, message));
+        });
+        runner.run("senders/send_busy", [&]()
+        {
+            bench::do_not_optimize(senders::send_busy(null_fd, seats,
+                message));
+        });
+        runner.run("senders/send_deal", [&]()
+        {
+            bench::do_not_optimize(senders::send_deal(null_fd, 1, Seat::N,
+                hand, message));
+        });
+        runner.run("senders/send_trick", [&]()
+        {
+            bench::do_not_optimize(senders::send_trick(null_fd, 12,
+                {TABLE.data(), 3}, message));
+        });
+        runner.run("senders/send_trick_card", [&]()
+        {
+            bench::do_not_optimize(senders::send_trick(null_fd, 12, card,
+                message));
+        });
+        runner.run("senders/send_wrong", [&]()
+        {
+            bench::do_not_optimize(senders::send_wrong(null_fd, 12, message));
+        });
+        runner.run("senders/send_taken", [&]()
+        {
+            bench::do_not_optimize(senders::send_taken(null_fd, 12, TABLE,
+                Seat::N, message));
+        });
+        runner.run("senders/send_score", [&]()
+        {
+            bench::do_not_optimize(senders::send_score(null_fd, scores,
+                message));
+        });
+        runner.run("senders/send_total", [&]()
+        {
+            bench::do_not_optimize(senders::send_total(null_fd, scores,
+                message));
+        });
+    }
+
+    void bench_protocol(bench::Runner& runner)
+    {
+        // What one seat of a deal gets and sends: DEAL, a TRICK and
+        // a TAKEN per trick, SCORE and TOTAL, and its own 13 cards.
+        vector<string> hand = regex::extract_cards(HAND_13);
+        vector<frames::Message> messages;
+        messages.push_back({frames::Type::DEAL_FRAME, 1, Seat::N, hand,
+            {}, ""});
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            size_t on_table = trick % 4;
+            messages.push_back({frames::Type::TRICK_FRAME, trick, Seat::N,
+                {TABLE.begin(), TABLE.begin() + on_table}, {}, ""});
+            messages.push_back({frames::Type::TAKEN_FRAME, trick, Seat::E,
+                {TABLE.begin(), TABLE.end()}, {}, ""});
+        }
+        messages.push_back({frames::Type::SCORE_FRAME, 0, Seat::N, {},
+            {12, 0, 7, 104}, ""});
+        messages.push_back({frames::Type::TOTAL_FRAME, 0, Seat::N, {},
+            {120, 10, 70, 1040}, ""});
+
+        vector<string> texts;
+        vector<string> binaries;
+        for (const frames::Message& message : messages)
+        {
+            texts.emplace_back();
+            frames::to_text(message, texts.back());
+            string frame;
+            switch (message.type)
+            {
+                case frames::Type::DEAL_FRAME:
+                    frames::encode_deal(frame, message.number, message.seat,
+                        message.cards);
+                    break;
+                case frames::Type::TRICK_FRAME:
+                    frames::encode_trick(frame, message.number,
+                        message.cards);
+                    break;
+                case frames::Type::TAKEN_FRAME:
+                    frames::encode_taken(frame, message.number,
+                        message.cards, message.seat);
+                    break;
+                default:
+                    frames::encode_scores(frame, message.type,
+                        message.scores);
+                    break;
+            }
+            binaries.push_back(frame);
+        }
+        vector<string> client_texts;
+        vector<string> client_binaries;
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            client_texts.push_back("TRICK" + std::to_string(trick) +
+                hand[trick - 1] + DELIMETER);
+            client_binaries.emplace_back();
+            frames::encode_trick(client_binaries.back(), trick,
+                {hand.data() + trick - 1, 1});
+        }
+
+        uint64_t text_bytes = 0;
+        uint64_t binary_bytes = 0;
+        for (const string& text : texts) { text_bytes += text.size(); }
+        for (const string& text : client_texts) { text_bytes += text.size(); }
+        for (const string& frame : binaries) { binary_bytes += frame.size(); }
+        for (const string& frame : client_binaries)
+        {
+            binary_bytes += frame.size();
+        }
+        const uint64_t operations = texts.size() + client_texts.size();
+
+        frames::Message parsed;
+        runner.run("protocol/deal_text", [&]()
+        {
+            for (size_t i = 0; i < texts.size(); ++i)
+            {
+                // TRICK and TAKEN alternate after DEAL.
+                int16_t trick = i == 0 ? 0 : std::min<int16_t>((i + 1) / 2,
+                    13);
+                bench::do_not_optimize(frames::parse_text(texts[i], trick,
+                    parsed));
+            }
+            for (const string& text : client_texts)
+            {
+                bench::do_not_optimize(regex::TRICK_client_check(text));
+                string number = regex::extract_trick_nr(text);
+                bench::do_not_optimize(number.data());
+            }
+        }, operations, text_bytes);
+
+        char card[4];
+        int16_t trick_number;
+        runner.run("protocol/deal_binary", [&]()
+        {
+            for (const string& frame : binaries)
+            {
+                bench::do_not_optimize(frames::decode(frame, parsed));
+            }
+            for (const string& frame : client_binaries)
+            {
+                bench::do_not_optimize(frames::decode_trick(frame,
+                    trick_number, card));
+            }
+        }, operations, binary_bytes);
+    }
+
+    void bench_ai(bench::Runner& runner)
+    {
+        // A deal as one AI seat sees it: N leads every trick with the
+        // last card of its hand, the other hands follow.
+        vector<string> hand = regex::extract_cards(HAND_13);
+        array<vector<string>, 3> others = {
+            regex::extract_cards("4DQD9S10S10D3S2SACKS8H9DAD2H"),
+            regex::extract_cards("10HQC9H5C7D3D6D7S2C3H5S3C8S"),
+            regex::extract_cards("8C2DKD4S6H4H7H9C5D6CJSQH10C")};
+        vector<frames::Message> messages;
+        messages.push_back({frames::Type::DEAL_FRAME, 1, Seat::N, hand,
+            {}, ""});
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            messages.push_back({frames::Type::TRICK_FRAME, trick, Seat::N,
+                {}, {}, ""});
+            vector<string> taken = {hand[13 - trick]};
+            for (const vector<string>& other : others)
+            {
+                taken.push_back(other[trick - 1]);
+            }
+            messages.push_back({frames::Type::TAKEN_FRAME, trick, Seat::N,
+                taken, {}, ""});
+        }
+        messages.push_back({frames::Type::SCORE_FRAME, 0, Seat::N, {},
+            {12, 0, 7, 104}, ""});
+        messages.push_back({frames::Type::TOTAL_FRAME, 0, Seat::N, {},
+            {120, 10, 70, 1040}, ""});
+
+        runner.run("ai/deal", [&]()
+        {
+            AiPlayer player('N', true);
+            for (const frames::Message& message : messages)
+            {
+                string card = player.handle_message(message);
+                bench::do_not_optimize(card.data());
+            }
+        }, messages.size());
+    }
+
+    void bench_socket(bench::Runner& runner)
+    {
+        // Messages per call; small enough to fit in the socket buffer.
+        const size_t BATCH = 64;
+        int32_t fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        {
+            common::print_error("Failed to create socketpair.");
+            return;
+        }
+        string batch;
+        for (size_t i = 0; i < BATCH; ++i) { batch += "TRICK12QH\r\n"; }
+        string drain(batch.size(), '\0');
+
+        // Baseline: the same writes, drained with a single read.
+        runner.run("socket/write_batch", [&]()
+        {
+            common::write_to_socket(fds[0], batch.data(), batch.size());
+            size_t left = batch.size();
+            while (left > 0)
+            {
+                ssize_t result = read(fds[1], drain.data(), left);
+                if (result <= 0) { break; }
+                left -= result;
+            }
+        }, BATCH);
+
+        string buffer;
+        runner.run("socket/read_from_socket", [&]()
+        {
+            common::write_to_socket(fds[0], batch.data(), batch.size());
+            for (size_t i = 0; i < BATCH; ++i)
+            {
+                buffer.clear();
+                bench::do_not_optimize(common::read_from_socket(fds[1],
+                    buffer));
+            }
+        }, BATCH);
+
+        common::assert_close(fds[0]);
+        common::assert_close(fds[1]);
+    }
+
+    void bench_points(bench::Runner& runner)
+    {
+        for (int16_t type = 1; type <= 7; ++type)
+        {
+            runner.run("points/type_" + std::to_string(type), [&]()
+            {
+                PointsCalculator calculator(TABLE, Seat::E, type, 7);
+                bench::do_not_optimize(calculator.calculate_points());
+            });
+        }
+    }
+
+    void bench_file_reader(bench::Runner& runner, int32_t deals)
+    {
+        char file_name[] = "/tmp/kierki-bench-XXXXXX";
+        int32_t fd = mkstemp(file_name);
+        if (fd < 0)
+        {
+            common::print_error("Failed to create the game file.");
+            return;
+        }
+        common::assert_close(fd);
+        {
+            std::ofstream file(file_name);
+            for (int32_t i = 0; i < deals; ++i)
+            {
+                file << (i % 7 + 1) << "NESW"[i % 4] << "\n"
+                    << "QSJCKHJD4CAH8DKCJH7C5HAS6S\n"
+                    << "4DQD9S10S10D3S2SACKS8H9DAD2H\n"
+                    << "10HQC9H5C7D3D6D7S2C3H5S3C8S\n"
+                    << "8C2DKD4S6H4H7H9C5D6CJSQH10C\n";
+            }
+        }
+
+        runner.run("file_reader/read_next_deal", [&]()
+        {
+            FileReader reader(file_name);
+            while (reader.read_next_deal() > 0)
+            {
+                bench::do_not_optimize(reader.get_cards());
+            }
+        }, deals);
+        unlink(file_name);
+    }
+
+    void bench_log(bench::Runner& runner)
+    {
+        // The log goes to cout; send it nowhere for the measurement.
+        std::ofstream null_stream("/dev/null");
+        std::streambuf* cout_buffer = cout.rdbuf(null_stream.rdbuf());
+        ProfiledMutex log_mutex;
+        struct sockaddr_in6 source{};
+        struct sockaddr_in6 destination{};
+        source.sin6_family = AF_INET6;
+        destination.sin6_family = AF_INET6;
+        inet_pton(AF_INET6, "::1", &source.sin6_addr);
+        inet_pton(AF_INET6, "::ffff:127.0.0.1", &destination.sin6_addr);
+        source.sin6_port = htons(1234);
+        destination.sin6_port = htons(54321);
+        const string message = "TRICK12QH10S\r\n";
+
+        runner.run("log/print_log", [&]()
+        {
+            common::print_log(source, destination, message, log_mutex);
+        });
+        cout.rdbuf(cout_buffer);
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    string filter;
+    int32_t sample_time = 100;
+    int32_t samples = 5;
+    int32_t deals = 100000;
+
+    int16_t result = parser::parse_bench_args(argc, argv, filter,
+        sample_time, samples, deals);
+    if (result != 0) {return result;}
+
+    int32_t null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0)
+    {
+        common::print_error("Failed to open /dev/null.");
+        return 1;
+    }
+
+    bench::Runner runner(filter, sample_time, samples);
+    bench_regex(runner);
+    bench_senders(runner, null_fd);
+    bench_protocol(runner);
+    bench_ai(runner);
+    bench_socket(runner);
+    bench_points(runner);
+    bench_file_reader(runner, deals);
+    bench_log(runner);
+    common::assert_close(null_fd);
+
+    runner.report(cout);
+    return 0;
+}
@@ -1,10 +1,14 @@
 #include <iostream>
+#include <algorithm>
 #include <iterator>
+#include <memory>
 #include <exception>
 #include <string>
+#include <thread>
 
 #include "cmd_args_parsers.h"
 #include "klient.h"
+#include "klient_host.h"
 
 using std::cout;
 using std::cerr;
@@ -22,11 +26,41 @@ int main(int argc, char* argv[])
     int16_t ip_version = -1;
     string seat;
     bool AI = false;
+    bool b_is_bot = false;
+    bool b_is_pre = false;
+    bool b_is_binary = false;
+    int32_t seats = 0;
+    bool b_is_multiplexed = false;
+    int32_t timeout = 0;
+    // hardware_concurrency is 0 when the number of cores is not known.
+    int32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    string policy_path;
 
     int16_t result = parser::parse_client_args(argc, argv, host_name,
-        port, ip_version, seat, AI);
+        port, ip_version, seat, AI, b_is_bot, b_is_pre, b_is_binary, seats,
+        b_is_multiplexed, timeout, threads, policy_path);
     if (result != 0) {return result;}
 
-    Klient klient(host_name, port, ip_version, seat, AI);
+    std::shared_ptr<PolicyTable> policy;
+    if (!policy_path.empty())
+    {
+        policy = std::make_shared<PolicyTable>();
+        if (policy->map(policy_path) != 0) {return 1;}
+    }
+
+    string capabilities;
+    if (b_is_bot) {capabilities += "+BOT";}
+    if (b_is_pre) {capabilities += "+PRE";}
+    if (b_is_binary) {capabilities += "+BIN";}
+    if (seats > 0)
+    {
+        KlientHost klient_host(host_name, port, ip_version, seats,
+            capabilities, b_is_multiplexed, policy);
+        return klient_host.run();
+    }
+    // A quarter of the timeout searches a move, the rest is left for the
+    // network and the server.
+    Klient klient(host_name, port, ip_version, seat, AI, capabilities,
+        timeout * 1000 / 4, threads, policy);
     return klient.run_client();
 }
@@ -0,0 +1,24 @@
+#include <string>
+
+#include "cmd_args_parsers.h"
+#include "loadgen.h"
+
+using std::string;
+
+int main(int argc, char* argv[])
+{
+    string host_name = "localhost";
+    int32_t port = 0;
+    int32_t tables = 1;
+    int32_t think_time = 0;
+    int32_t connect_rate = 0;
+    int32_t duration = 0;
+
+    int16_t result = parser::parse_loadgen_args(argc, argv, host_name,
+        port, tables, think_time, connect_rate, duration);
+    if (result != 0) {return result;}
+
+    LoadGenerator generator(host_name, port, tables, think_time,
+        connect_rate, duration);
+    return generator.run();
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "card_model.h"
+#include "cmd_args_parsers.h"
+#include "common.h"
+#include "policy_table.h"
+#include "work_pool.h"
+
+using std::cerr;
+using std::string;
+using std::vector;
+
+namespace
+{
+    // Deals of one job of the pool, so the queues stay short.
+    constexpr uint64_t DEALS_PER_JOB = 1024;
+
+    /*
+    * Points taken after every choice of a suit, and how many times it
+    * was chosen, by entry and suit.
+    */
+    struct Statistics
+    {
+        explicit Statistics(size_t size) : points(size), choices(size) {}
+
+        vector<std::atomic<uint64_t>> points;
+        vector<std::atomic<uint64_t>> choices;
+    };
+
+    /*
+    * Plays deal number deal of the seed. Every lead and discard is a card
+    * of a suit of the hand drawn at random, every other card the one the
+    * AI of the client follows with (the first of the suit dealt); at the
+    * end, the points of every seat go to the statistics of each suit it
+    * drew.
+    */
+    void simulate_deal(uint64_t seed, uint64_t deal, Statistics& statistics)
+    {
+        std::mt19937_64 random(seed * 0x9E3779B97F4A7C15ULL + deal);
+        array<uint8_t, NO_CARD> deck;
+        for (uint8_t card = 0; card < NO_CARD; ++card) { deck[card] = card; }
+        for (size_t i = NO_CARD - 1; i > 0; --i)
+        {
+            std::swap(deck[i], deck[random() % (i + 1)]);
+        }
+        int16_t deal_type = 1 + random() % 7;
+        Seat leader = seating::ALL_SEATS[random() % 4];
+
+        array<array<uint8_t, 13>, 4> hands;
+        array<size_t, 4> sizes;
+        array<card_set_t, 4> sets{};
+        for (size_t seat = 0; seat < 4; ++seat)
+        {
+            for (size_t i = 0; i < 13; ++i)
+            {
+                hands[seat][i] = deck[seat * 13 + i];
+                sets[seat] |= 1ULL << hands[seat][i];
+            }
+            sizes[seat] = 13;
+        }
+
+        // The statistics of the choices of every seat, by entry and suit.
+        array<array<size_t, 13>, 4> choices;
+        array<size_t, 4> choices_number{};
+        array<int32_t, 4> points{};
+        for (int16_t trick = 1; trick <= 13; ++trick)
+        {
+            card_set_t table = 0;
+            uint8_t led_suit = PolicyTable::NO_POLICY;
+            uint8_t top = NO_CARD;
+            Seat taker = leader;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                Seat seat = seating::next(leader, i);
+                size_t index = seating::index(seat);
+                card_set_t hand = sets[index];
+                bool b_follows = i > 0 &&
+                    (hand & CardModel::suit_cards(led_suit)) != 0;
+                size_t position = 0;
+                if (b_follows)
+                {
+                    position = CardModel::bot_position(
+                        span(hands[index].data(), sizes[index]), led_suit);
+                }
+                else
+                {
+                    PolicyTable::Decision decision = i == 0 ?
+                        PolicyTable::Decision::LEAD :
+                        PolicyTable::Decision::DISCARD;
+                    uint8_t suit;
+                    do { suit = random() % 4; }
+                    while ((hand & CardModel::suit_cards(suit)) == 0);
+                    uint8_t card = PolicyTable::policy_card(decision, hand,
+                        suit);
+                    while (hands[index][position] != card) { ++position; }
+                    choices[index][choices_number[index]++] =
+                        PolicyTable::index(deal_type, decision, hand) * 4 +
+                        suit;
+                }
+
+                uint8_t card = hands[index][position];
+                for (size_t j = position + 1; j < sizes[index]; ++j)
+                {
+                    hands[index][j - 1] = hands[index][j];
+                }
+                --sizes[index];
+                sets[index] &= ~(1ULL << card);
+                table |= 1ULL << card;
+                if (i == 0) { led_suit = card % 4; }
+                // Cards of a suit grow with the rank.
+                if (card % 4 == led_suit && (top == NO_CARD || card > top))
+                {
+                    top = card;
+                    taker = seat;
+                }
+            }
+            points[seating::index(taker)] += CardModel::trick_points(
+                deal_type, trick, table);
+            leader = taker;
+        }
+
+        for (size_t seat = 0; seat < 4; ++seat)
+        {
+            for (size_t i = 0; i < choices_number[seat]; ++i)
+            {
+                size_t choice = choices[seat][i];
+                statistics.points[choice].fetch_add(points[seat],
+                    std::memory_order_relaxed);
+                statistics.choices[choice].fetch_add(1,
+                    std::memory_order_relaxed);
+            }
+        }
+    }
+} // namespace
+
+/*
+* Makes a policy table for the AI (kierki-klient -L) from -n simulated
+* deals: for every deal type, decision and hand shape, the suit after
+* which the seat took the fewest points on average, if every suit it
+* tried was tried at least -m times.
+*/
+int main(int argc, char* argv[])
+{
+    string output_file_name;
+    uint64_t deals = 1000000;
+    uint64_t seed = 1;
+    // hardware_concurrency is 0 when the number of cores is not known.
+    int32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    int32_t min_choices = 32;
+
+    int16_t result = parser::parse_policy_args(argc, argv, output_file_name,
+        deals, seed, threads, min_choices);
+    if (result != 0) {return result;}
+
+    auto start = std::chrono::steady_clock::now();
+    Statistics statistics(PolicyTable::ENTRIES * 4);
+    WorkPool pool(threads);
+    pool.start((deals + DEALS_PER_JOB - 1) / DEALS_PER_JOB,
+        [&](size_t job, size_t)
+    {
+        uint64_t end = std::min(deals, (job + 1) * DEALS_PER_JOB);
+        for (uint64_t deal = job * DEALS_PER_JOB; deal < end; ++deal)
+        {
+            simulate_deal(seed, deal, statistics);
+        }
+    });
+    pool.wait();
+
+    vector<uint8_t> entries(PolicyTable::ENTRIES, PolicyTable::NO_POLICY);
+    size_t filled = 0;
+    for (size_t entry = 0; entry < entries.size(); ++entry)
+    {
+        double best_mean = 0;
+        bool b_is_known = false;
+        for (uint8_t suit = 0; suit < 4; ++suit)
+        {
+            uint64_t choices = statistics.choices[entry * 4 + suit];
+            if (choices == 0) { continue; }
+            if (choices < (uint64_t)min_choices)
+            {
+                b_is_known = false;
+                break;
+            }
+            double mean = (double)statistics.points[entry * 4 + suit] /
+                choices;
+            if (!b_is_known || mean < best_mean)
+            {
+                entries[entry] = suit;
+                best_mean = mean;
+                b_is_known = true;
+            }
+        }
+        if (b_is_known) { ++filled; }
+        else { entries[entry] = PolicyTable::NO_POLICY; }
+    }
+    if (PolicyTable::write(output_file_name, entries) != 0) { return 1; }
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    cerr << "Policy: " << deals << " deals in " << seconds << " s, "
+        << (uint64_t)(seconds > 0 ? deals / seconds : 0) << " deals/s, "
+        << filled << " entries of " << entries.size() << " set\n";
+    return 0;
+}
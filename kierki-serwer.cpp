@@ -6,6 +6,7 @@
 #include "cmd_args_parsers.h"
 #include "serwer.h"
 #include "file_reader.h"
+#include "trace.h"
 
 using std::cout;
 using std::cerr;
@@ -19,13 +20,35 @@ int main(int argc, char* argv[])
     int32_t port = 0;
     string game_file_name;
     int32_t timeout = 5;
+    string metrics_path;
+    string trace_path;
+    string record_path;
+    string replay_path;
+    bool b_is_replay_fast = false;
+    string game_log_path;
+    int32_t bot_grace = -1;
+    bool b_is_bot_table = false;
     
     int16_t result = parser::parse_server_args(argc, argv, port,
-        game_file_name, timeout);
+        game_file_name, timeout, metrics_path, trace_path, record_path,
+        replay_path, b_is_replay_fast, game_log_path, bot_grace,
+        b_is_bot_table);
     if (result != 0) {return result;}
+    if (!trace_path.empty()) {tracing::enable();}
 
-    Serwer s(port, timeout, game_file_name);
-    if (s.start_game() == 0) {return s.run_game();}
-    else {return 1;}
-    return 0;
+    // The replay plays the clients, it must run before the first barrier.
+    journal::JournalReplayer replayer(replay_path, port, b_is_replay_fast);
+    if (!replay_path.empty() && replayer.start() < 0) {return 1;}
+
+    Serwer s(port, timeout, game_file_name, metrics_path, record_path,
+        game_log_path, bot_grace, b_is_bot_table);
+    result = 1;
+    if (s.start_game() == 0) {result = s.run_game();}
+    if (!replay_path.empty() && replayer.join() != 0) {result = 1;}
+    // All the traced threads are joined by now.
+    if (!trace_path.empty() && tracing::export_chrome_trace(trace_path) < 0)
+    {
+        result = 1;
+    }
+    return result;
 }
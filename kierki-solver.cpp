@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+
+#include "cmd_args_parsers.h"
+#include "common.h"
+#include "deal_jobs.h"
+#include "file_reader.h"
+#include "solver.h"
+
+using std::cout;
+using std::string;
+
+/*
+* Solves every deal of a game file under each of the seven deal types and
+* prints a JSON line per deal, the one of kierki-batch -m solve: the
+* points every seat can hold itself to against the three others under
+* every type, and the time and positions taken.
+* With -k, only the last tricks are solved, the ones before played by the
+* bot of the server; full deals take far longer than their endings.
+*/
+int main(int argc, char* argv[])
+{
+    string game_file_name;
+    int32_t table_size_log2 = 22;
+    int32_t tricks = 13;
+
+    int16_t result = parser::parse_solver_args(argc, argv, game_file_name,
+        table_size_log2, tricks);
+    if (result != 0) {return result;}
+
+    TranspositionTable table(table_size_log2);
+    Solver solver(table);
+    FileReader reader(game_file_name);
+    int32_t deal = 0;
+    ssize_t read_result;
+    while ((read_result = reader.read_next_deal()) > 0)
+    {
+        ++deal;
+        deal_jobs::Deal dealt;
+        if (!deal_jobs::parse_deal(deal_jobs::deal_text(reader), deal,
+            dealt))
+        {
+            common::print_error("Deal " + std::to_string(deal) +
+                " is not valid.");
+            continue;
+        }
+        cout << deal_jobs::solve(dealt, solver, tricks) << '\n';
+    }
+    if (read_result < 0)
+    {
+        common::print_error("Failed to open the game file.");
+        return 1;
+    }
+    return 0;
+}
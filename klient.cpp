@@ -1,29 +1,36 @@
 #include "klient.h"
 
 Klient::Klient(const string& host, int32_t port, int16_t ip,
-    const string& seat_name, bool AI) : server_address{}, 
-    server6_address{}, client_address{}, client6_address{}, host_name{host},
-    port_number{port}, ip_version{ip}, seat{seat_name}, is_ai{AI}, 
-    access_mutex{}, messages_to_send{}, taken_tricks{}, 
-    played_cards{}, trick_number{1}, got_score{false}, got_total{false},
-    expected_color{"none"}
+    const string& seat_name, bool AI, const string& capabilities,
+    int32_t search_budget_ms, int32_t search_threads,
+    std::shared_ptr<const PolicyTable> policy)
+    : server_address{}, server6_address{}, client_address{},
+    client6_address{}, host_name{host}, port_number{port}, ip_version{ip},
+    seat{seat_name}, is_ai{AI}, capabilities{capabilities},
+    ai_player{seat_name[0], AI && regex::has_capability("IAM" + seat_name +
+    capabilities + DELIMETER, "PRE"), search_budget_ms, search_threads,
+    std::move(policy)},
+    b_wants_binary{regex::has_capability("IAM" + seat_name + capabilities +
+    DELIMETER, "BIN")}, b_is_protocol_known{false}, b_is_binary{false},
+    access_mutex{}, messages_to_send{}, taken_tricks{}, trick_number{1},
+    got_score{false}, got_total{false}
     { signal(SIGPIPE, SIG_IGN); }
 
 void Klient::print_logs(const string& msg, bool b_is_sender)
 {
+    // Only the AI logs, and it runs on one thread.
+    if (!is_ai) { return; }
     if (b_is_sender)
     {
         if (ip_version == 4) { common::print_log(client_address,
-            server_address, msg, access_mutex, is_ai); }
-        else { common::print_log(client6_address, server6_address,
-            msg, access_mutex, is_ai); }
+            server_address, msg); }
+        else { common::print_log(client6_address, server6_address, msg); }
     }
     else
     {
         if (ip_version == 4) { common::print_log(server_address,
-            client_address, msg, access_mutex, is_ai); }
-        else { common::print_log(server6_address, client6_address,
-            msg, access_mutex, is_ai); }
+            client_address, msg); }
+        else { common::print_log(server6_address, client6_address, msg); }
     }
 }
 
@@ -140,69 +147,47 @@ int16_t Klient::assert_client_write_pipe(ssize_t result,
     return 0;
 }
 
-int16_t Klient::prepare_client()
+int32_t Klient::connect_to_server()
 {
-    if (pipe(client_read_pipe))
-    {
-        common::print_error("Failed to create pipes.", access_mutex);
-        return -1;
-    }
-    else if (pipe(client_write_pipe) < 0)
-    {
-        close(client_read_pipe[0]);
-        close(client_read_pipe[1]);
-        common::print_error("Failed to create pipes.", access_mutex);
-        return -1;
-    }
-
-    ssize_t result = -1;
-    if (ip_version == 4) { result = common::get_server_ipv4_addr
-        (host_name.c_str(), port_number, server_address); }
-    else if (ip_version == 6) { result = common::get_server_ipv6_addr
-        (host_name.c_str(), port_number, server6_address); }
-    else 
-    {
-        result = common::get_server_unknown_addr
-            (host_name.c_str(), port_number, server_address, server6_address);
-        if (result == 0) { ip_version = 4; }
-        else { ip_version = 6; }
-    }
- 
-    if (result < 0)
-    {
-        close_pipe_sockets();
-        return -1;
-    }
+    int32_t family = AF_UNSPEC;
+    if (ip_version == 4) { family = AF_INET; }
+    else if (ip_version == 6) { family = AF_INET6; }
+    vector<struct sockaddr_storage> addresses;
+    if (common::get_server_addresses(host_name.c_str(), port_number,
+        family, addresses) < 0) { return -1; }
 
-    // Create a socket.
-    int32_t socket_fd = -1;
-    if (ip_version == 4) { socket_fd = common::create_socket(); }
-    else { socket_fd = common::create_socket6(); }
+    // All the addresses race, so a dead one costs an attempt delay
+    // instead of a TCP timeout.
+    auto start = std::chrono::steady_clock::now();
+    size_t winner = 0;
+    int32_t socket_fd = common::connect_first(addresses, winner);
     if (socket_fd < 0) { return -1; }
+    std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - start;
 
-    if (ip_version == 4) 
+    const struct sockaddr_storage& address = addresses[winner];
+    char address_text[INET6_ADDRSTRLEN] = "";
+    if (address.ss_family == AF_INET)
     {
-        if (connect(socket_fd, (struct sockaddr *) &server_address,
-                    (socklen_t) sizeof(server_address)) < 0)
-        {
-            common::print_error("Failed to connect to server.", access_mutex);
-            common::assert_close(socket_fd);
-            close_pipe_sockets();
-            return -1;
-        }
+        ip_version = 4;
+        server_address = *(const struct sockaddr_in*)&address;
+        inet_ntop(AF_INET, &server_address.sin_addr, address_text,
+            sizeof(address_text));
     }
     else
     {
-        if (connect(socket_fd, (struct sockaddr *) &server6_address,
-                    (socklen_t) sizeof(server6_address)) < 0)
-        {
-            common::print_error("Failed to connect to server.", access_mutex);
-            common::assert_close(socket_fd);
-            close_pipe_sockets();
-            return -1;
-        }
+        ip_version = 6;
+        server6_address = *(const struct sockaddr_in6*)&address;
+        inet_ntop(AF_INET6, &server6_address.sin6_addr, address_text,
+            sizeof(address_text));
+    }
+    // Like the other logs, only for the AI; a player reads the game.
+    if (is_ai)
+    {
+        cerr << "Connected to " << address_text << " in "
+            << latency.count() << " ms, address " << winner + 1 << " of "
+            << addresses.size() << ".\n";
     }
-
 
     socklen_t client_address_len = sizeof(client_address);
     socklen_t client6_address_len = sizeof(client6_address);
@@ -212,11 +197,34 @@ int16_t Klient::prepare_client()
         (struct sockaddr *) &client6_address, &client6_address_len); }
 
     string msg;
-    ssize_t send_result = senders::send_iam(socket_fd, seat, msg);
+    ssize_t send_result = senders::send_iam(socket_fd, seat, msg,
+        capabilities);
     print_logs(msg, true);
     if (send_result != (ssize_t)msg.size())
     {
-        common::print_error("Failed to send seat name.", access_mutex);
+        common::print_error("Failed to send seat name.");
+        common::assert_close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+int16_t Klient::prepare_client()
+{
+    int32_t socket_fd = connect_to_server();
+    if (socket_fd < 0) { return -1; }
+
+    if (pipe(client_read_pipe))
+    {
+        common::print_error("Failed to create pipes.");
+        common::assert_close(socket_fd);
+        return -1;
+    }
+    else if (pipe(client_write_pipe) < 0)
+    {
+        close(client_read_pipe[0]);
+        close(client_read_pipe[1]);
+        common::print_error("Failed to create pipes.");
         common::assert_close(socket_fd);
         return -1;
     }
@@ -227,39 +235,138 @@ int16_t Klient::prepare_client()
     }
     catch (const system_error& e)
     {
-        common::print_error(e.what(), access_mutex);
+        common::print_error(e.what());
         common::assert_close(socket_fd);
+        close_pipe_sockets();
         return -1;
     }
     return socket_fd;
 }
 
+int16_t Klient::run_ai()
+{
+    int32_t socket_fd = connect_to_server();
+    if (socket_fd < 0) { return 1; }
+    // Answers are small and must not wait for the previous ones' ACK.
+    int32_t flag = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    string input;
+    char buffer[4096];
+    vector<string> received;
+    vector<string> sent;
+    string reply;
+    frames::Message parsed{};
+    for (;;)
+    {
+        ssize_t bytes_read = read(socket_fd, buffer, sizeof(buffer));
+        if (bytes_read < 0 && errno == EINTR) { continue; }
+        if (bytes_read <= 0)
+        {
+            common::assert_close(socket_fd);
+            if (bytes_read == 0 && ai_player.is_finished()) { return 0; }
+            common::print_error(bytes_read == 0 ? "Server disconnected." :
+                "Failed to read from socket.");
+            return 1;
+        }
+        input.append(buffer, bytes_read);
+
+        size_t position = 0;
+        size_t received_count = 0;
+        size_t sent_count = 0;
+        int16_t result = 0;
+        bool b_is_busy = false;
+        reply.clear();
+        while (!b_is_busy && position < input.size())
+        {
+            if (b_wants_binary && !b_is_protocol_known)
+            {
+                // A text server ignores BIN, its messages start with
+                // a letter.
+                b_is_binary = frames::is_frame_start(input[position]);
+                b_is_protocol_known = true;
+            }
+            if (received.size() == received_count) { received.emplace_back(); }
+            string& message = received[received_count];
+            result = frames::next_message(input, position, b_is_binary,
+                message);
+            if (result <= 0) { break; }
+            ++received_count;
+            if (!frames::parse(message, b_is_binary,
+                ai_player.get_trick_number(), parsed)) { continue; }
+            b_is_busy = parsed.type == frames::Type::BUSY_FRAME;
+
+            string card = ai_player.handle_message(parsed);
+            if (card.empty()) { continue; }
+            int16_t trick_number = ai_player.get_trick_number();
+            if (sent.size() == sent_count) { sent.emplace_back(); }
+            string& text = sent[sent_count++];
+            text.assign("TRICK");
+            text += std::to_string(trick_number);
+            text += card;
+            text += DELIMETER;
+            if (b_is_binary)
+            {
+                frames::encode_trick(reply, trick_number, {&card, 1});
+            }
+            else { reply += text; }
+        }
+        input.erase(0, position);
+
+        // The answer goes first, the logs after it.
+        if (!reply.empty() && common::write_to_socket(socket_fd,
+            reply.data(), reply.size()) != (ssize_t)reply.size())
+        {
+            common::print_error("Failed to send message to server.");
+            common::assert_close(socket_fd);
+            return 1;
+        }
+        for (size_t i = 0; i < received_count; ++i)
+        {
+            print_logs(received[i], false);
+        }
+        for (size_t i = 0; i < sent_count; ++i) { print_logs(sent[i], true); }
+        if (b_is_busy)
+        {
+            common::assert_close(socket_fd);
+            return 0;
+        }
+        if (result < 0)
+        {
+            common::print_error("Invalid message from server.");
+            common::assert_close(socket_fd);
+            return 1;
+        }
+    }
+}
+
 int16_t Klient::run_client()
 {
+    if (is_ai)
+    {
+        int16_t result = run_ai();
+        ai_player.report_search(cerr);
+        return result;
+    }
     int32_t socket_fd = prepare_client();
     if (socket_fd < 0) { return 1; }
 
     struct pollfd poll_fds[2];
     poll_fds[0].fd = client_read_pipe[0];
     poll_fds[0].events = POLLIN;
-    if (!is_ai) 
-    {
-        poll_fds[1].fd = STDIN_FILENO;
-        poll_fds[1].events = POLLIN;
-    }
+    poll_fds[1].fd = STDIN_FILENO;
+    poll_fds[1].events = POLLIN;
     while (true)
     {
         poll_fds[0].revents = 0;
         poll_fds[1].revents = 0;
-        int32_t poll_result = 0;
-        if (is_ai) { poll_result = poll(poll_fds, 1, -1); }
-        else { poll_result = poll(poll_fds, 2, -1); }
+        int32_t poll_result = poll(poll_fds, 2, -1);
         if (poll_result <= 0)
         {
             close_main("Failed to poll in main client.", DISCONNECTED);
             return 1;
         }
-        if (!is_ai && (poll_fds[1].revents & POLLIN))
+        if (poll_fds[1].revents & POLLIN)
         { // Standard stream.
             string message;
             getline(cin, message);
@@ -323,34 +430,117 @@ int16_t Klient::run_client()
     }
 }
 
-string Klient::strategy(const string& color)
+string* Klient::frame_for_server(string& frame)
+{
+    return b_is_binary ? &frame : nullptr;
+}
+
+ssize_t Klient::read_message(int32_t socket_fd, string& message,
+    frames::Message& parsed, bool& b_is_known)
 {
-    if (my_cards.size() == 0) { return ""; }
-    if (color == "")
+    if (b_wants_binary && !b_is_protocol_known)
     {
-        string result = my_cards[my_cards.size() - 1];
-        my_cards.pop_back();
-        played_cards.push_back(result);
-        return result;
+        // A text server ignores BIN, its messages start with a letter.
+        char first;
+        ssize_t peek_result = recv(socket_fd, &first, 1, MSG_PEEK);
+        if (peek_result <= 0) { return peek_result; }
+        b_is_binary = frames::is_frame_start(first);
+        b_is_protocol_known = true;
     }
 
-    for (auto iter = my_cards.begin(); iter != my_cards.end(); ++iter)
+    if (b_is_binary)
     {
-        if ((*iter)[iter->size() - 1] == color[0])
+        string frame;
+        ssize_t result = frames::read_frame(socket_fd, frame);
+        if (result <= 0) { return result; }
+        if (!frames::decode(frame, parsed))
         {
-            string result = (*iter);
-            my_cards.erase(iter);
-            played_cards.push_back(result);
+            message.assign("(invalid frame)\r\n");
             return result;
         }
+        frames::to_text(parsed, message);
+        b_is_known = true;
+        return result;
     }
-    
-    string result = my_cards[my_cards.size() - 1];
-    my_cards.pop_back();
-    played_cards.push_back(result);
+
+    ssize_t result = common::read_from_socket(socket_fd, message);
+    if (result <= 0) { return result; }
+    access_mutex.lock();
+    int16_t trick_loc = trick_number;
+    access_mutex.unlock();
+    b_is_known = frames::parse_text(message, trick_loc, parsed);
     return result;
 }
 
+int16_t Klient::handle_message(int32_t socket_fd, const string& message,
+    const frames::Message& parsed)
+{
+    access_mutex.lock();
+    int16_t trick_loc = trick_number;
+    // Frames carry any trick number, text is checked against the current
+    // one by the regex.
+    if ((parsed.type == frames::Type::TAKEN_FRAME ||
+        parsed.type == frames::Type::TRICK_FRAME) &&
+        parsed.number != trick_loc)
+    {
+        access_mutex.unlock();
+        return 0;
+    }
+
+    switch (parsed.type)
+    {
+        case frames::Type::BUSY_FRAME:
+            client_printer::print_busy(message);
+            access_mutex.unlock();
+            // End game.
+            close_worker(socket_fd, "", NORMAL_END);
+            return -1;
+        case frames::Type::DEAL_FRAME:
+            trick_number = 1;
+            got_score = false;
+            got_total = false;
+            taken_tricks.clear();
+            client_printer::print_deal(message);
+            my_cards = parsed.cards;
+            access_mutex.unlock();
+            return 0;
+        case frames::Type::WRONG_FRAME:
+            client_printer::print_wrong(trick_number);
+            access_mutex.unlock();
+            return 0;
+        case frames::Type::TAKEN_FRAME:
+            client_printer::print_taken(message, trick_loc);
+            for (const string& card : parsed.cards)
+            {
+                auto iter = find(my_cards.begin(), my_cards.end(), card);
+                if (iter != my_cards.end()) { my_cards.erase(iter); }
+            }
+            if (seating::to_char(parsed.seat) == seat[0])
+            {
+                taken_tricks.emplace_back(parsed.cards);
+            }
+            ++trick_number;
+            access_mutex.unlock();
+            return 0;
+        case frames::Type::SCORE_FRAME:
+            got_score = true;
+            client_printer::print_score(message);
+            access_mutex.unlock();
+            return 0;
+        case frames::Type::TOTAL_FRAME:
+            got_total = true;
+            client_printer::print_total(message);
+            access_mutex.unlock();
+            return 0;
+        case frames::Type::TRICK_FRAME:
+            client_printer::print_trick(message, trick_number, my_cards);
+            access_mutex.unlock();
+            return 0;
+    }
+    access_mutex.unlock();
+    return 0;
+}
+
 void Klient::handle_client(int32_t socket_fd)
 {
     struct pollfd poll_fds[2];
@@ -389,26 +579,17 @@ void Klient::handle_client(int32_t socket_fd)
                     access_mutex.lock();
                     string card = messages_to_send.front();
                     messages_to_send.pop();
-                    if (is_ai)
-                    {
-                        auto iter = find(my_cards.begin(),
-                            my_cards.end(), card);
-                        if (iter != my_cards.end() && (card[card.size() - 1] ==
-                            expected_color[0] || expected_color == ""))
-                        {
-                            my_cards.erase(iter);
-                            played_cards.push_back(card);
-                            expected_color = "none";
-                        }
-                    }
                     access_mutex.unlock();
 
                     string msg;
+                    string frame;
                     ssize_t send_result = senders::send_trick
-                        (socket_fd, trick_number, {card}, msg);
+                        (socket_fd, trick_number, card, msg,
+                        frame_for_server(frame));
                     print_logs(msg, true);
-                    if (assert_client_write_socket
-                        (send_result, msg.length(), socket_fd) < 0) { return; }
+                    if (assert_client_write_socket(send_result,
+                        senders::wire_size(msg, frame_for_server(frame)),
+                        socket_fd) < 0) { return; }
                 }
                 else
                 {
@@ -429,127 +610,19 @@ void Klient::handle_client(int32_t socket_fd)
             if (poll_fds[1].revents & POLLIN)
             { // Message from the server.
                 string message;
-                ssize_t socket_result = 
-                    common::read_from_socket(socket_fd, message);
+                frames::Message parsed{};
+                bool b_is_known = false;
+                ssize_t socket_result = read_message(socket_fd, message,
+                    parsed, b_is_known);
                 print_logs(message, false);
                 if (assert_client_read_socket
                     (socket_result, socket_fd) < 0) { return; }
-                access_mutex.lock();
-                int16_t trick_loc = trick_number;
-
-                if (regex::BUSY_check(message))
+                // else: ignore messages.
+                if (b_is_known &&
+                    handle_message(socket_fd, message, parsed) < 0)
                 {
-                    if (!is_ai)
-                    {
-                        client_printer::print_busy(message);
-                        access_mutex.unlock();
-                    }
-
-                    // End game.
-                    close_worker(socket_fd, "", NORMAL_END);
                     return;
                 }
-                else if(regex::DEAL_check(message))
-                {
-                    trick_number = 1;
-                    got_score = false;
-                    got_total = false;
-                    taken_tricks.clear();
-                    if (!is_ai) { client_printer::print_deal(message); }
-                    message = message.substr(6, message.size() - 8);
-                    my_cards = regex::extract_cards(message);
-                    access_mutex.unlock();
-                }
-                else if (regex::WRONG_check(message))
-                {
-                    if (!is_ai) { client_printer::print_wrong(trick_number); }
-                    access_mutex.unlock();
-                }
-                else if (regex::TAKEN_check(message, trick_loc))
-                {
-                    if (!is_ai) { client_printer::print_taken
-                        (message, trick_loc); }
-                    string cards;
-                    char taker = message[message.size() - 3];
-                    if (trick_number < 10) 
-                    {
-                        cards = message.substr(6, message.size() - 9);
-                    }
-                    else 
-                    {
-                        cards = message.substr(7, message.size() - 10);
-                    }
-                    vector<string> extracted_cards
-                        {regex::extract_cards(cards)};
-                    for (const string& card : played_cards)
-                    {
-                        my_cards.push_back(card);
-                    }
-                    played_cards.clear();
-                    for (const string& card : extracted_cards) 
-                    {
-                        auto iter = find(my_cards.begin(),
-                            my_cards.end(), card);
-                        if (iter != my_cards.end()) { my_cards.erase(iter); }
-                    }
-                    if (taker == seat[0]) { taken_tricks
-                        .emplace_back(extracted_cards); }
-                    ++trick_number;
-                    access_mutex.unlock();
-                }
-                else if (regex::SCORE_check(message))
-                {
-                    got_score = true;
-                    if (!is_ai) { client_printer::print_score(message); }
-                    access_mutex.unlock();
-                }
-                else if (regex::TOTAL_check(message))
-                {
-                    got_total = true;
-                    if (!is_ai) { client_printer::print_total(message); }
-                    access_mutex.unlock();
-                }
-                else if (regex::TRICK_check(message, trick_loc))
-                {
-                    string msg_copy{message};
-                    string color;
-                    if (message.size() <= 9) { color = ""; }
-                    else
-                    {
-                        if (trick_loc < 10) { message =
-                                message.substr(6, message.size() - 8); }
-                        else { message = 
-                            message.substr(7, message.size() - 9); }
-                        string first_card
-                            {regex::extract_cards(message)[0]};
-                        color = first_card[first_card.size() - 1];
-                    }
-                    expected_color = color;
-                    if (!is_ai) 
-                    {
-                        client_printer::print_trick(msg_copy,
-                            trick_number, my_cards);
-                        access_mutex.unlock();
-                    }
-                    else
-                    {
-                        // Time to send a card back to the server.
-                        string card_to_play = strategy(color);
-                        string msg;
-                        ssize_t send_result = senders::send_trick
-                            (socket_fd, trick_number, {card_to_play}, msg);
-                        access_mutex.unlock();
-                        print_logs(msg, true);
-
-                        if (assert_client_write_socket
-                            (send_result, msg.length(), socket_fd) < 0) 
-                        {
-                            return;
-                        }
-                    }
-                }
-                // else: ignore messages.
-                else { access_mutex.unlock(); }
             }
             else if(poll_fds[1].revents & POLLERR)
             {
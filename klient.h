@@ -17,11 +17,15 @@
 #include <poll.h>
 #include <algorithm>
 #include <signal.h>
+#include <cerrno>
+#include <netinet/tcp.h>
 
+#include "ai_player.h"
 #include "common.h"
 #include "regex.h"
 #include "senders.h"
 #include "klient_printer.h"
+#include "frames.h"
 
 using std::string;
 using std::thread;
@@ -39,7 +43,10 @@ class Klient
 public:
     Klient() = delete;
     Klient(const string& host, int32_t port, int16_t ip,
-        const string& seat_name, bool AI);
+        const string& seat_name, bool AI,
+        const string& capabilities = "", int32_t search_budget_ms = 0,
+        int32_t search_threads = 0,
+        std::shared_ptr<const PolicyTable> policy = nullptr);
     ~Klient() = default;
 
     /*
@@ -100,11 +107,25 @@ private:
 
     /*
     * Utility function to get the server socket. Depending on the IP version,
-    * it will create either IPv4 or IPv6 socket. On soccess, it will return
-    * the socket file descriptor. On failure, it will return -1.
+    * it will create either IPv4 or IPv6 socket, connect it and send IAM.
+    * On success, it will return the socket file descriptor.
+    * On failure, it will return -1.
+    */
+    int32_t connect_to_server();
+
+    /*
+    * Connects to the server and starts the interaction_thread with the
+    * pipes to it. Returns the socket file descriptor, -1 on failure.
     */
     int16_t prepare_client();
 
+    /*
+    * Plays as the AI on the calling thread alone: reads what the server
+    * sent, answers every TRICK through ai_player, then logs. No pipes,
+    * worker thread nor locks. Returns 0 if the game ended, 1 otherwise.
+    */
+    int16_t run_ai();
+
     /*
     * Function passed to the interaction_thread. It will handle the interaction
     * with the server.
@@ -112,10 +133,26 @@ private:
     void handle_client(int32_t socket_fd);
 
     /*
-    * Function responsible for choosing the card
-    * to play in the current trick if the client is AI.
+    * Reads one message from the server, a frame or a text line, and
+    * decodes it; message gets its text, for the logs and the printer.
+    * Returns the result of the read; b_is_known is false for a message
+    * the client ignores.
     */
-    string strategy(const string& color);
+    ssize_t read_message(int32_t socket_fd, string& message,
+        frames::Message& parsed, bool& b_is_known);
+
+    /*
+    * Updates the game with a message from the server and answers it.
+    * Returns -1 if the worker has to stop, 0 otherwise.
+    */
+    int16_t handle_message(int32_t socket_fd, const string& message,
+        const frames::Message& parsed);
+
+    /*
+    * The given frame buffer if the server talks in frames, null otherwise;
+    * passed to the senders.
+    */
+    string* frame_for_server(string& frame);
 
     /*
     * Wrapper for the common::print_log functions,
@@ -138,19 +175,26 @@ private:
     int16_t ip_version;
     string seat;
     bool is_ai;
-
-    mutex access_mutex;
+    // Appended to IAM, e.g. "+BOT".
+    string capabilities;
+    // Game and play of the AI; pre-commits if it announced PRE.
+    AiPlayer ai_player;
+    // BIN was announced; the server answers with frames if it knows them,
+    // which the first byte it sends tells. Used by the worker thread only.
+    bool b_wants_binary;
+    bool b_is_protocol_known;
+    bool b_is_binary;
+
+    ProfiledMutex access_mutex;
 
     queue<string> messages_to_send;
     vector<vector<string>> taken_tricks;
 
     vector<string> my_cards;
-    vector<string> played_cards;
     int16_t trick_number;
 
     bool got_score;
     bool got_total;
-    string expected_color;
 };
 
 #endif // KLIENT_H
\ No newline at end of file
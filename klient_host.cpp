@@ -0,0 +1,416 @@
+#include "klient_host.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+#include "regex.h"
+
+namespace
+{
+    const char SEATS[] = {'N', 'E', 'S', 'W'};
+} // namespace
+
+KlientHost::KlientHost(const string& host, int32_t port, int16_t ip,
+    int32_t seats, const string& capabilities, bool b_is_multiplexed,
+    std::shared_ptr<const PolicyTable> policy)
+    : host{host}, port{port}, ip_version{ip}, seats_number{seats},
+    capabilities{capabilities}, b_is_multiplexed{b_is_multiplexed},
+    b_wants_binary{regex::has_capability("IAMN" + capabilities + DELIMETER,
+    "BIN")}, policy{std::move(policy)}, server_addresses{}, epoll_fd{-1},
+    connections{}, seats{}, open_connections{0}
+    { signal(SIGPIPE, SIG_IGN); }
+
+KlientHost::~KlientHost()
+{
+    for (Connection& connection : connections)
+    {
+        if (connection.fd >= 0) { common::assert_close(connection.fd); }
+    }
+    if (epoll_fd >= 0) { common::assert_close(epoll_fd); }
+}
+
+void KlientHost::print_logs(const Connection& connection,
+    const string& message, bool b_is_sender)
+{
+    if (connection.ip_version == 4)
+    {
+        if (b_is_sender) { common::print_log(connection.local_address,
+            connection.remote_address, message); }
+        else { common::print_log(connection.remote_address,
+            connection.local_address, message); }
+    }
+    else
+    {
+        if (b_is_sender) { common::print_log(connection.local6_address,
+            connection.remote6_address, message); }
+        else { common::print_log(connection.remote6_address,
+            connection.local6_address, message); }
+    }
+}
+
+int16_t KlientHost::open_connection(int32_t table,
+    const vector<size_t>& table_seats)
+{
+    connections.emplace_back();
+    Connection& connection = connections.back();
+    connection.seats = table_seats;
+    connection.b_is_hello_pending = b_is_multiplexed;
+    connection.b_is_waiting_to_write = false;
+    connection.open_seats = table_seats.size();
+    connection.local_address = {};
+    connection.local6_address = {};
+    connection.remote_address = {};
+    connection.remote6_address = {};
+
+    // The server of the table listens on its own port.
+    vector<struct sockaddr_storage> addresses = server_addresses;
+    for (struct sockaddr_storage& address : addresses)
+    {
+        if (address.ss_family == AF_INET)
+        {
+            ((struct sockaddr_in*)&address)->sin_port = htons(port + table);
+        }
+        else
+        {
+            ((struct sockaddr_in6*)&address)->sin6_port =
+                htons(port + table);
+        }
+    }
+    // Connected blocking, the game runs non-blocking.
+    size_t winner = 0;
+    connection.fd = common::connect_first(addresses, winner);
+    if (connection.fd < 0) { return -1; }
+    if (addresses[winner].ss_family == AF_INET)
+    {
+        connection.ip_version = 4;
+        connection.remote_address =
+            *(const struct sockaddr_in*)&addresses[winner];
+    }
+    else
+    {
+        connection.ip_version = 6;
+        connection.remote6_address =
+            *(const struct sockaddr_in6*)&addresses[winner];
+    }
+    socklen_t length = sizeof(connection.local_address);
+    socklen_t length6 = sizeof(connection.local6_address);
+    if (connection.ip_version == 4) { getsockname(connection.fd,
+        (struct sockaddr*)&connection.local_address, &length); }
+    else { getsockname(connection.fd,
+        (struct sockaddr*)&connection.local6_address, &length6); }
+    // Answers are small and must not wait for the previous ones' ACK.
+    int32_t flag = 1;
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    fcntl(connection.fd, F_SETFL, fcntl(connection.fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = connections.size() - 1;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection.fd, &event) < 0)
+    {
+        common::print_error("Failed to add socket to epoll.");
+        common::assert_close(connection.fd);
+        connection.fd = -1;
+        return -1;
+    }
+    ++open_connections;
+
+    if (b_is_multiplexed)
+    {
+        // The hello opens the channels of the seats, 0, 1, ... in order,
+        // instead of an IAM on each.
+        string hello = "MUX";
+        for (size_t index : table_seats) { hello += seats[index].seat; }
+        hello += capabilities + DELIMETER;
+        connection.output += hello;
+        print_logs(connection, hello, true);
+        return flush(connection);
+    }
+    HostedSeat& hosted = seats[table_seats[0]];
+    string iam = string("IAM") + hosted.seat + capabilities + DELIMETER;
+    print_logs(connection, iam, true);
+    send(hosted, iam);
+    return flush(connection);
+}
+
+void KlientHost::close_connection(Connection& connection)
+{
+    if (connection.fd < 0) { return; }
+    // Closing the descriptor removes it from epoll.
+    common::assert_close(connection.fd);
+    connection.fd = -1;
+    --open_connections;
+    for (size_t index : connection.seats) { close_seat(seats[index]); }
+}
+
+void KlientHost::close_seat(HostedSeat& hosted)
+{
+    if (!hosted.b_is_open) { return; }
+    hosted.b_is_open = false;
+    hosted.b_has_ended = hosted.b_has_ended || hosted.player.is_finished();
+    if (!hosted.b_has_ended)
+    {
+        common::print_error("Server disconnected.");
+    }
+    Connection& connection = connections[hosted.connection];
+    if (--connection.open_seats == 0) { close_connection(connection); }
+}
+
+void KlientHost::send(HostedSeat& hosted, const string& data)
+{
+    Connection& connection = connections[hosted.connection];
+    if (b_is_multiplexed)
+    {
+        mux::encode(connection.output, hosted.channel, data);
+    }
+    else { connection.output += data; }
+}
+
+int16_t KlientHost::flush(Connection& connection)
+{
+    size_t written = 0;
+    while (written < connection.output.size())
+    {
+        ssize_t result = write(connection.fd, connection.output.data() +
+            written, connection.output.size() - written);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {break;}
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result <= 0) { return -1; }
+        written += result;
+    }
+    connection.output.erase(0, written);
+    if (connection.output.empty() != connection.b_is_waiting_to_write)
+    {
+        return 0;
+    }
+
+    connection.b_is_waiting_to_write = !connection.output.empty();
+    struct epoll_event event{};
+    event.events = connection.b_is_waiting_to_write ? EPOLLIN | EPOLLOUT :
+        EPOLLIN;
+    event.data.u64 = &connection - connections.data();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event) < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+void KlientHost::handle_message(HostedSeat& hosted,
+    const frames::Message& parsed)
+{
+    if (parsed.type == frames::Type::BUSY_FRAME)
+    {
+        // The seat is taken, nothing more to play.
+        hosted.b_has_ended = true;
+        return;
+    }
+    string card = hosted.player.handle_message(parsed);
+    if (card.empty()) { return; }
+
+    int16_t trick_number = hosted.player.get_trick_number();
+    string text = "TRICK" + std::to_string(trick_number) + card + DELIMETER;
+    print_logs(connections[hosted.connection], text, true);
+    if (hosted.b_is_binary)
+    {
+        string frame;
+        frames::encode_trick(frame, trick_number, {&card, 1});
+        send(hosted, frame);
+    }
+    else { send(hosted, text); }
+}
+
+int16_t KlientHost::handle_seat_input(HostedSeat& hosted)
+{
+    const Connection& connection = connections[hosted.connection];
+    size_t position = 0;
+    string message;
+    frames::Message parsed{};
+    int16_t result = 0;
+    while (hosted.b_is_open && position < hosted.input.size())
+    {
+        if (b_wants_binary && !hosted.b_is_protocol_known)
+        {
+            // A text server ignores BIN, its messages start with a letter.
+            hosted.b_is_binary =
+                frames::is_frame_start(hosted.input[position]);
+            hosted.b_is_protocol_known = true;
+        }
+        result = frames::next_message(hosted.input, position,
+            hosted.b_is_binary, message);
+        if (result <= 0) { break; }
+        bool b_is_known = frames::parse(message, hosted.b_is_binary,
+            hosted.player.get_trick_number(), parsed);
+        print_logs(connection, message, false);
+        if (b_is_known) { handle_message(hosted, parsed); }
+    }
+    hosted.input.erase(0, position);
+    return result < 0 ? -1 : 0;
+}
+
+void KlientHost::handle_input(Connection& connection)
+{
+    char buffer[4096];
+    bool b_was_closed = false;
+    vector<size_t> touched;
+    for (;;)
+    {
+        ssize_t result = read(connection.fd, buffer, sizeof(buffer));
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {break;}
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result <= 0)
+        {
+            // The last messages (SCORE, TOTAL) come right before the close.
+            b_was_closed = true;
+            break;
+        }
+        if (b_is_multiplexed) { connection.input.append(buffer, result); }
+        else
+        {
+            seats[connection.seats[0]].input.append(buffer, result);
+            touched.assign(1, connection.seats[0]);
+        }
+    }
+
+    size_t position = 0;
+    if (b_is_multiplexed && connection.b_is_hello_pending)
+    {
+        size_t size = sizeof(MUX_HELLO) - 1;
+        if (connection.input.size() >= size)
+        {
+            if (connection.input.compare(0, size, MUX_HELLO) != 0)
+            {
+                common::print_error("Server does not multiplex.");
+                close_connection(connection);
+                return;
+            }
+            print_logs(connection, MUX_HELLO, false);
+            connection.b_is_hello_pending = false;
+            position = size;
+        }
+    }
+    uint8_t channel;
+    std::string_view payload;
+    while (b_is_multiplexed && !connection.b_is_hello_pending &&
+        mux::next_frame(connection.input, position, channel, payload))
+    {
+        if (channel >= connection.seats.size()) { continue; }
+        size_t index = connection.seats[channel];
+        if (payload.empty())
+        {
+            // The server closed the channel; handle what came before.
+            handle_seat_input(seats[index]);
+            close_seat(seats[index]);
+            if (connection.fd < 0) { return; }
+            continue;
+        }
+        seats[index].input.append(payload);
+        touched.push_back(index);
+    }
+    if (b_is_multiplexed) { connection.input.erase(0, position); }
+
+    for (size_t index : touched)
+    {
+        if (handle_seat_input(seats[index]) < 0)
+        {
+            common::print_error("Invalid message from server.");
+            close_seat(seats[index]);
+            if (connection.fd < 0) { return; }
+        }
+    }
+    if (b_was_closed)
+    {
+        close_connection(connection);
+        return;
+    }
+    if (!connection.output.empty() && flush(connection) < 0)
+    {
+        common::print_error("Failed to send message to server.");
+        close_connection(connection);
+    }
+}
+
+int16_t KlientHost::run()
+{
+    int32_t family = AF_UNSPEC;
+    if (ip_version == 4) { family = AF_INET; }
+    else if (ip_version == 6) { family = AF_INET6; }
+    if (common::get_server_addresses(host.c_str(), port, family,
+        server_addresses) < 0) { return 1; }
+
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0)
+    {
+        common::print_error("Failed to create epoll.");
+        return 1;
+    }
+
+    bool b_is_pre = regex::has_capability("IAMN" + capabilities + DELIMETER,
+        "PRE");
+    int32_t tables = (seats_number + 3) / 4;
+    seats.reserve(seats_number);
+    // Indices of the connections are stable, epoll events carry them.
+    connections.reserve(b_is_multiplexed ? tables : seats_number);
+    for (int32_t i = 0; i < seats_number; ++i)
+    {
+        size_t connection = b_is_multiplexed ? i / 4 : i;
+        seats.push_back(HostedSeat{connection, (uint8_t)(i % 4), SEATS[i % 4],
+            AiPlayer(SEATS[i % 4], b_is_pre, 0, 0, policy), "", false,
+            false, true, false});
+    }
+    for (int32_t table = 0; table < tables; ++table)
+    {
+        vector<size_t> table_seats;
+        for (int32_t i = table * 4; i < std::min(seats_number, table * 4 + 4);
+            ++i)
+        {
+            table_seats.push_back(i);
+            if (!b_is_multiplexed && open_connection(table, table_seats) < 0)
+            {
+                return 1;
+            }
+            if (!b_is_multiplexed) { table_seats.clear(); }
+        }
+        if (b_is_multiplexed && open_connection(table, table_seats) < 0)
+        {
+            return 1;
+        }
+    }
+
+    struct epoll_event events[HOST_EPOLL_EVENTS];
+    while (open_connections > 0)
+    {
+        int32_t ready = epoll_wait(epoll_fd, events, HOST_EPOLL_EVENTS, -1);
+        if (ready < 0 && errno == EINTR) { continue; }
+        if (ready < 0)
+        {
+            common::print_error("Failed to wait on epoll.");
+            return 1;
+        }
+        for (int32_t i = 0; i < ready; ++i)
+        {
+            Connection& connection = connections[events[i].data.u64];
+            if (connection.fd < 0) { continue; }
+            if ((events[i].events & EPOLLOUT) && flush(connection) < 0)
+            {
+                common::print_error("Failed to send message to server.");
+                close_connection(connection);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                handle_input(connection);
+            }
+        }
+    }
+
+    for (const HostedSeat& hosted : seats)
+    {
+        if (!hosted.b_has_ended) { return 1; }
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#ifndef KLIENT_HOST_H
+#define KLIENT_HOST_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+#include "ai_player.h"
+#include "common.h"
+#include "frames.h"
+#include "mux.h"
+
+using std::string;
+using std::vector;
+
+// Events taken from epoll in one call.
+#define HOST_EPOLL_EVENTS 256
+
+/*
+* Plays many AI seats from one thread, with the logs of as many AI
+* clients. The server runs one table per process, so seat i sits at the
+* table of the server on port + i / 4, on N, E, S and W in turn. Every
+* connection is a non-blocking socket driven by epoll; multiplexed, the
+* seats of a table share one connection, each on its channel (mux.h).
+*/
+class KlientHost
+{
+public:
+    KlientHost() = delete;
+    KlientHost(const string& host, int32_t port, int16_t ip, int32_t seats,
+        const string& capabilities, bool b_is_multiplexed,
+        std::shared_ptr<const PolicyTable> policy = nullptr);
+    ~KlientHost();
+
+    /*
+    * Connects every seat and plays until the servers close every
+    * connection. Returns 0 if every seat finished its game, 1 otherwise.
+    */
+    int16_t run();
+
+private:
+    struct Connection
+    {
+        int32_t fd;
+        // Family of the address that won the connect, 4 or 6.
+        int16_t ip_version;
+        struct sockaddr_in local_address;
+        struct sockaddr_in6 local6_address;
+        struct sockaddr_in remote_address;
+        struct sockaddr_in6 remote6_address;
+        // Channel frames not yet split, multiplexed connections only;
+        // otherwise the bytes go straight to the seat.
+        string input;
+        // Bytes waiting for the socket to become writable, and whether
+        // epoll watches EPOLLOUT for them.
+        string output;
+        bool b_is_waiting_to_write;
+        // Seats of the connection; the index is the channel id.
+        vector<size_t> seats;
+        // MUX_HELLO was sent and its echo did not come yet.
+        bool b_is_hello_pending;
+        int32_t open_seats;
+    };
+
+    struct HostedSeat
+    {
+        size_t connection;
+        uint8_t channel;
+        char seat;
+        AiPlayer player;
+        // Bytes of the seat not yet split into messages.
+        string input;
+        // BIN was announced; the first byte tells if the server took it.
+        bool b_is_protocol_known;
+        bool b_is_binary;
+        bool b_is_open;
+        // Got BUSY, or the whole game.
+        bool b_has_ended;
+    };
+
+    /*
+    * Connects the seats of a table, racing every address of the host as
+    * the single client does, registers the socket in epoll and queues
+    * their IAMs, or the hello naming them when multiplexed.
+    * Returns 0 if successful, -1 otherwise.
+    */
+    int16_t open_connection(int32_t table, const vector<size_t>& seats);
+
+    /*
+    * Closes the socket and every seat still open on it.
+    */
+    void close_connection(Connection& connection);
+
+    /*
+    * Ends the seat; reports it unless its game was over.
+    */
+    void close_seat(HostedSeat& hosted);
+
+    /*
+    * Queues the bytes of the seat, on its channel if multiplexed.
+    */
+    void send(HostedSeat& hosted, const string& data);
+
+    /*
+    * Writes the queued bytes; watches EPOLLOUT while some remain.
+    * Returns -1 on a write error, 0 otherwise.
+    */
+    int16_t flush(Connection& connection);
+
+    /*
+    * Reads everything available, hands it to the seats and sends their
+    * answers.
+    */
+    void handle_input(Connection& connection);
+
+    /*
+    * Handles every complete message of the seat.
+    * Returns -1 if the stream is broken, 0 otherwise.
+    */
+    int16_t handle_seat_input(HostedSeat& hosted);
+
+    /*
+    * Plays the message and queues the answer, if there is one.
+    */
+    void handle_message(HostedSeat& hosted, const frames::Message& parsed);
+
+    void print_logs(const Connection& connection, const string& message,
+        bool b_is_sender);
+
+    string host;
+    int32_t port;
+    int16_t ip_version;
+    int32_t seats_number;
+    string capabilities;
+    bool b_is_multiplexed;
+    bool b_wants_binary;
+    // Shared by the AIs of all the seats.
+    std::shared_ptr<const PolicyTable> policy;
+
+    // Addresses of the host in the order of the attempts, with port.
+    vector<struct sockaddr_storage> server_addresses;
+    int32_t epoll_fd;
+
+    vector<Connection> connections;
+    vector<HostedSeat> seats;
+    int32_t open_connections;
+};
+
+#endif // KLIENT_HOST_H
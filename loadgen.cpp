@@ -0,0 +1,414 @@
+#include "loadgen.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "regex.h"
+
+namespace
+{
+    const char SEATS[] = {'N', 'E', 'S', 'W'};
+
+    uint64_t milliseconds(int64_t ms) { return ms * 1000000ull; }
+} // namespace
+
+LoadGenerator::LoadGenerator(const string& host, int32_t port,
+    int32_t tables, int32_t think_time, int32_t connect_rate,
+    int32_t duration)
+    : host{host}, port{port}, tables{tables}, think_time{think_time},
+    connect_rate{connect_rate}, duration{duration}, epoll_fd{-1},
+    v4_address{}, v6_address{}, b_is_ipv6{false}, connections{},
+    started_connections{0}, open_connections{0}, card_sent_at{},
+    pending_answers{}, response_latency{}, connect_latency{},
+    last_connected_at{0}, connected{0},
+    failed{0}, busy{0}, tricks{0}, deals{0}, wrongs{0}
+    { signal(SIGPIPE, SIG_IGN); }
+
+LoadGenerator::~LoadGenerator()
+{
+    for (Connection& connection : connections)
+    {
+        if (connection.fd >= 0) { common::assert_close(connection.fd); }
+    }
+    if (epoll_fd >= 0) { common::assert_close(epoll_fd); }
+}
+
+int16_t LoadGenerator::open_connection(size_t index)
+{
+    Connection& connection = connections[index];
+    connection.fd = socket(b_is_ipv6 ? AF_INET6 : AF_INET,
+        SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (connection.fd < 0)
+    {
+        common::print_error("Failed to create socket.");
+        return -1;
+    }
+
+    int32_t result;
+    connection.connect_started_at = metrics::now();
+    if (b_is_ipv6)
+    {
+        struct sockaddr_in6 address = v6_address;
+        address.sin6_port = htons(port + connection.table);
+        result = connect(connection.fd, (struct sockaddr*)&address,
+            sizeof(address));
+    }
+    else
+    {
+        struct sockaddr_in address = v4_address;
+        address.sin_port = htons(port + connection.table);
+        result = connect(connection.fd, (struct sockaddr*)&address,
+            sizeof(address));
+    }
+    if (result < 0 && errno != EINPROGRESS)
+    {
+        ++failed;
+        common::assert_close(connection.fd);
+        connection.fd = -1;
+        return 0;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.u64 = index;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection.fd, &event) < 0)
+    {
+        common::print_error("Failed to add socket to epoll.");
+        common::assert_close(connection.fd);
+        connection.fd = -1;
+        return -1;
+    }
+    ++open_connections;
+    return 0;
+}
+
+void LoadGenerator::close_connection(Connection& connection)
+{
+    if (connection.fd < 0) { return; }
+    // Closing the descriptor removes it from epoll.
+    common::assert_close(connection.fd);
+    connection.fd = -1;
+    connection.b_is_connected = false;
+    --open_connections;
+}
+
+int16_t LoadGenerator::flush(Connection& connection)
+{
+    size_t written = 0;
+    while (written < connection.output.size())
+    {
+        ssize_t result = write(connection.fd, connection.output.data() +
+            written, connection.output.size() - written);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {break;}
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result <= 0) { return -1; }
+        written += result;
+    }
+    connection.output.erase(0, written);
+
+    struct epoll_event event{};
+    event.events = connection.output.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    event.data.u64 = &connection - connections.data();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event) < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int16_t LoadGenerator::send(Connection& connection, const string& message)
+{
+    connection.output += message;
+    return flush(connection);
+}
+
+string LoadGenerator::choose_card(Connection& connection,
+    const string& table_cards)
+{
+    if (connection.hand.empty()) { return ""; }
+    auto card = connection.hand.end() - 1;
+    if (!table_cards.empty())
+    {
+        // The first card on the table is the one to follow.
+        size_t first_end = table_cards[0] == '1' ? 3 : 2;
+        char color = table_cards[first_end - 1];
+        for (auto iter = connection.hand.begin();
+            iter != connection.hand.end(); ++iter)
+        {
+            if ((*iter)[iter->size() - 1] == color)
+            {
+                card = iter;
+                break;
+            }
+        }
+    }
+    string result = *card;
+    connection.hand.erase(card);
+    return result;
+}
+
+void LoadGenerator::handle_message(Connection& connection,
+    const string& message)
+{
+    uint64_t now = metrics::now();
+    uint64_t& sent_at = card_sent_at[connection.table];
+    if (sent_at != 0)
+    {
+        response_latency.record(now - sent_at);
+        sent_at = 0;
+    }
+
+    if (message.compare(0, 4, "BUSY") == 0)
+    {
+        ++busy;
+        close_connection(connection);
+    }
+    else if (message.compare(0, 4, "DEAL") == 0)
+    {
+        connection.hand = regex::extract_cards(message.substr(6));
+        connection.taken_in_deal = 0;
+        connection.trick_card.clear();
+    }
+    else if (message.compare(0, 5, "TRICK") == 0)
+    {
+        // A resent TRICK while the answer waits is answered by it.
+        if (!connection.answer.empty()) { return; }
+        // The number is ambiguous next to cards ("TRICK12H"),
+        // but it always follows the TAKEN messages seen so far.
+        string trick = std::to_string(connection.taken_in_deal + 1);
+        // Sent already and asked again: the same card, the server still
+        // counts it in the hand.
+        if (connection.trick_card.empty())
+        {
+            connection.trick_card = choose_card(connection,
+                message.substr(5 + trick.size()));
+        }
+        connection.answer = "TRICK" + trick + connection.trick_card +
+            DELIMETER;
+        pending_answers.push({now + milliseconds(think_time),
+            (size_t)(&connection - connections.data())});
+    }
+    else if (message.compare(0, 5, "WRONG") == 0) { ++wrongs; }
+    else if (message.compare(0, 5, "TAKEN") == 0)
+    {
+        ++connection.taken_in_deal;
+        connection.trick_card.clear();
+        if (connection.seat == 'N') { ++tricks; }
+    }
+    else if (message.compare(0, 5, "SCORE") == 0)
+    {
+        if (connection.seat == 'N') { ++deals; }
+    }
+}
+
+int16_t LoadGenerator::handle_input(Connection& connection)
+{
+    char buffer[4096];
+    bool b_was_closed = false;
+    for (;;)
+    {
+        ssize_t result = read(connection.fd, buffer, sizeof(buffer));
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {break;}
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result <= 0)
+        {
+            // The last messages (SCORE, TOTAL) come right before the close.
+            b_was_closed = true;
+            break;
+        }
+        connection.input.append(buffer, result);
+    }
+
+    size_t begin = 0;
+    size_t end;
+    string message;
+    while ((end = connection.input.find(DELIMETER, begin)) != string::npos)
+    {
+        message.assign(connection.input, begin, end - begin);
+        begin = end + 2;
+        handle_message(connection, message);
+        if (connection.fd < 0) { return -1; }
+    }
+    connection.input.erase(0, begin);
+    if (b_was_closed)
+    {
+        close_connection(connection);
+        return -1;
+    }
+    return 0;
+}
+
+void LoadGenerator::send_due_answers(uint64_t now)
+{
+    while (!pending_answers.empty() && pending_answers.top().first <= now)
+    {
+        Connection& connection = connections[pending_answers.top().second];
+        pending_answers.pop();
+        if (connection.fd < 0 || connection.answer.empty()) { continue; }
+        card_sent_at[connection.table] = metrics::now();
+        if (send(connection, connection.answer) < 0)
+        {
+            close_connection(connection);
+        }
+        connection.answer.clear();
+    }
+}
+
+int32_t LoadGenerator::next_timeout(uint64_t now, uint64_t next_connect_at)
+{
+    uint64_t next = UINT64_MAX;
+    if (!pending_answers.empty()) { next = pending_answers.top().first; }
+    if (started_connections < connections.size())
+    {
+        next = std::min(next, next_connect_at);
+    }
+    if (next == UINT64_MAX) { return -1; }
+    if (next <= now) { return 0; }
+    // Round up, so we never wake up just before the deadline.
+    return (next - now + 999999) / 1000000;
+}
+
+int16_t LoadGenerator::run()
+{
+    ssize_t family = common::get_server_unknown_addr(host.c_str(), port,
+        v4_address, v6_address);
+    if (family < 0) { return 1; }
+    b_is_ipv6 = (family == 1);
+
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0)
+    {
+        common::print_error("Failed to create epoll.");
+        return 1;
+    }
+
+    connections.resize(tables * 4);
+    card_sent_at.assign(tables, 0);
+    for (size_t i = 0; i < connections.size(); ++i)
+    {
+        connections[i].fd = -1;
+        connections[i].table = i / 4;
+        connections[i].seat = SEATS[i % 4];
+        connections[i].b_is_connected = false;
+        connections[i].taken_in_deal = 0;
+    }
+
+    uint64_t start = metrics::now();
+    uint64_t deadline = duration > 0 ?
+        start + milliseconds(duration * 1000ll) : UINT64_MAX;
+    uint64_t connect_interval = connect_rate > 0 ?
+        1000000000ull / connect_rate : 0;
+    uint64_t next_connect_at = start;
+    struct epoll_event events[LOADGEN_EPOLL_EVENTS];
+
+    for (;;)
+    {
+        uint64_t now = metrics::now();
+        while (started_connections < connections.size() &&
+            next_connect_at <= now)
+        {
+            if (open_connection(started_connections) < 0) { return 1; }
+            ++started_connections;
+            next_connect_at += connect_interval;
+        }
+        send_due_answers(now);
+        if (now >= deadline) { break; }
+        if (open_connections == 0 && started_connections ==
+            connections.size()) { break; }
+
+        int32_t timeout = next_timeout(now, next_connect_at);
+        if (deadline != UINT64_MAX)
+        {
+            int32_t until_deadline = (deadline - now + 999999) / 1000000;
+            if (timeout < 0 || until_deadline < timeout)
+            {
+                timeout = until_deadline;
+            }
+        }
+        int32_t ready = epoll_wait(epoll_fd, events, LOADGEN_EPOLL_EVENTS,
+            timeout);
+        if (ready < 0 && errno == EINTR) { continue; }
+        if (ready < 0)
+        {
+            common::print_error("Failed to wait on epoll.");
+            return 1;
+        }
+
+        for (int32_t i = 0; i < ready; ++i)
+        {
+            Connection& connection = connections[events[i].data.u64];
+            if (connection.fd < 0) { continue; }
+            if (!connection.b_is_connected)
+            {
+                int32_t error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error,
+                    &length);
+                if (error != 0)
+                {
+                    ++failed;
+                    close_connection(connection);
+                    continue;
+                }
+                connection.b_is_connected = true;
+                ++connected;
+                last_connected_at = metrics::now();
+                connect_latency.record(last_connected_at -
+                    connection.connect_started_at);
+                string iam = string("IAM") + connection.seat + DELIMETER;
+                if (send(connection, iam) < 0)
+                {
+                    close_connection(connection);
+                    continue;
+                }
+            }
+            else if ((events[i].events & EPOLLOUT) && flush(connection) < 0)
+            {
+                close_connection(connection);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                handle_input(connection);
+            }
+        }
+    }
+
+    print_report(start, metrics::now());
+    return 0;
+}
+
+void LoadGenerator::print_report(uint64_t start, uint64_t end)
+{
+    double seconds = std::max((end - start) / 1e9, 1e-9);
+    // Connections are counted over the time it took to open them.
+    double connect_seconds = std::max((last_connected_at - start) / 1e9,
+        1e-9);
+    char line[256];
+    snprintf(line, sizeof(line), "tables %d connections %lu failed %lu "
+        "busy %lu wrong %lu elapsed_s %.3f\n", tables, connected, failed,
+        busy, wrongs, seconds);
+    cout << line;
+    snprintf(line, sizeof(line), "rate connections_per_s %.1f "
+        "tricks_per_s %.1f deals_per_s %.2f\n", connected / connect_seconds,
+        tricks / seconds, deals / seconds);
+    cout << line;
+    const std::pair<const char*, const metrics::Histogram*> histograms[] =
+        {{"connect", &connect_latency}, {"response", &response_latency}};
+    for (const auto& [name, histogram] : histograms)
+    {
+        snprintf(line, sizeof(line), "latency_us %s count %lu mean %.1f "
+            "p50 %.1f p99 %.1f p999 %.1f max %.1f\n", name,
+            histogram->count(), histogram->mean() / 1000,
+            histogram->percentile(0.5) / 1000.0,
+            histogram->percentile(0.99) / 1000.0,
+            histogram->percentile(0.999) / 1000.0,
+            histogram->max() / 1000.0);
+        cout << line;
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <queue>
+#include <netinet/in.h>
+
+#include "common.h"
+#include "metrics.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+// Events taken from epoll in one call.
+#define LOADGEN_EPOLL_EVENTS 256
+
+/*
+* Load generator: plays whole tables of bots against local servers from one
+* thread. The server runs one table per process, so table i is the server
+* listening on port + i. Every connection is a non-blocking socket driven
+* by epoll; cards are chosen with the same rule as the AI client (follow
+* the suit if possible) after a configurable think time.
+*/
+class LoadGenerator
+{
+public:
+    LoadGenerator() = delete;
+    LoadGenerator(const string& host, int32_t port, int32_t tables,
+        int32_t think_time, int32_t connect_rate, int32_t duration);
+    ~LoadGenerator();
+
+    /*
+    * Connects every seat of every table and plays until all the servers
+    * close the connections or the duration passes, then prints the report.
+    * Returns 0 if successful, 1 otherwise.
+    */
+    int16_t run();
+
+private:
+    struct Connection
+    {
+        int32_t fd;
+        int32_t table;
+        char seat;
+        bool b_is_connected;
+        // Bytes received and not yet split into messages.
+        string input;
+        // Bytes waiting for the socket to become writable.
+        string output;
+        vector<string> hand;
+        int16_t taken_in_deal;
+        // Card of the current trick, taken from the hand once however
+        // many times the server sends TRICK.
+        string trick_card;
+        // Answer to the pending TRICK, sent when the think time passes.
+        string answer;
+        uint64_t connect_started_at;
+    };
+
+    /*
+    * Starts a non-blocking connect of the connection's seat and registers
+    * it in epoll. Returns 0 if successful, -1 otherwise.
+    */
+    int16_t open_connection(size_t index);
+
+    /*
+    * Closes the connection and removes it from epoll.
+    */
+    void close_connection(Connection& connection);
+
+    /*
+    * Reads everything available and handles every complete message.
+    * Returns -1 if the connection was closed, 0 otherwise.
+    */
+    int16_t handle_input(Connection& connection);
+
+    /*
+    * Reacts to one message (without the delimeter) from the server.
+    */
+    void handle_message(Connection& connection, const string& message);
+
+    /*
+    * Queues the bytes and writes as much as the socket accepts.
+    * Returns -1 on a write error, 0 otherwise.
+    */
+    int16_t send(Connection& connection, const string& message);
+
+    /*
+    * Writes the queued bytes; watches EPOLLOUT while some remain.
+    * Returns -1 on a write error, 0 otherwise.
+    */
+    int16_t flush(Connection& connection);
+
+    /*
+    * Picks a legal card for the trick and removes it from the hand.
+    */
+    string choose_card(Connection& connection, const string& table_cards);
+
+    /*
+    * Sends the answers whose think time passed.
+    */
+    void send_due_answers(uint64_t now);
+
+    /*
+    * Milliseconds epoll may sleep before the next answer is due or
+    * the next connection may be opened, -1 if nothing is scheduled.
+    */
+    int32_t next_timeout(uint64_t now, uint64_t next_connect_at);
+
+    void print_report(uint64_t start, uint64_t end);
+
+    string host;
+    int32_t port;
+    int32_t tables;
+    int32_t think_time;    // ms
+    int32_t connect_rate;  // connections per second, 0 = no limit
+    int32_t duration;      // s, 0 = until the servers finish
+
+    int32_t epoll_fd;
+    struct sockaddr_in v4_address;
+    struct sockaddr_in6 v6_address;
+    bool b_is_ipv6;
+
+    vector<Connection> connections;
+    // Connections opened so far (in table order) and still open.
+    size_t started_connections;
+    int32_t open_connections;
+    // When a card was last sent at each table, 0 if nothing is awaited;
+    // the next message from that server ends the response latency.
+    vector<uint64_t> card_sent_at;
+
+    // (due time, connection index) of TRICKs waiting for their answer.
+    using pending_t = std::pair<uint64_t, size_t>;
+    std::priority_queue<pending_t, vector<pending_t>,
+        std::greater<pending_t>> pending_answers;
+
+    metrics::Histogram response_latency;
+    metrics::Histogram connect_latency;
+    uint64_t last_connected_at;
+    uint64_t connected;
+    uint64_t failed;
+    uint64_t busy;
+    uint64_t tricks;
+    uint64_t deals;
+    uint64_t wrongs;
+};
+
+#endif // LOADGEN_H
@@ -0,0 +1,246 @@
+#include "lock_stats.h"
+
+#ifdef LOCK_STATS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using std::array;
+using std::atomic;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::chrono::steady_clock;
+
+// Power of two, far more than there are lock() calls in the code.
+#define LOCK_SITES 256
+// Bucket i counts durations in [2^(i-1), 2^i) nanoseconds.
+#define HISTOGRAM_BUCKETS 40
+
+namespace
+{
+    struct Histogram
+    {
+        array<atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+        atomic<uint64_t> total_ns{0};
+        atomic<uint64_t> max_ns{0};
+
+        void add(uint64_t ns)
+        {
+            size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+            if (bucket >= HISTOGRAM_BUCKETS) { bucket = HISTOGRAM_BUCKETS - 1; }
+            buckets[bucket].fetch_add(1, memory_order_relaxed);
+            total_ns.fetch_add(ns, memory_order_relaxed);
+            uint64_t max = max_ns.load(memory_order_relaxed);
+            while (ns > max && !max_ns.compare_exchange_weak(max, ns,
+                memory_order_relaxed)) {}
+        }
+
+        /*
+        * Upper bound of the bucket containing the given percentile.
+        */
+        uint64_t percentile(double fraction) const
+        {
+            uint64_t count = 0;
+            for (const auto& bucket : buckets)
+            {
+                count += bucket.load(memory_order_relaxed);
+            }
+            uint64_t rank = (uint64_t)(count * fraction);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+            {
+                seen += buckets[i].load(memory_order_relaxed);
+                if (seen > rank) { return i == 0 ? 0 : (1ull << i); }
+            }
+            return max_ns.load(memory_order_relaxed);
+        }
+    };
+
+    struct Site
+    {
+        // 0 marks an empty slot; published last, after file and function.
+        atomic<uint32_t> line{0};
+        const char* file = nullptr;
+        const char* function = nullptr;
+        atomic<uint64_t> acquisitions{0};
+        atomic<uint64_t> contended{0};
+        Histogram wait;
+        Histogram hold;
+    };
+
+    array<Site, LOCK_SITES> sites;
+    // Taken only when a call site is seen for the first time.
+    std::mutex registration_mutex;
+
+    /*
+    * Finds (or registers) the slot of the call site. Lock-free once
+    * the site is registered.
+    */
+    size_t find_site(const std::source_location& location)
+    {
+        uint32_t line = location.line();
+        size_t start = (line * 31 + ((uintptr_t)location.file_name() >> 4))
+            & (LOCK_SITES - 1);
+        for (size_t probe = 0; probe < LOCK_SITES; ++probe)
+        {
+            size_t i = (start + probe) & (LOCK_SITES - 1);
+            uint32_t site_line = sites[i].line.load(memory_order_acquire);
+            if (site_line == 0)
+            {
+                std::lock_guard<std::mutex> guard(registration_mutex);
+                site_line = sites[i].line.load(memory_order_acquire);
+                if (site_line == 0)
+                {
+                    sites[i].file = location.file_name();
+                    sites[i].function = location.function_name();
+                    sites[i].line.store(line, memory_order_release);
+                    return i;
+                }
+            }
+            if (site_line == line && (sites[i].file == location.file_name() ||
+                strcmp(sites[i].file, location.file_name()) == 0))
+            {
+                return i;
+            }
+        }
+        // Table full, account everything else to the first slot.
+        return start;
+    }
+
+    uint64_t nanoseconds(steady_clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (duration).count();
+    }
+
+    /*
+    * Writes "Class::method" out of a full function signature.
+    */
+    void short_name(const char* function, char* buffer, size_t size)
+    {
+        const char* end = strchr(function, '(');
+        if (end == nullptr) { end = function + strlen(function); }
+        const char* begin = end;
+        while (begin > function && begin[-1] != ' ') { --begin; }
+        snprintf(buffer, size, "%.*s", (int)(end - begin), begin);
+    }
+
+    const char* base_name(const char* file)
+    {
+        const char* slash = strrchr(file, '/');
+        return slash == nullptr ? file : slash + 1;
+    }
+} // namespace
+
+void ProfiledMutex::lock(std::source_location location)
+{
+    size_t site = find_site(location);
+    steady_clock::time_point start = steady_clock::now();
+    bool b_was_free = mutex.try_lock();
+    if (!b_was_free)
+    {
+        sites[site].contended.fetch_add(1, memory_order_relaxed);
+        mutex.lock();
+    }
+    acquired_at = steady_clock::now();
+    holder_site = site;
+    sites[site].acquisitions.fetch_add(1, memory_order_relaxed);
+    sites[site].wait.add(nanoseconds(acquired_at - start));
+}
+
+bool ProfiledMutex::try_lock(std::source_location location)
+{
+    if (!mutex.try_lock()) { return false; }
+    size_t site = find_site(location);
+    acquired_at = steady_clock::now();
+    holder_site = site;
+    sites[site].acquisitions.fetch_add(1, memory_order_relaxed);
+    sites[site].wait.add(0);
+    return true;
+}
+
+void ProfiledMutex::unlock()
+{
+    uint64_t held = nanoseconds(steady_clock::now() - acquired_at);
+    sites[holder_site].hold.add(held);
+    mutex.unlock();
+}
+
+ProfiledLock::ProfiledLock(ProfiledMutex& mutex,
+    std::source_location location)
+    : mutex{mutex}, location{location}, b_owns{false}
+{
+    lock();
+}
+
+ProfiledLock::~ProfiledLock()
+{
+    if (b_owns) { mutex.unlock(); }
+}
+
+void ProfiledLock::lock()
+{
+    mutex.lock(location);
+    b_owns = true;
+}
+
+void ProfiledLock::unlock()
+{
+    b_owns = false;
+    mutex.unlock();
+}
+
+void lock_stats::dump(std::ostream& out)
+{
+    std::vector<size_t> used;
+    for (size_t i = 0; i < LOCK_SITES; ++i)
+    {
+        if (sites[i].line.load(memory_order_acquire) != 0 &&
+            sites[i].acquisitions.load(memory_order_relaxed) > 0)
+        {
+            used.push_back(i);
+        }
+    }
+    std::sort(used.begin(), used.end(), [](size_t a, size_t b)
+    {
+        return sites[a].wait.total_ns.load(memory_order_relaxed) >
+            sites[b].wait.total_ns.load(memory_order_relaxed);
+    });
+
+    char line[256];
+    char name[96];
+    out << "Lock contention (times in ns, percentiles are bucket bounds):\n";
+    snprintf(line, sizeof(line), "%-40s %9s %9s %11s %8s %8s %11s %8s %8s\n",
+        "call site", "acquired", "waited", "wait total", "wait p50",
+        "wait p99", "hold total", "hold p50", "hold p99");
+    out << line;
+    for (size_t i : used)
+    {
+        const Site& site = sites[i];
+        short_name(site.function, name, sizeof(name));
+        char label[128];
+        snprintf(label, sizeof(label), "%s:%u %s", base_name(site.file),
+            site.line.load(memory_order_relaxed), name);
+        snprintf(line, sizeof(line),
+            "%-40s %9lu %9lu %11lu %8lu %8lu %11lu %8lu %8lu\n", label,
+            site.acquisitions.load(memory_order_relaxed),
+            site.contended.load(memory_order_relaxed),
+            site.wait.total_ns.load(memory_order_relaxed),
+            site.wait.percentile(0.5), site.wait.percentile(0.99),
+            site.hold.total_ns.load(memory_order_relaxed),
+            site.hold.percentile(0.5), site.hold.percentile(0.99));
+        out << line;
+    }
+}
+
+#else
+
+void lock_stats::dump(std::ostream&) {}
+
+#endif // LOCK_STATS
@@ -0,0 +1,87 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <mutex>
+#include <ostream>
+
+/*
+* Lock contention profiling, compiled in only with -DLOCK_STATS
+* (make LOCK_STATS=1). ProfiledMutex is then a mutex that remembers where
+* it was locked from (std::source_location of the lock() call) and records,
+* per call site, the number of acquisitions and histograms of the time spent
+* waiting for the lock and holding it. Without LOCK_STATS it is std::mutex.
+*
+* std::lock_guard, std::unique_lock and std::condition_variable_any call
+* lock() from inside the standard headers, so all their users would share
+* one site there; ProfiledLock is the scoped lock to use instead. It keeps
+* the location it was made at and locks again from it, also when a
+* condition_variable_any waiting on it relocks. Without LOCK_STATS it is
+* std::unique_lock<std::mutex>.
+*/
+#ifdef LOCK_STATS
+
+#include <chrono>
+#include <cstddef>
+#include <source_location>
+
+class ProfiledMutex
+{
+public:
+    ProfiledMutex() = default;
+    ~ProfiledMutex() = default;
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock(std::source_location location =
+        std::source_location::current());
+
+    bool try_lock(std::source_location location =
+        std::source_location::current());
+
+    void unlock();
+
+private:
+    std::mutex mutex;
+    // Written only by the thread holding the mutex.
+    size_t holder_site;
+    std::chrono::steady_clock::time_point acquired_at;
+};
+
+class ProfiledLock
+{
+public:
+    // Locks the mutex, as held from the location.
+    explicit ProfiledLock(ProfiledMutex& mutex, std::source_location
+        location = std::source_location::current());
+    // Unlocks the mutex if it is held.
+    ~ProfiledLock();
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    void lock();
+
+    void unlock();
+
+private:
+    ProfiledMutex& mutex;
+    std::source_location location;
+    bool b_owns;
+};
+
+#else
+
+using ProfiledMutex = std::mutex;
+using ProfiledLock = std::unique_lock<std::mutex>;
+
+#endif // LOCK_STATS
+
+namespace lock_stats
+{
+    /*
+    * Prints the contention report of every call site, the most waited
+    * on first. Prints nothing without LOCK_STATS.
+    */
+    void dump(std::ostream& out);
+} // namespace lock_stats
+
+#endif // LOCK_STATS_H
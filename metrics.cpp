@@ -0,0 +1,255 @@
+#include "metrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+
+using std::array;
+using std::atomic;
+using std::memory_order_relaxed;
+
+namespace
+{
+    array<metrics::Histogram, static_cast<size_t>(metrics::Latency::COUNT)>
+        histograms;
+
+    array<atomic<uint64_t>, static_cast<size_t>(metrics::Counter::COUNT)>
+        counters{};
+
+    const char* latency_names[] = {"accept_to_iam", "trick_to_card_N",
+        "trick_to_card_E", "trick_to_card_S", "trick_to_card_W",
+        "card_to_taken", "barrier", "deal"};
+
+    const char* counter_names[] = {"messages_received", "messages_sent",
+        "resends", "wrongs", "disconnects", "reconnects", "bot_takeovers",
+        "bot_cards", "pre_commits", "pre_commit_misses"};
+
+    static_assert(sizeof(latency_names) / sizeof(latency_names[0]) ==
+        static_cast<size_t>(metrics::Latency::COUNT));
+    static_assert(sizeof(counter_names) / sizeof(counter_names[0]) ==
+        static_cast<size_t>(metrics::Counter::COUNT));
+} // namespace
+
+size_t metrics::Histogram::bucket_of(uint64_t value)
+{
+    if (value < (1ull << HISTOGRAM_SUB_BITS)) { return value; }
+    size_t exponent = 63 - __builtin_clzll(value);
+    if (exponent > HISTOGRAM_MAX_EXPONENT) { return HISTOGRAM_SIZE - 1; }
+    size_t shift = exponent - HISTOGRAM_SUB_BITS;
+    size_t sub_bucket = (value >> shift) & ((1ull << HISTOGRAM_SUB_BITS) - 1);
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + sub_bucket;
+}
+
+uint64_t metrics::Histogram::value_of(size_t bucket)
+{
+    if (bucket < (1ull << HISTOGRAM_SUB_BITS)) { return bucket; }
+    size_t shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub_bucket = bucket & ((1ull << HISTOGRAM_SUB_BITS) - 1);
+    return ((1ull << HISTOGRAM_SUB_BITS) + sub_bucket) << shift;
+}
+
+void metrics::Histogram::record(uint64_t value)
+{
+    buckets[bucket_of(value)].fetch_add(1, memory_order_relaxed);
+    total_count.fetch_add(1, memory_order_relaxed);
+    total_sum.fetch_add(value, memory_order_relaxed);
+    uint64_t max = max_value.load(memory_order_relaxed);
+    while (value > max && !max_value.compare_exchange_weak(max, value,
+        memory_order_relaxed)) {}
+}
+
+uint64_t metrics::Histogram::count() const
+{
+    return total_count.load(memory_order_relaxed);
+}
+
+uint64_t metrics::Histogram::max() const
+{
+    return max_value.load(memory_order_relaxed);
+}
+
+double metrics::Histogram::mean() const
+{
+    uint64_t values = count();
+    if (values == 0) { return 0; }
+    return (double)total_sum.load(memory_order_relaxed) / values;
+}
+
+uint64_t metrics::Histogram::percentile(double fraction) const
+{
+    // Buckets may be updated while we read; the result is approximate.
+    uint64_t values = 0;
+    for (const auto& bucket : buckets)
+    {
+        values += bucket.load(memory_order_relaxed);
+    }
+    uint64_t rank = (uint64_t)(values * fraction);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_SIZE; ++i)
+    {
+        seen += buckets[i].load(memory_order_relaxed);
+        if (seen > rank) { return value_of(i); }
+    }
+    return max();
+}
+
+uint64_t metrics::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void metrics::record(Latency latency, uint64_t nanoseconds)
+{
+    histograms[static_cast<size_t>(latency)].record(nanoseconds);
+}
+
+void metrics::record_since(Latency latency, uint64_t start)
+{
+    uint64_t end = now();
+    record(latency, end > start ? end - start : 0);
+}
+
+void metrics::increment(Counter counter)
+{
+    counters[static_cast<size_t>(counter)].fetch_add(1, memory_order_relaxed);
+}
+
+void metrics::format(string& report)
+{
+    char line[256];
+    for (size_t i = 0; i < counters.size(); ++i)
+    {
+        snprintf(line, sizeof(line), "counter %s %lu\n", counter_names[i],
+            counters[i].load(memory_order_relaxed));
+        report += line;
+    }
+    for (size_t i = 0; i < histograms.size(); ++i)
+    {
+        const Histogram& histogram = histograms[i];
+        // Microseconds are easier to read than nanoseconds.
+        snprintf(line, sizeof(line), "latency_us %s count %lu mean %.1f "
+            "p50 %.1f p90 %.1f p99 %.1f p999 %.1f max %.1f\n",
+            latency_names[i], histogram.count(), histogram.mean() / 1000,
+            histogram.percentile(0.5) / 1000.0,
+            histogram.percentile(0.9) / 1000.0,
+            histogram.percentile(0.99) / 1000.0,
+            histogram.percentile(0.999) / 1000.0,
+            histogram.max() / 1000.0);
+        report += line;
+    }
+}
+
+metrics::MetricsServer::MetricsServer()
+    : path{}, socket_fd{-1}, stop_pipe{-1, -1}, serving_thread{} {}
+
+metrics::MetricsServer::~MetricsServer() { stop(); }
+
+int16_t metrics::MetricsServer::start(const string& socket_path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        common::print_error("Metrics socket path is too long.");
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, socket_path.size());
+
+    socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd < 0)
+    {
+        common::print_error("Failed to create metrics socket.");
+        return -1;
+    }
+    // A stale socket left by a previous run would make bind fail.
+    unlink(socket_path.c_str());
+    if (bind(socket_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(socket_fd, QUEUE_SIZE) < 0)
+    {
+        common::print_error("Failed to set up metrics socket.");
+        common::assert_close(socket_fd);
+        socket_fd = -1;
+        return -1;
+    }
+    path = socket_path;
+
+    if (pipe(stop_pipe) < 0)
+    {
+        common::print_error("Failed to create pipes.");
+        stop();
+        return -1;
+    }
+
+    try { serving_thread = std::thread(&MetricsServer::serve, this); }
+    catch (const std::system_error& e)
+    {
+        common::print_error(e.what());
+        stop();
+        return -1;
+    }
+    return 0;
+}
+
+void metrics::MetricsServer::stop()
+{
+    if (serving_thread.joinable())
+    {
+        if (common::write_to_pipe(stop_pipe[1], END) != 1)
+        {
+            common::print_error("Failed to notify metrics thread.");
+        }
+        try { serving_thread.join(); }
+        catch (const std::system_error& e) { common::print_error(e.what()); }
+    }
+    for (int32_t& fd : {std::ref(socket_fd), std::ref(stop_pipe[0]),
+        std::ref(stop_pipe[1])})
+    {
+        if (fd >= 0) { common::assert_close(fd); }
+        fd = -1;
+    }
+    if (!path.empty()) { unlink(path.c_str()); }
+    path.clear();
+}
+
+void metrics::MetricsServer::serve()
+{
+    struct pollfd poll_descriptors[2];
+    poll_descriptors[0].fd = socket_fd;
+    poll_descriptors[0].events = POLLIN;
+    poll_descriptors[1].fd = stop_pipe[0];
+    poll_descriptors[1].events = POLLIN;
+
+    string report;
+    for (;;)
+    {
+        poll_descriptors[0].revents = 0;
+        poll_descriptors[1].revents = 0;
+        if (poll(poll_descriptors, 2, -1) <= 0)
+        {
+            common::print_error("Failed to poll in metrics thread.");
+            return;
+        }
+        if (poll_descriptors[1].revents & (POLLIN | POLLERR | POLLHUP))
+        {
+            return;
+        }
+        if (poll_descriptors[0].revents & POLLIN)
+        {
+            int32_t client_fd = accept(socket_fd, nullptr, nullptr);
+            if (client_fd < 0) { continue; }
+            report.clear();
+            format(report);
+            // The reader is local; a failed write only affects it.
+            common::write_to_socket(client_fd, report.data(), report.size());
+            common::assert_close(client_fd);
+        }
+    }
+}
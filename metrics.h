@@ -0,0 +1,142 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Values are kept with 5 significant bits (error below 3.2%).
+#define HISTOGRAM_SUB_BITS 5
+// Largest recorded exponent; 2^40 ns is about 18 minutes.
+#define HISTOGRAM_MAX_EXPONENT 40
+#define HISTOGRAM_SIZE ((HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 2) \
+    << HISTOGRAM_SUB_BITS)
+
+/*
+* Server metrics: latency histograms and event counters. Everything is
+* a relaxed atomic, so recording never blocks the game and reading does
+* not take any of the game locks.
+*/
+namespace metrics
+{
+    using std::array;
+    using std::atomic;
+    using std::string;
+
+    /*
+    * HDR-style histogram of nanosecond values: exponential buckets,
+    * each split into 2^HISTOGRAM_SUB_BITS linear sub-buckets.
+    */
+    class Histogram
+    {
+    public:
+        Histogram() = default;
+        ~Histogram() = default;
+
+        void record(uint64_t value);
+
+        uint64_t count() const;
+
+        uint64_t max() const;
+
+        double mean() const;
+
+        /*
+        * Smallest value of the bucket that contains the percentile
+        * (given as a fraction, e.g. 0.99).
+        */
+        uint64_t percentile(double fraction) const;
+
+    private:
+        static size_t bucket_of(uint64_t value);
+        static uint64_t value_of(size_t bucket);
+
+        array<atomic<uint64_t>, HISTOGRAM_SIZE> buckets{};
+        atomic<uint64_t> total_count{0};
+        atomic<uint64_t> total_sum{0};
+        atomic<uint64_t> max_value{0};
+    };
+
+    enum class Latency : uint8_t
+    {
+        ACCEPT_TO_IAM,
+        TRICK_TO_CARD_N, // TRICK sent to the seat -> its card received
+        TRICK_TO_CARD_E,
+        TRICK_TO_CARD_S,
+        TRICK_TO_CARD_W,
+        CARD_TO_TAKEN,   // last card of a trick received -> TAKEN handed
+                         // to the seats, once per trick
+        BARRIER,
+        DEAL_DURATION,
+        COUNT
+    };
+
+    enum class Counter : uint8_t
+    {
+        MESSAGES_RECEIVED,
+        MESSAGES_SENT,
+        RESENDS,
+        WRONGS,
+        DISCONNECTS,
+        RECONNECTS,
+        BOT_TAKEOVERS,
+        BOT_CARDS,
+        PRE_COMMITS,
+        PRE_COMMIT_MISSES,
+        COUNT
+    };
+
+    /*
+    * Monotonic clock in nanoseconds, used for all the latencies.
+    */
+    uint64_t now();
+
+    void record(Latency latency, uint64_t nanoseconds);
+
+    /*
+    * Records the time passed since the given now() value.
+    */
+    void record_since(Latency latency, uint64_t start);
+
+    void increment(Counter counter);
+
+    /*
+    * Appends a text report of all counters and histograms.
+    */
+    void format(string& report);
+
+    /*
+    * Serves the report on a UNIX domain stream socket: every connection
+    * receives the current report and is closed.
+    */
+    class MetricsServer
+    {
+    public:
+        MetricsServer();
+        ~MetricsServer();
+
+        /*
+        * Creates the socket and starts the serving thread.
+        * Returns 0 if successful, -1 otherwise.
+        */
+        int16_t start(const string& socket_path);
+
+        /*
+        * Stops the thread and removes the socket. Safe to call
+        * when the server was never started.
+        */
+        void stop();
+
+    private:
+        void serve();
+
+        string path;
+        int32_t socket_fd;
+        int32_t stop_pipe[2];
+        std::thread serving_thread;
+    };
+} // namespace metrics
+
+#endif // METRICS_H
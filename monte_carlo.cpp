@@ -0,0 +1,289 @@
+#include "monte_carlo.h"
+
+#include <chrono>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace
+{
+    constexpr int32_t SAMPLE_ATTEMPTS = 16;
+
+    int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*
+    * One of the cards, uniformly; cards must not be empty.
+    */
+    uint8_t random_card(card_set_t cards, std::mt19937_64& random)
+    {
+        uint64_t skip = random() % __builtin_popcountll(cards);
+        for (uint64_t i = 0; i < skip; ++i) { cards &= cards - 1; }
+        return __builtin_ctzll(cards);
+    }
+
+    /*
+    * Cards of the hand that may be played in a trick led in the suit.
+    */
+    card_set_t legal_cards(card_set_t hand, uint8_t led_suit)
+    {
+        card_set_t following = hand & CardModel::suit_cards(led_suit);
+        return following != 0 ? following : hand;
+    }
+} // namespace
+
+MonteCarlo::MonteCarlo(int32_t budget_ms, int32_t threads)
+    : budget_ms{budget_ms}, threads{threads > 0 ? threads : 1}, moves{0},
+    playouts{0}, decisions{0}, search_ns{0} {}
+
+uint8_t MonteCarlo::choose(const CardModel& model, int16_t deal_type,
+    int16_t trick_number, uint8_t fallback)
+{
+    ++moves;
+    Position position{};
+    position.seat = model.get_seat();
+    position.hand = model.get_hand();
+    position.out = model.get_out();
+    position.leader = model.get_leader();
+    span<const uint8_t> table = model.get_table();
+    position.on_table = table.size();
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        position.table[i] = table[i];
+    }
+    position.led_suit = model.get_led_suit();
+    position.deal_type = deal_type;
+    position.trick_number = trick_number;
+
+    // Every seat starts the trick with 14 - trick_number cards.
+    int32_t counted = 0;
+    for (Seat seat : seating::ALL_SEATS)
+    {
+        size_t index = seating::index(seat);
+        position.allowed[index] = ~0ULL;
+        for (uint8_t suit = 0; suit < 4; ++suit)
+        {
+            if (model.is_void(seat, suit))
+            {
+                position.allowed[index] &= ~CardModel::suit_cards(suit);
+            }
+        }
+        position.counts[index] = 14 - trick_number;
+        for (size_t i = 0; i < position.on_table; ++i)
+        {
+            if (seating::next(position.leader, i) == seat)
+            {
+                --position.counts[index];
+            }
+        }
+        if (seat != position.seat) { counted += position.counts[index]; }
+    }
+    if (trick_number < 1 || trick_number > 13 ||
+        counted != __builtin_popcountll(position.out) ||
+        __builtin_popcountll(position.hand) !=
+        position.counts[seating::index(position.seat)])
+    {
+        return fallback;
+    }
+
+    card_set_t candidates = legal_cards(position.hand, position.led_suit);
+    // A forced card needs no search.
+    if ((candidates & (candidates - 1)) == 0) { return fallback; }
+
+    int64_t start = now_ns();
+    int64_t deadline = start + (int64_t)budget_ms * 1000000;
+    std::vector<Result> results(threads);
+    std::vector<std::thread> workers;
+    uint64_t seed = std::random_device{}();
+    for (int32_t i = 1; i < threads; ++i)
+    {
+        try
+        {
+            workers.emplace_back(search, std::cref(position), candidates,
+                deadline, seed + i, std::ref(results[i]));
+        }
+        catch (const std::system_error& e)
+        {
+            // Fewer threads then; the budget stays the same.
+            common::print_error(e.what());
+            break;
+        }
+    }
+    search(position, candidates, deadline, seed, results[0]);
+    for (std::thread& worker : workers) { worker.join(); }
+    search_ns += now_ns() - start;
+
+    Result total{};
+    for (const Result& result : results)
+    {
+        for (uint8_t card = 0; card < NO_CARD; ++card)
+        {
+            total.points[card] += result.points[card];
+        }
+        total.worlds += result.worlds;
+        playouts += result.playouts;
+        decisions += result.decisions;
+    }
+    if (total.worlds == 0) { return fallback; }
+
+    // Every candidate is played in every world, so the sums compare.
+    uint8_t best = NO_CARD;
+    int64_t best_points = 0;
+    for (card_set_t left = candidates; left != 0; left &= left - 1)
+    {
+        uint8_t card = __builtin_ctzll(left);
+        if (best == NO_CARD || total.points[card] < best_points)
+        {
+            best = card;
+            best_points = total.points[card];
+        }
+    }
+    return best;
+}
+
+void MonteCarlo::report(std::ostream& stream) const
+{
+    double seconds = search_ns / 1e9;
+    stream << "Monte Carlo: " << moves << " moves, " << playouts
+        << " playouts in " << seconds << " s, "
+        << (seconds > 0 ? (uint64_t)(decisions / seconds) : 0)
+        << " decisions/s\n";
+}
+
+void MonteCarlo::search(const Position& position, card_set_t candidates,
+    int64_t deadline_ns, uint64_t seed, Result& result)
+{
+    std::mt19937_64 random(seed);
+    array<card_set_t, 4> hands;
+    while (now_ns() < deadline_ns)
+    {
+        sample(position, random, hands);
+        for (card_set_t left = candidates; left != 0; left &= left - 1)
+        {
+            uint8_t card = __builtin_ctzll(left);
+            result.points[card] += playout(position, hands, card, random,
+                result.decisions);
+            ++result.playouts;
+        }
+        ++result.worlds;
+    }
+}
+
+void MonteCarlo::sample(const Position& position, std::mt19937_64& random,
+    array<card_set_t, 4>& hands)
+{
+    array<uint8_t, NO_CARD> cards;
+    size_t cards_number = 0;
+    for (card_set_t left = position.out; left != 0; left &= left - 1)
+    {
+        cards[cards_number++] = __builtin_ctzll(left);
+    }
+
+    for (int32_t attempt = 0; attempt <= SAMPLE_ATTEMPTS; ++attempt)
+    {
+        // The last attempt forgets the voids, so it always succeeds.
+        bool b_keeps_voids = attempt < SAMPLE_ATTEMPTS;
+        hands.fill(0);
+        hands[seating::index(position.seat)] = position.hand;
+        array<uint8_t, 4> left = position.counts;
+        left[seating::index(position.seat)] = 0;
+        bool b_is_dealt = true;
+        for (size_t i = 0; i < cards_number; ++i)
+        {
+            // Shuffles as it deals.
+            std::swap(cards[i], cards[i + random() % (cards_number - i)]);
+            card_set_t card = 1ULL << cards[i];
+            // A seat with more room is as much more likely to get it.
+            uint32_t room = 0;
+            for (size_t seat = 0; seat < 4; ++seat)
+            {
+                if (!b_keeps_voids || (position.allowed[seat] & card))
+                {
+                    room += left[seat];
+                }
+            }
+            if (room == 0)
+            {
+                b_is_dealt = false;
+                break;
+            }
+            uint32_t pick = random() % room;
+            for (size_t seat = 0; seat < 4; ++seat)
+            {
+                if (b_keeps_voids && !(position.allowed[seat] & card))
+                {
+                    continue;
+                }
+                if (pick < left[seat])
+                {
+                    hands[seat] |= card;
+                    --left[seat];
+                    break;
+                }
+                pick -= left[seat];
+            }
+        }
+        if (b_is_dealt) { return; }
+    }
+}
+
+int32_t MonteCarlo::playout(const Position& position,
+    array<card_set_t, 4> hands, uint8_t candidate, std::mt19937_64& random,
+    uint64_t& decisions)
+{
+    size_t me = seating::index(position.seat);
+    int32_t points = 0;
+    int16_t trick = position.trick_number;
+    Seat leader = position.leader;
+    uint8_t led_suit = position.led_suit;
+    card_set_t table = 0;
+    uint8_t top = NO_CARD;
+    Seat taker = leader;
+    size_t played = 0;
+
+    auto play = [&](Seat seat, uint8_t card)
+    {
+        hands[seating::index(seat)] &= ~(1ULL << card);
+        table |= 1ULL << card;
+        if (played++ == 0) { led_suit = card % 4; }
+        // Cards of a suit grow with the rank.
+        if (card % 4 == led_suit && (top == NO_CARD || card > top))
+        {
+            top = card;
+            taker = seat;
+        }
+    };
+
+    for (size_t i = 0; i < position.on_table; ++i)
+    {
+        play(seating::next(leader, i), position.table[i]);
+    }
+    play(position.seat, candidate);
+    while (true)
+    {
+        for (size_t i = played; i < 4; ++i)
+        {
+            Seat seat = seating::next(leader, i);
+            card_set_t hand = hands[seating::index(seat)];
+            play(seat, random_card(played == 0 ? hand :
+                legal_cards(hand, led_suit), random));
+            ++decisions;
+        }
+        if (seating::index(taker) == me)
+        {
+            points += CardModel::trick_points(position.deal_type, trick,
+                table);
+        }
+        if (trick == 13) { return points; }
+        ++trick;
+        leader = taker;
+        table = 0;
+        top = NO_CARD;
+        played = 0;
+    }
+}
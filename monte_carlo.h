@@ -0,0 +1,108 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <random>
+
+#include "card_model.h"
+
+using std::array;
+
+/*
+* Strategy of the AI that searches for as long as it is allowed: it deals
+* the cards still out to the other seats at random, keeping to the counts
+* of their hands and to the suits they showed to be void in, plays every
+* card the seat may play in each such deal to its end with random legal
+* cards, and picks the card after which the seat took the fewest points,
+* counted as the server counts them for the deal type. The threads search
+* until the budget of the move ends and the card is chosen right after,
+* so the answer always leaves in time.
+*/
+class MonteCarlo
+{
+public:
+    MonteCarlo() = delete;
+    MonteCarlo(int32_t budget_ms, int32_t threads);
+    ~MonteCarlo() = default;
+
+    /*
+    * Picks the card the seat of the model plays in the current trick.
+    * Returns fallback if no playout ended within the budget, or if the
+    * model does not add up (e.g. a message was lost).
+    */
+    uint8_t choose(const CardModel& model, int16_t deal_type,
+        int16_t trick_number, uint8_t fallback);
+
+    /*
+    * Writes the number of moves searched, the playouts and the decisions
+    * (cards chosen in playouts) per second of search.
+    */
+    void report(std::ostream& stream) const;
+
+private:
+    /*
+    * What the search knows of the deal, copied from the model.
+    */
+    struct Position
+    {
+        Seat seat;
+        card_set_t hand;
+        card_set_t out;
+        // Cards each seat may hold: not of the suits it is void in.
+        array<card_set_t, 4> allowed;
+        // Cards in the hand of each seat.
+        array<uint8_t, 4> counts;
+        Seat leader;
+        array<uint8_t, 4> table;
+        uint8_t on_table;
+        uint8_t led_suit;
+        int16_t deal_type;
+        int16_t trick_number;
+    };
+
+    /*
+    * Points the seat took with each candidate, summed over the playouts
+    * of one thread.
+    */
+    struct Result
+    {
+        array<int64_t, NO_CARD> points;
+        uint64_t worlds;
+        uint64_t playouts;
+        uint64_t decisions;
+    };
+
+    /*
+    * Searches until the deadline, one random deal and a playout of every
+    * candidate at a time.
+    */
+    static void search(const Position& position, card_set_t candidates,
+        int64_t deadline_ns, uint64_t seed, Result& result);
+
+    /*
+    * Deals the cards out to the other seats. Keeps to the void suits if
+    * a few attempts succeed, otherwise only to the counts.
+    */
+    static void sample(const Position& position, std::mt19937_64& random,
+        array<card_set_t, 4>& hands);
+
+    /*
+    * Plays the deal to its end from the position, the seat playing the
+    * candidate first. Returns the points the seat takes.
+    */
+    static int32_t playout(const Position& position,
+        array<card_set_t, 4> hands, uint8_t candidate,
+        std::mt19937_64& random, uint64_t& decisions);
+
+    int32_t budget_ms;
+    int32_t threads;
+
+    uint64_t moves;
+    uint64_t playouts;
+    uint64_t decisions;
+    int64_t search_ns;
+};
+
+#endif // MONTE_CARLO_H
@@ -0,0 +1,33 @@
+#include "mux.h"
+
+#include <algorithm>
+
+void mux::encode(string& output, uint8_t channel, string_view data)
+{
+    while (!data.empty())
+    {
+        size_t size = std::min<size_t>(data.size(), MUX_MAX_PAYLOAD);
+        output += (char)channel;
+        output += (char)size;
+        output.append(data.data(), size);
+        data.remove_prefix(size);
+    }
+}
+
+void mux::encode_close(string& output, uint8_t channel)
+{
+    output += (char)channel;
+    output += '\0';
+}
+
+bool mux::next_frame(const string& input, size_t& position, uint8_t& channel,
+    string_view& payload)
+{
+    if (input.size() - position < 2) { return false; }
+    size_t size = (uint8_t)input[position + 1];
+    if (input.size() - position - 2 < size) { return false; }
+    channel = input[position];
+    payload = string_view(input).substr(position + 2, size);
+    position += 2 + size;
+    return true;
+}
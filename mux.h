@@ -0,0 +1,53 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using std::string;
+using std::string_view;
+
+// First message of a multiplexed connection, the server echoes it; the
+// client may name seats in it, see below.
+#define MUX_HELLO "MUX\r\n"
+// Longest payload of one channel frame.
+#define MUX_MAX_PAYLOAD 255
+
+/*
+* Multiplexed connections: one connection carries many seats, each on its
+* own channel, so a bot process needs one socket per table, not per seat.
+*
+* After MUX_HELLO both sides send only channel frames: one byte of
+* channel id, one byte of length and the payload, which is the stream of
+* an ordinary connection (text messages, or frames if its IAM asks for
+* BIN). The hello may name seats and capabilities, as in "MUXNESW+BOT",
+* which opens channels 0, 1, ... for those seats as if each had sent
+* "IAM<seat>+BOT". Any other channel opens with its first payload, which
+* starts with its IAM. An empty payload closes the channel, in either
+* direction. Channel ids are chosen by the client and may be reused once
+* closed.
+*/
+namespace mux
+{
+    /*
+    * Appends the bytes as frames of the channel, splitting them so no
+    * payload exceeds MUX_MAX_PAYLOAD.
+    */
+    void encode(string& output, uint8_t channel, string_view data);
+
+    /*
+    * Appends the frame that closes the channel.
+    */
+    void encode_close(string& output, uint8_t channel);
+
+    /*
+    * Takes the frame starting at position of input, if it is complete,
+    * and moves position past it. The payload points into input.
+    * Returns false if the frame is not complete yet.
+    */
+    bool next_frame(const string& input, size_t& position, uint8_t& channel,
+        string_view& payload);
+} // namespace mux
+
+#endif // MUX_H
@@ -6,12 +6,15 @@
 #include <array>
 #include <string>
 #include <utility>
-#include <map>
+#include <span>
+
+#include "seat.h"
 
 using std::array;
 using std::vector;
 using std::string;
 using std::pair;
+using std::span;
 
 /*
 * This class should be initialized with cards on the table,
@@ -23,15 +26,15 @@ class PointsCalculator
 {
 public:
     PointsCalculator() = delete;
-    PointsCalculator(const vector<string>& played_cards,
-        const string& starter, int16_t hand, int16_t trick);
+    PointsCalculator(span<const string> played_cards,
+        Seat starter, int16_t hand, int16_t trick);
     ~PointsCalculator() = default;
 
     /*
     * This method calculates the points for the trick.
     * It returns the taker and the points he got.
     */
-    pair<string, int32_t> calculate_points();
+    pair<Seat, int32_t> calculate_points();
 
 private:
     /*
@@ -39,21 +42,20 @@ private:
     * Used by every other method that calculates points
     * based on the taker.
     */
-    string find_taker();
-    pair<string, int32_t> no_tricks(const string& taker);
-    pair<string, int32_t> no_hearts(const string& taker);
-    pair<string, int32_t> no_queens(const string& taker);
-    pair<string, int32_t> no_misters(const string& taker);
-    pair<string, int32_t> no_hearts_king(const string& taker);
-    pair<string, int32_t> no_seventh_last_trick(const string& taker);
-    pair<string, int32_t> bandit(const string& taker);
+    Seat find_taker();
+    pair<Seat, int32_t> no_tricks(Seat taker);
+    pair<Seat, int32_t> no_hearts(Seat taker);
+    pair<Seat, int32_t> no_queens(Seat taker);
+    pair<Seat, int32_t> no_misters(Seat taker);
+    pair<Seat, int32_t> no_hearts_king(Seat taker);
+    pair<Seat, int32_t> no_seventh_last_trick(Seat taker);
+    pair<Seat, int32_t> bandit(Seat taker);
 
     int16_t trick_type;
     int16_t trick;
-    string starter;
-    array<string, 4> colors;
+    Seat starter;
+    // Both indexed by the seat that played the card.
+    array<char, 4> colors;
     array<int16_t, 4> figures;
-    array<string, 4> seats;
-    std::map<string, int16_t> seats_mapping;
 };
 #endif // POINTS_CALCULATOR_H
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "policy_table.h"
+
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace
+{
+    constexpr char MAGIC[4] = {'K', 'P', 'O', 'L'};
+} // namespace
+
+PolicyTable::PolicyTable()
+    : mapping{MAP_FAILED}, mapping_size{0}, entries{nullptr} {}
+
+PolicyTable::~PolicyTable()
+{
+    if (mapping != MAP_FAILED) { munmap(mapping, mapping_size); }
+}
+
+int16_t PolicyTable::map(const string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        common::print_error("Failed to open the policy table.");
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0)
+    {
+        common::print_error("Failed to stat the policy table.");
+        close(fd);
+        return -1;
+    }
+    size_t size = file_stat.st_size;
+    if (size != sizeof(Header) + ENTRIES)
+    {
+        close(fd);
+        common::print_error("The policy table has a wrong size.");
+        return -1;
+    }
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file.
+    close(fd);
+    if (address == MAP_FAILED)
+    {
+        common::print_error("Failed to map the policy table.");
+        return -1;
+    }
+
+    // Only the header is read; the pages of the entries come in as they
+    // are looked up.
+    Header header;
+    std::memcpy(&header, address, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.entries != ENTRIES)
+    {
+        munmap(address, size);
+        common::print_error("The policy table is not of version " +
+            std::to_string(VERSION) + ".");
+        return -1;
+    }
+    if (mapping != MAP_FAILED) { munmap(mapping, mapping_size); }
+    mapping = address;
+    mapping_size = size;
+    entries = (const uint8_t*)address + sizeof(Header);
+    return 0;
+}
+
+uint8_t PolicyTable::lookup(int16_t deal_type, Decision decision,
+    card_set_t hand) const
+{
+    if (entries == nullptr || deal_type < 1 || deal_type > 7)
+    {
+        return NO_POLICY;
+    }
+    return entries[index(deal_type, decision, hand)];
+}
+
+uint8_t PolicyTable::policy_card(Decision decision, card_set_t hand,
+    uint8_t suit)
+{
+    card_set_t cards = hand & CardModel::suit_cards(suit);
+    if (cards == 0) { return NO_CARD; }
+    return decision == Decision::LEAD ? __builtin_ctzll(cards) :
+        CardModel::top_card(hand, suit);
+}
+
+size_t PolicyTable::index(int16_t deal_type, Decision decision,
+    card_set_t hand)
+{
+    size_t place = (deal_type - 1) * 2 + (size_t)decision;
+    for (uint8_t suit = 0; suit < 4; ++suit)
+    {
+        place = place * 14 +
+            __builtin_popcountll(hand & CardModel::suit_cards(suit));
+    }
+    return place;
+}
+
+int16_t PolicyTable::write(const string& path,
+    const vector<uint8_t>& entries)
+{
+    if (entries.size() != ENTRIES)
+    {
+        common::print_error("The policy table has a wrong size.");
+        return -1;
+    }
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.entries = entries.size();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)entries.data(), entries.size());
+    file.close();
+    if (!file)
+    {
+        common::print_error("Failed to write the policy table.");
+        return -1;
+    }
+    return 0;
+}
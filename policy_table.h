@@ -0,0 +1,84 @@
+#ifndef POLICY_TABLE_H
+#define POLICY_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "card_model.h"
+
+using std::string;
+using std::vector;
+
+/*
+* Suit an AI leads, or throws a card of when it cannot follow, by deal
+* type and hand shape (the number of cards of every suit), made offline
+* by kierki-policy from simulated deals. The file is a header (magic,
+* format version, number of entries) and a byte per entry, the suit or
+* NO_POLICY, at a place computed from the key; it is mapped, not read,
+* so opening it takes the same time whatever its size and a lookup is one
+* load from the mapping.
+*/
+class PolicyTable
+{
+public:
+    enum class Decision : uint8_t { LEAD = 0, DISCARD = 1 };
+
+    // Format of the file; tables of another version are not opened.
+    static constexpr uint32_t VERSION = 1;
+    // Entry with no suit to play.
+    static constexpr uint8_t NO_POLICY = 4;
+    // 14 lengths of each of the 4 suits, 2 decisions, 7 deal types.
+    static constexpr size_t ENTRIES = 14 * 14 * 14 * 14 * 2 * 7;
+
+    PolicyTable();
+    ~PolicyTable();
+    PolicyTable(const PolicyTable&) = delete;
+    PolicyTable& operator=(const PolicyTable&) = delete;
+
+    /*
+    * Maps the table in the file.
+    * Returns 0 on success, -1 on error (printed); no table is mapped then.
+    */
+    int16_t map(const string& path);
+
+    /*
+    * Suit to play for the hand, NO_POLICY if the table has none.
+    */
+    uint8_t lookup(int16_t deal_type, Decision decision,
+        card_set_t hand) const;
+
+    /*
+    * Card of the suit played for the decision: the lowest to lead, the
+    * highest to throw away. NO_CARD if the hand has none of the suit.
+    */
+    static uint8_t policy_card(Decision decision, card_set_t hand,
+        uint8_t suit);
+
+    /*
+    * Place of the entry of the key, deal_type from 1 to 7.
+    */
+    static size_t index(int16_t deal_type, Decision decision,
+        card_set_t hand);
+
+    /*
+    * Writes the entries, ENTRIES of them, as a table file.
+    * Returns 0 on success, -1 on error (printed).
+    */
+    static int16_t write(const string& path, const vector<uint8_t>& entries);
+
+private:
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t entries;
+    };
+
+    void* mapping;
+    size_t mapping_size;
+    const uint8_t* entries;
+};
+
+#endif // POLICY_TABLE_H
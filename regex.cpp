@@ -2,19 +2,25 @@
 
 bool regex::IAM_check(const std::string& s)
 {
-    boost::regex IAM_regex("^IAM[NESW]\\r\\n$");
+    static const boost::regex IAM_regex("^IAM[NESW](\\+[A-Z]+)*\\r\\n$");
     return boost::regex_match(s, IAM_regex);
 }
 
+bool regex::MUX_check(const std::string& s)
+{
+    static const boost::regex MUX_regex("^MUX[NESW]*(\\+[A-Z]+)*\\r\\n$");
+    return boost::regex_match(s, MUX_regex);
+}
+
 bool regex::BUSY_check(const std::string& s)
 {
-    boost::regex BUSY_regex("^BUSY([NESW]{0,4})\\r\\n$");
+    static const boost::regex BUSY_regex("^BUSY([NESW]{0,4})\\r\\n$");
     return boost::regex_match(s, BUSY_regex);
 }
 
 bool regex::DEAL_check(const std::string& s)
 {
-    boost::regex DEAL_regex
+    static const boost::regex DEAL_regex
         ("^DEAL[1-7][NESW](([2-9]|1[0]|J|Q|K|A)[CDHS]){13}\\r\\n$");
     return boost::regex_match(s, DEAL_regex);
 }
@@ -28,14 +34,16 @@ bool regex::TRICK_check(const std::string& s, int16_t trick_nr)
 
 bool regex::TRICK_client_check(const std::string& s)
 {
-    boost::regex TRICK_regex
+    static const boost::regex TRICK_regex
         ("^TRICK([1-9]|1[0-3])([2-9]|1[0]|J|Q|K|A)[CDHS]\\r\\n$");
-    return boost::regex_match(s, TRICK_regex);
+    // Reused between calls, so matching does not allocate the results.
+    static thread_local boost::smatch match;
+    return boost::regex_match(s, match, TRICK_regex);
 }
 
 bool regex::WRONG_check(const std::string& s)
 {
-    boost::regex WRONG_regex("^WRONG([1-9]|1[0-3])\\r\\n$");
+    static const boost::regex WRONG_regex("^WRONG([1-9]|1[0-3])\\r\\n$");
     return boost::regex_match(s, WRONG_regex);
 }
 
@@ -49,19 +57,19 @@ bool regex::TAKEN_check(const std::string& s, int16_t trick_nr)
 
 bool regex::SCORE_check(const std::string& s)
 {
-    boost::regex SCORE_regex("^SCORE([NESW]\\d+){4}\\r\\n$");
+    static const boost::regex SCORE_regex("^SCORE([NESW]\\d+){4}\\r\\n$");
     return boost::regex_match(s, SCORE_regex);
 }
 
 bool regex::TOTAL_check(const std::string& s)
 {
-    boost::regex TOTAL_regex("^TOTAL([NESW]\\d+){4}\\r\\n$");
+    static const boost::regex TOTAL_regex("^TOTAL([NESW]\\d+){4}\\r\\n$");
     return boost::regex_match(s, TOTAL_regex);
 }
 
 std::vector<std::string> regex::extract_cards(const std::string& s)
 {
-    boost::regex card_regex("([2-9]|1[0]|J|Q|K|A)[CDHS]");
+    static const boost::regex card_regex("([2-9]|1[0]|J|Q|K|A)[CDHS]");
     boost::sregex_iterator card_iterator(s.begin(), s.end(), card_regex);
     boost::sregex_iterator end;
     std::vector<std::string> cards;
@@ -72,9 +80,21 @@ std::vector<std::string> regex::extract_cards(const std::string& s)
     return cards;
 }
 
+void regex::extract_cards(const std::string& s,
+    std::pmr::vector<std::string>& cards)
+{
+    static const boost::regex card_regex("([2-9]|1[0]|J|Q|K|A)[CDHS]");
+    boost::sregex_iterator card_iterator(s.begin(), s.end(), card_regex);
+    boost::sregex_iterator end;
+    for (; card_iterator != end; ++card_iterator)
+    {
+        cards.push_back(card_iterator->str());
+    }
+}
+
 std::string regex::extract_trick_nr(const std::string& s)
 {
-    boost::regex trick_nr_regex("TRICK(?:[1-9]|1[0-3])");
+    static const boost::regex trick_nr_regex("TRICK(?:[1-9]|1[0-3])");
     boost::sregex_iterator trick_nr_iterator(s.begin(),
         s.end(), trick_nr_regex);
     return trick_nr_iterator->str();
@@ -82,7 +102,7 @@ std::string regex::extract_trick_nr(const std::string& s)
 
 std::vector<std::string> regex::extract_seat_score(const std::string& s)
 {
-    boost::regex seat_score_regex("([NESW]\\d+)");
+    static const boost::regex seat_score_regex("([NESW]\\d+)");
     boost::sregex_iterator seat_score_iterator(s.begin(), s.end(),
         seat_score_regex);
     boost::sregex_iterator end;
@@ -92,4 +112,22 @@ std::vector<std::string> regex::extract_seat_score(const std::string& s)
         seat_scores.push_back(seat_score_iterator->str());
     }
     return seat_scores;
-}
\ No newline at end of file
+}
+
+bool regex::has_capability(const string& iam, const string& capability)
+{
+    // Capabilities start after "IAM" and the seat.
+    size_t position = iam.find('+', 4);
+    while (position != string::npos)
+    {
+        ++position;
+        size_t end = iam.find_first_of("+\r", position);
+        if (end != string::npos &&
+            iam.compare(position, end - position, capability) == 0)
+        {
+            return true;
+        }
+        position = end == string::npos ? end : iam.find('+', end);
+    }
+    return false;
+}
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <memory_resource>
 
 namespace regex
 {
@@ -15,7 +16,18 @@ namespace regex
     using std::vector;
     using std::to_string;
 
+    /*
+    * IAM may carry capabilities after the seat, each as '+' and
+    * a name, e.g. "IAMN+BOT\r\n"; unknown ones are ignored.
+    */
     bool IAM_check(const string& s);
+
+    /*
+    * Hello of a multiplexed connection (mux.h): "MUX", the seats to open
+    * on channels 0, 1, ... and the capabilities of all of them, e.g.
+    * "MUXNS+BOT\r\n".
+    */
+    bool MUX_check(const string& s);
     bool BUSY_check(const string& s);
     bool DEAL_check(const string& s);
     bool TRICK_check(const string& s, int16_t trick_nr);
@@ -31,6 +43,12 @@ namespace regex
     */
     vector<string> extract_cards(const string& s);
 
+    /*
+    * Same as above, but appends the cards to the given container,
+    * so the caller decides where the memory comes from.
+    */
+    void extract_cards(const string& s, std::pmr::vector<string>& cards);
+
     /*
     * Extracts the trick number from a string containing
     * a trick message.
@@ -42,6 +60,11 @@ namespace regex
     * a score message (ONLY SEAT-SCORE part).
     */
     vector<string> extract_seat_score(const string& s);
+
+    /*
+    * Checks if an IAM message announces the given capability.
+    */
+    bool has_capability(const string& iam, const string& capability);
 } // namespace regex
 
 #pragma GCC diagnostic pop
@@ -0,0 +1,92 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <array>
+#include <cstddef>
+
+using std::array;
+using std::size_t;
+
+/*
+* Fixed-capacity FIFO queue that never allocates. Elements live
+* inside the object, so the memory used by the buffer is known
+* at compile time. Capacity has to be a power of two, so that
+* wrapping an index is a single mask.
+*/
+template <typename T, size_t CAPACITY>
+class RingBuffer
+{
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+        "RingBuffer capacity must be a power of two.");
+
+public:
+    RingBuffer() : elements{}, head{0}, tail{0} {}
+    ~RingBuffer() = default;
+
+    /*
+    * Appends a copy of the element at the back of the buffer.
+    * Returns false and leaves the buffer untouched if it is full.
+    */
+    bool push(const T& element);
+
+    /*
+    * Returns the oldest element. The buffer must not be empty.
+    */
+    T& front();
+
+    /*
+    * Removes the oldest element. The buffer must not be empty.
+    */
+    void pop();
+
+    void clear();
+
+    bool empty() const;
+
+    bool full() const;
+
+    size_t size() const;
+
+    static constexpr size_t capacity() { return CAPACITY; }
+
+private:
+    array<T, CAPACITY> elements;
+    // Both indices grow monotonically, tail - head is the size.
+    size_t head;
+    size_t tail;
+};
+
+template <typename T, size_t CAPACITY>
+bool RingBuffer<T, CAPACITY>::push(const T& element)
+{
+    if (full()) { return false; }
+    elements[tail & (CAPACITY - 1)] = element;
+    ++tail;
+    return true;
+}
+
+template <typename T, size_t CAPACITY>
+T& RingBuffer<T, CAPACITY>::front()
+{
+    return elements[head & (CAPACITY - 1)];
+}
+
+template <typename T, size_t CAPACITY>
+void RingBuffer<T, CAPACITY>::pop() { ++head; }
+
+template <typename T, size_t CAPACITY>
+void RingBuffer<T, CAPACITY>::clear() { head = tail; }
+
+template <typename T, size_t CAPACITY>
+bool RingBuffer<T, CAPACITY>::empty() const { return head == tail; }
+
+template <typename T, size_t CAPACITY>
+bool RingBuffer<T, CAPACITY>::full() const
+{
+    return tail - head == CAPACITY;
+}
+
+template <typename T, size_t CAPACITY>
+size_t RingBuffer<T, CAPACITY>::size() const { return tail - head; }
+
+#endif // RING_BUFFER_H
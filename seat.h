@@ -0,0 +1,61 @@
+#ifndef SEAT_H
+#define SEAT_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/*
+* Seat at the table. N, E, S and W are the players in the order
+* of play; their values are used directly as array indices.
+* K is the slot of the connection thread (it has its own pipes),
+* NONE marks that no seat is selected.
+*/
+enum class Seat : uint8_t { N = 0, E = 1, S = 2, W = 3, K = 4, NONE = 5 };
+
+namespace seating
+{
+    using std::array;
+    using std::size_t;
+
+    constexpr size_t SEATS_NUMBER = 4;
+
+    constexpr array<Seat, SEATS_NUMBER> ALL_SEATS
+        {Seat::N, Seat::E, Seat::S, Seat::W};
+
+    constexpr size_t index(Seat seat) { return static_cast<size_t>(seat); }
+
+    /*
+    * Character used for the seat in the protocol.
+    */
+    constexpr char to_char(Seat seat) { return "NESWKx"[index(seat)]; }
+
+    /*
+    * Seat described by the protocol character, NONE if there is no such seat.
+    */
+    constexpr Seat from_char(char c)
+    {
+        switch (c)
+        {
+            case 'N': return Seat::N;
+            case 'E': return Seat::E;
+            case 'S': return Seat::S;
+            case 'W': return Seat::W;
+            case 'K': return Seat::K;
+            default: return Seat::NONE;
+        }
+    }
+
+    /*
+    * Seat that plays offset turns after the given one.
+    */
+    constexpr Seat next(Seat seat, size_t offset = 1)
+    {
+        return static_cast<Seat>((index(seat) + offset) % SEATS_NUMBER);
+    }
+
+    static_assert(from_char(to_char(Seat::W)) == Seat::W);
+    static_assert(next(Seat::W) == Seat::N);
+} // namespace seating
+
+#endif // SEAT_H
@@ -1,81 +1,210 @@
 #include "senders.h"
+#include "alloc_stats.h"
+
+#include <sys/uio.h>
+
+namespace
+{
+    /*
+    * Writes the frame if there is one, the text otherwise.
+    */
+    ssize_t write_message(int32_t socket_fd, string& message, string* frame)
+    {
+        string& data = frame == nullptr ? message : *frame;
+        if (socket_fd == senders::NO_SOCKET) { return data.size(); }
+        return common::write_to_socket(socket_fd, data.data(), data.size());
+    }
+} // namespace
+
+size_t senders::wire_size(const string& message, const string* frame)
+{
+    return frame == nullptr ? message.size() : frame->size();
+}
 
 ssize_t senders::send_iam(int32_t socket_fd, const string& seat,
-    string& message)
+    string& message, const string& capabilities)
 {
-    message = "IAM" + seat + DELIMETER;
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_IAM);
+    message.assign("IAM");
+    message += seat;
+    message += capabilities;
+    message += DELIMETER;
     return common::write_to_socket(socket_fd,
         message.data(), message.length());
 }
 
 ssize_t senders::send_busy(int32_t socket_fd, const string& seats,
-    string& message)
+    string& message, string* frame)
 {
-    message = "BUSY" + seats + DELIMETER;
-    return common::write_to_socket(socket_fd,
-        message.data(), message.length());
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_BUSY);
+    message.assign("BUSY");
+    message += seats;
+    message += DELIMETER;
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_busy(*frame, seats);
+    }
+    return write_message(socket_fd, message, frame);
 }
 
 ssize_t senders::send_deal(int32_t socket_fd, int16_t deal_type,
-    const string& start_seat, const vector<string>& cards, string& message)
+    Seat start_seat, span<const string> cards, string& message,
+    string* frame)
 {
-    message = "DEAL" + std::to_string(deal_type) + start_seat;
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_DEAL);
+    message.assign("DEAL");
+    message += std::to_string(deal_type);
+    message += seating::to_char(start_seat);
     for (const string& card : cards) { message += card; }
     message += DELIMETER;
-    return common::write_to_socket(socket_fd, message.data(),
-        message.length());
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_deal(*frame, deal_type, start_seat, cards);
+    }
+    return write_message(socket_fd, message, frame);
 }
 
 ssize_t senders::send_trick(int32_t socket_fd, int16_t trick_number,
-    const vector<string>& cards, string& message)
+    span<const string> cards, string& message, string* frame)
 {
-    message = "TRICK" + std::to_string(trick_number);
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_TRICK);
+    message.assign("TRICK");
+    message += std::to_string(trick_number);
     for (const string& card : cards) { message += card; }
     message += DELIMETER;
-    return common::write_to_socket(socket_fd, message.data(),
-        message.length());
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_trick(*frame, trick_number, cards);
+    }
+    return write_message(socket_fd, message, frame);
+}
+
+ssize_t senders::send_trick(int32_t socket_fd, int16_t trick_number,
+    const string& card, string& message, string* frame)
+{
+    return send_trick(socket_fd, trick_number, span<const string>(&card, 1),
+        message, frame);
 }
 
 ssize_t senders::send_wrong(int32_t socket_fd,
-    int16_t trick_number, string& message)
+    int16_t trick_number, string& message, string* frame)
 {
-    message = "WRONG" + std::to_string(trick_number) + DELIMETER;
-    return common::write_to_socket(socket_fd,
-        message.data(), message.length());
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_WRONG);
+    message.assign("WRONG");
+    message += std::to_string(trick_number);
+    message += DELIMETER;
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_wrong(*frame, trick_number);
+    }
+    return write_message(socket_fd, message, frame);
 }
 
 ssize_t senders::send_taken(int32_t socket_fd, int16_t trick_number,
-    const vector<string>& cards, const string& taking_seat, string& message)
+    span<const string> cards, Seat taking_seat, string& message,
+    string* frame)
 {
-    message = "TAKEN" + std::to_string(trick_number);
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_TAKEN);
+    message.assign("TAKEN");
+    message += std::to_string(trick_number);
     for (const string& card : cards) { message += card; }
-    message += taking_seat + DELIMETER;
-    return common::write_to_socket(socket_fd,
-        message.data(), message.length());
+    message += seating::to_char(taking_seat);
+    message += DELIMETER;
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_taken(*frame, trick_number, cards, taking_seat);
+    }
+    return write_message(socket_fd, message, frame);
+}
+
+ssize_t senders::send_taken_and_trick(int32_t socket_fd,
+    int16_t trick_number, span<const string> cards, Seat taking_seat,
+    span<const string> table, string& message, string& trick_message,
+    string* frame)
+{
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_TAKEN);
+    message.assign("TAKEN");
+    message += std::to_string(trick_number);
+    for (const string& card : cards) { message += card; }
+    message += seating::to_char(taking_seat);
+    message += DELIMETER;
+    trick_message.assign("TRICK");
+    trick_message += std::to_string(trick_number + 1);
+    for (const string& card : table) { trick_message += card; }
+    trick_message += DELIMETER;
+    if (frame != nullptr)
+    {
+        // Both frames in one buffer, a single write is enough.
+        frame->clear();
+        frames::encode_taken(*frame, trick_number, cards, taking_seat);
+        frames::encode_trick(*frame, trick_number + 1, table);
+        return write_message(socket_fd, message, frame);
+    }
+    if (socket_fd == NO_SOCKET)
+    {
+        return message.size() + trick_message.size();
+    }
+
+    // One segment on the wire, the second message is not held back
+    // by Nagle's algorithm waiting for the ACK of the first.
+    struct iovec parts[2] = {{message.data(), message.size()},
+        {trick_message.data(), trick_message.size()}};
+    size_t total = message.size() + trick_message.size();
+    ssize_t written = writev(socket_fd, parts, 2);
+    if (written <= 0 || (size_t)written == total) { return written; }
+    // Short write, send the rest as usual.
+    if ((size_t)written < message.size())
+    {
+        ssize_t result = common::write_to_socket(socket_fd,
+            message.data() + written, message.size() - written);
+        if (result <= 0) { return result; }
+        written += result;
+    }
+    ssize_t result = common::write_to_socket(socket_fd, trick_message.data() +
+        (written - message.size()), total - written);
+    if (result <= 0) { return result; }
+    return written + result;
 }
 
 ssize_t senders::send_score(int32_t socket_fd,
-    const map<string, int32_t>& scores, string& message)
+    const array<int32_t, 4>& scores, string& message, string* frame)
 {
-    message = "SCORE";
-    for (const auto& score : scores) 
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_SCORE);
+    message.assign("SCORE");
+    for (Seat seat : seating::ALL_SEATS) 
     {
-        message += score.first + std::to_string(score.second);
-    } 
+        message += seating::to_char(seat);
+        message += std::to_string(scores[seating::index(seat)]);
+    }
     message += DELIMETER;
-    return common::write_to_socket(socket_fd,
-        message.data(), message.length());
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_scores(*frame, frames::Type::SCORE_FRAME, scores);
+    }
+    return write_message(socket_fd, message, frame);
 }
 
 ssize_t senders::send_total(int32_t socket_fd,
-    const map<string, int32_t>& scores, string& message)
+    const array<int32_t, 4>& scores, string& message, string* frame)
 {
-    message = "TOTAL";
-    for (const auto& score : scores) 
+    ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::SEND_TOTAL);
+    message.assign("TOTAL");
+    for (Seat seat : seating::ALL_SEATS) 
     {
-        message += score.first + std::to_string(score.second); 
+        message += seating::to_char(seat);
+        message += std::to_string(scores[seating::index(seat)]);
     }
     message += DELIMETER;
-    return common::write_to_socket(socket_fd, message.data(),
-        message.length());
+    if (frame != nullptr)
+    {
+        frame->clear();
+        frames::encode_scores(*frame, frames::Type::TOTAL_FRAME, scores);
+    }
+    return write_message(socket_fd, message, frame);
 }
\ No newline at end of file
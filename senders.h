@@ -4,39 +4,70 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
-#include <map>
+#include <array>
+#include <span>
 
 #include "common.h"
+#include "seat.h"
+#include "frames.h"
 
 namespace senders
 {
     using std::string;
     using std::vector;
-    using std::map;
+    using std::array;
+    using std::span;
 
-    ssize_t send_iam(int32_t socket_fd, const string& seat, string& message);
+    /*
+    * Every sender fills message with the text, which goes to the logs.
+    * Given a frame, it sends the message as a binary frame built there
+    * (see frames.h) instead of the text. Senders return the number of
+    * bytes written; this is what they write on success. Given NO_SOCKET,
+    * a sender only builds the message and returns that size; the caller
+    * sends it.
+    */
+    constexpr int32_t NO_SOCKET = -1;
 
-    ssize_t send_busy(int32_t socket_fd, const string& seats, string& message);
+    size_t wire_size(const string& message, const string* frame);
+
+    /* Capabilities are appended as given, e.g. "+BOT". */
+    ssize_t send_iam(int32_t socket_fd, const string& seat, string& message,
+        const string& capabilities = "");
+
+    ssize_t send_busy(int32_t socket_fd, const string& seats, string& message,
+        string* frame = nullptr);
 
     ssize_t send_deal(int32_t socket_fd, int16_t deal_type,
-        const string& start_seat, const vector<string>& cards,
-        string& message);
+        Seat start_seat, span<const string> cards,
+        string& message, string* frame = nullptr);
 
     ssize_t send_trick(int32_t socket_fd, int16_t trick_number, 
-        const vector<string>& cards, string& message);
+        span<const string> cards, string& message, string* frame = nullptr);
+
+    /* Sends a TRICK message with a single card. */
+    ssize_t send_trick(int32_t socket_fd, int16_t trick_number, 
+        const string& card, string& message, string* frame = nullptr);
 
     ssize_t send_wrong(int32_t socket_fd, int16_t trick_number,
-        string& message);
+        string& message, string* frame = nullptr);
 
     ssize_t send_taken(int32_t socket_fd, int16_t trick_number,
-        const vector<string>& cards, const string& taking_seat,
-        string& message);
+        span<const string> cards, Seat taking_seat,
+        string& message, string* frame = nullptr);
+
+    /*
+    * Sends TAKEN and the TRICK of the next trick in one write, for
+    * the seat that took the trick and leads the next one.
+    */
+    ssize_t send_taken_and_trick(int32_t socket_fd, int16_t trick_number,
+        span<const string> cards, Seat taking_seat, span<const string> table,
+        string& message, string& trick_message, string* frame = nullptr);
 
-    ssize_t send_score(int32_t socket_fd, const map<string, int32_t>& scores,
-        string& message);
+    ssize_t send_score(int32_t socket_fd, const array<int32_t, 4>& scores,
+        string& message, string* frame = nullptr);
 
-    ssize_t send_total(int32_t socket_fd, const map<string, int32_t>& scores,
-        string& message);
+    ssize_t send_total(int32_t socket_fd, const array<int32_t, 4>& scores,
+        string& message, string* frame = nullptr);
 
 } // namespace senders
 
@@ -1,18 +1,33 @@
 #include "serwer.h"
+#include "alloc_stats.h"
+#include "trace.h"
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <fcntl.h>
 
 Serwer::Serwer(int32_t port, int32_t timeout,
-    const std::string& game_file_name)
+    const std::string& game_file_name, const std::string& metrics_path,
+    const std::string& journal_path, const std::string& game_log_path,
+    int32_t bot_grace, bool b_is_bot_table)
     : server_address{}, thread_id{0}, client_threads{}, joinable_threads{},
     memory_mutex{}, print_mutex{}, port{port}, timeout{timeout * 1000},
-    game_file_name{game_file_name}, occupied{0}, seats_status{{"N", -1},
-    {"E", -1}, {"S", -1}, {"W", -1}}, seats_to_array{{"N", 0}, {"E", 1},
-    {"S", 2}, {"W", 3}, {"K", 4}},  current_message{}, cards_on_table{},
-    round_scores{{{"N", 0}, {"E", 0}, {"S", 0}, {"W", 0}}},
-    total_scores{{"N", 0}, {"E", 0}, {"S", 0}, {"W", 0}}, trick_number{0},
-    cards{}, deal{}, taken_tricks{}, taken_takers{}, last_taker{},
-    player_turn{"x"}, waiting_on_barrier{0}, b_is_barrier_ongoing{false},
+    game_file_name{game_file_name}, metrics_path{metrics_path},
+    metrics_server{}, journal_path{journal_path}, journal_writer{},
+    game_log_path{game_log_path}, game_log{}, deals_finished{0},
+    b_is_deal_resumed{false}, bot_grace{bot_grace}, bot_seats{},
+    vacant_since{}, b_is_bot_table{b_is_bot_table}, bot_capable{},
+    b_is_fast_table{false}, pre_capable{}, pre_commits{},
+    binary_seats{}, occupied{0}, seats_status{-1, -1, -1, -1},
+    current_message{}, deal_arena{}, cards_on_table{deal_arena.resource()},
+    round_scores{}, total_scores{}, trick_number{0},
+    cards{cards_t{deal_arena.resource()}, cards_t{deal_arena.resource()},
+    cards_t{deal_arena.resource()}, cards_t{deal_arena.resource()}},
+    deal{cards_t{deal_arena.resource()}, cards_t{deal_arena.resource()},
+    cards_t{deal_arena.resource()}, cards_t{deal_arena.resource()}},
+    taken_tricks{deal_arena.resource()}, taken_takers{deal_arena.resource()},
+    deal_starter{Seat::NONE}, start_seat_global{Seat::NONE},
+    last_taker{Seat::NONE}, player_turn{Seat::NONE}, waiting_on_barrier{0},
+    b_is_barrier_ongoing{false}, trick_sent_at{}, last_card_at{0},
     barrier_messages{}
     { signal(SIGPIPE, SIG_IGN); }
     
@@ -32,7 +47,7 @@ void Serwer::close_fds(const initializer_list<int32_t>& fds)
 }
 
 void Serwer::close_thread(const string& error_message,
-    const initializer_list<int>& fds, const string& seat,
+    const initializer_list<int>& fds, Seat seat,
     bool b_was_occupying, bool b_was_ended_by_server = false)
 {
     if (error_message != "") { common::print_error
@@ -49,16 +64,19 @@ void Serwer::close_thread(const string& error_message,
         */
         if (!b_was_ended_by_server) 
         {
+            metrics::increment(metrics::Counter::DISCONNECTS);
             b_is_barrier_ongoing = true;
-            seats_status[seat] = -1;
+            seats_status[seating::index(seat)] = -1;
+            vacant_since[seating::index(seat)] = metrics::now();
+            bot_capable[seating::index(seat)] = false;
         }
         memory_mutex.unlock();
     }
     if ((!b_was_ended_by_server) && (b_was_occupying ||
-        seat == CONNECTIONS_THREAD))
+        seat == Seat::K))
     {
         ssize_t pipe_write = common::write_to_pipe
-            (server_read_pipes[seats_to_array[seat]][1], DISCONNECTED);
+            (server_read_pipes[seating::index(seat)][1], DISCONNECTED);
         if (pipe_write != 1) { common::print_error
             ("Failed to notify server.", print_mutex); }
     }
@@ -66,7 +84,7 @@ void Serwer::close_thread(const string& error_message,
 }
 
 int16_t Serwer::assert_client_read_socket(ssize_t result,
-    const initializer_list<int32_t>& fds, const string& seat,
+    const initializer_list<int32_t>& fds, Seat seat,
     bool b_was_occupying)
 {
     if (result == 0)
@@ -86,7 +104,7 @@ int16_t Serwer::assert_client_read_socket(ssize_t result,
 }
 
 int16_t Serwer::assert_client_write_socket(ssize_t result, ssize_t expected,
-    const initializer_list<int32_t>& fds, const string& seat,
+    const initializer_list<int32_t>& fds, Seat seat,
     bool b_was_occupying)
 {
 
@@ -96,11 +114,13 @@ int16_t Serwer::assert_client_write_socket(ssize_t result, ssize_t expected,
             seat, b_was_occupying);
         return -1;
     }
+    metrics::increment(metrics::Counter::MESSAGES_SENT);
+    journal::count_sent(result);
     return 0;
 }
 
 int16_t Serwer::assert_client_read_pipe(ssize_t result,
-    const initializer_list<int32_t>& fds, const string& seat,
+    const initializer_list<int32_t>& fds, Seat seat,
     bool b_was_occupying)
 {
     if (result == 0)
@@ -122,7 +142,7 @@ int16_t Serwer::assert_client_read_pipe(ssize_t result,
 }
 
 int16_t Serwer::assert_client_write_pipe(ssize_t result,
-    const initializer_list<int>& fds, const string& seat,
+    const initializer_list<int>& fds, Seat seat,
     bool b_was_occupying)
 {
     if (result != 1)
@@ -194,6 +214,15 @@ int16_t Serwer::close_server(const string& error_message = "")
         }
     }
 
+    // After the seats, which then close their channels themselves.
+    if (write(mux_close_pipe[1], END, 1) != 1)
+    {
+        common::print_error(
+            "Failed to notify multiplexed clients on server close.",
+            print_mutex);
+        b_did_something_fail = true;
+    }
+
     for (auto iter = client_threads.begin();
         iter != client_threads.end(); ++iter)
     {
@@ -210,29 +239,44 @@ int16_t Serwer::close_server(const string& error_message = "")
         close_fds({server_read_pipes[i][0], server_read_pipes[i][1],
             server_write_pipes[i][0], server_write_pipes[i][1]});
     }
+    close_fds({mux_close_pipe[0], mux_close_pipe[1]});
 
     if (error_message != "") 
     {
         common::print_error(error_message, print_mutex);
         b_did_something_fail = true;
     }
+
+    metrics_server.stop();
+    journal_writer.close();
+    game_log.close();
+    lock_stats::dump(cerr);
+#ifdef ALLOC_STATS
+    // All threads are joined, nothing allocates anymore.
+    alloc_stats::dump(cerr);
+    report_deal_arena();
+    DealArena::Stats arena = deal_arena.total_stats();
+    cerr << "Deal arena: " << arena.allocations << " allocations, "
+        << arena.bytes << " bytes in total\n";
+#endif
     return b_did_something_fail;
 }
 
 int16_t Serwer::barrier()
 {
+    TRACE_SPAN("barrier");
+    uint64_t started_at = metrics::now();
     int16_t waiting = 0;
     memory_mutex.lock();
     b_is_barrier_ongoing = true;
-    occupied = 0;
+    // Seats played by the bot are always there.
+    occupied = std::count(bot_seats.begin(), bot_seats.end(), true);
     waiting = 4 - occupied;
     memory_mutex.unlock();
 
     for (int16_t i = 0; i < 4; ++i)
     {
-        ssize_t pipe_write = common::write_to_pipe
-            (server_write_pipes[i][1], BARRIER_RESPONSE);
-        if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+        if (notify_seat(i, BARRIER_RESPONSE) < 0) {return -1;}
     }
 
     struct pollfd poll_descriptors[5];
@@ -245,9 +289,29 @@ int16_t Serwer::barrier()
     while(waiting > 0)
     {
         for (int16_t i = 0; i < 5; ++i) {poll_descriptors[i].revents = 0;}
+        // Wake up when the first vacant seat is due for the bot.
+        int32_t poll_timeout = -1;
+        if (bot_grace >= 0)
+        {
+            uint64_t current = metrics::now();
+            memory_mutex.lock();
+            for (size_t i = 0; i < 4; ++i)
+            {
+                if (bot_seats[i] || seats_status[i] != -1 ||
+                    vacant_since[i] == 0) {continue;}
+                uint64_t due = vacant_since[i] + bot_grace * 1000000ull;
+                int32_t left = due > current ?
+                    (due - current) / 1000000 + 1 : 0;
+                if (poll_timeout < 0 || left < poll_timeout)
+                {
+                    poll_timeout = left;
+                }
+            }
+            memory_mutex.unlock();
+        }
         // Wait for clients to join.
-        int poll_result = poll(&poll_descriptors[0], 5, -1);
-        if (poll_result <= 0)
+        int poll_result = poll(&poll_descriptors[0], 5, poll_timeout);
+        if (poll_result < 0)
         {
             close_server("Failed to poll while waiting for clients.");
             return -1;
@@ -271,9 +335,7 @@ int16_t Serwer::barrier()
                     {
                         // We want a new client to be able 
                         // to participate in the barrier.
-                        ssize_t pipe_write = common::write_to_pipe
-                            (server_write_pipes[i][1], BARRIER_RESPONSE);
-                        if (assert_server_write_pipe(pipe_write) < 0)
+                        if (notify_seat(i, BARRIER_RESPONSE) < 0)
                         {
                             return -1;
                         }
@@ -294,23 +356,127 @@ int16_t Serwer::barrier()
             }
         }
         memory_mutex.lock();
+        if (bot_grace >= 0) {substitute_bots();}
         waiting = 4 - occupied;
-        if (waiting == 0) { b_is_barrier_ongoing = false; }
+        if (waiting <= 0)
+        {
+            b_is_barrier_ongoing = false;
+            // Players who reclaimed a seat during the barrier wait
+            // for its end.
+            reclaim_bot_seats();
+        }
         memory_mutex.unlock();
     }
 
     for (int16_t i = 0; i < 4; ++i)
     {
-        ssize_t pipe_write = common::write_to_pipe
-            (server_write_pipes[i][1], BARRIER_END);
-        if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+        if (notify_seat(i, BARRIER_END) < 0) {return -1;}
     }
 
+    metrics::record_since(metrics::Latency::BARRIER, started_at);
     return 0;
 }
 
+void Serwer::substitute_bots()
+{
+    uint64_t current = metrics::now();
+    for (size_t i = 0; i < 4; ++i)
+    {
+        if (bot_seats[i] || seats_status[i] != -1 || vacant_since[i] == 0 ||
+            current - vacant_since[i] < bot_grace * 1000000ull)
+        {
+            continue;
+        }
+        // Nobody reads the pipe of a vacant seat; drop what the server
+        // sent there, the next player catches up in reserve_spot anyway.
+        // A returning player would answer every barrier request left
+        // there, the bot answers them instead.
+        struct pollfd pipe_descriptor{server_write_pipes[i][0], POLLIN, 0};
+        while (poll(&pipe_descriptor, 1, 0) > 0 &&
+            (pipe_descriptor.revents & POLLIN))
+        {
+            string stale;
+            if (common::read_from_pipe(pipe_descriptor.fd, stale) <= 0)
+            {
+                break;
+            }
+            if (stale == BARRIER_RESPONSE) {++occupied;}
+        }
+        bot_seats[i] = true;
+        metrics::increment(metrics::Counter::BOT_TAKEOVERS);
+    }
+}
+
+void Serwer::reclaim_bot_seats()
+{
+    for (size_t i = 0; i < 4; ++i)
+    {
+        if (bot_seats[i] && seats_status[i] != -1) {bot_seats[i] = false;}
+    }
+}
+
+void Serwer::play_bot_card(Seat seat)
+{
+    cards_t& hand = cards[seating::index(seat)];
+    auto card = hand.end() - 1;
+    if (!cards_on_table.empty())
+    {
+        char color = cards_on_table[0][cards_on_table[0].size() - 1];
+        auto same_color = std::find_if(hand.begin(), hand.end(),
+            [color](const string& held)
+            { return held[held.size() - 1] == color; });
+        if (same_color != hand.end()) {card = same_color;}
+    }
+    cards_on_table.push_back(*card);
+    hand.erase(card);
+    player_turn = Seat::NONE;
+    last_card_at = metrics::now();
+    metrics::increment(metrics::Counter::BOT_CARDS);
+}
+
+int16_t Serwer::notify_seat(size_t seat_index, const string& message)
+{
+    if (bot_seats[seat_index]) {return 0;}
+    ssize_t pipe_write = common::write_to_pipe
+        (server_write_pipes[seat_index][1], message);
+    return assert_server_write_pipe(pipe_write);
+}
+
+bool Serwer::has_taken_trick()
+{
+    memory_mutex.lock();
+    bool b_has_taken = !taken_tricks.empty();
+    memory_mutex.unlock();
+    return b_has_taken;
+}
+
+void Serwer::update_fast_table()
+{
+    b_is_fast_table = b_is_bot_table;
+    if (!b_is_fast_table)
+    {
+        b_is_fast_table = true;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            if (!bot_capable[i] && !bot_seats[i]) {b_is_fast_table = false;}
+        }
+    }
+}
+
 int16_t Serwer::start_game()
 {
+    tracing::set_thread_name("main");
+    if (!metrics_path.empty() && metrics_server.start(metrics_path) < 0)
+    {
+        return 1;
+    }
+    if (!journal_path.empty() && journal_writer.open(journal_path) < 0)
+    {
+        return 1;
+    }
+    // Before the connection thread, so reconnecting players catch up.
+    if (!game_log_path.empty() && recover_game() < 0) {return 1;}
+
     for (int16_t i = 0; i < 5; ++i)
     {
         if (pipe(server_read_pipes[i]) < 0)
@@ -335,6 +501,16 @@ int16_t Serwer::start_game()
             return 1;
         }
     }
+    if (pipe(mux_close_pipe) < 0)
+    {
+        common::print_error("Failed to create pipes.", print_mutex);
+        for (int16_t i = 0; i < 5; ++i)
+        {
+            close_fds({server_read_pipes[i][0], server_read_pipes[i][1],
+                server_write_pipes[i][0], server_write_pipes[i][1]});
+        }
+        return 1;
+    }
 
     try
     {
@@ -351,21 +527,197 @@ int16_t Serwer::start_game()
 }
 
 
-int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
+void Serwer::report_deal_arena()
 {
-    memory_mutex.lock();
+#ifdef ALLOC_STATS
+    DealArena::Stats used = deal_arena.deal_stats();
+    // No deal was played since the last reset.
+    if (used.allocations == 0) { return; }
+    DealArena::Stats overflowed = deal_arena.overflow_stats();
+    print_mutex.lock();
+    cerr << "Deal arena: " << used.allocations << " allocations, "
+        << used.bytes << " bytes in the deal, " << overflowed.allocations
+        << " allocations, " << overflowed.bytes << " bytes over the buffer\n";
+    print_mutex.unlock();
+#endif
+}
+
+void Serwer::reset_deal_state()
+{
+    // Its figures are cleared by the reset.
+    report_deal_arena();
+    // Assigning fresh containers frees their memory (a no-op for the
+    // arena), only then the arena can be released.
+    std::pmr::memory_resource* resource = deal_arena.resource();
+    cards_on_table = cards_t(resource);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        cards[i] = cards_t(resource);
+        deal[i] = cards_t(resource);
+    }
+    taken_tricks = std::pmr::vector<cards_t>(resource);
+    taken_takers = std::pmr::vector<Seat>(resource);
+    deal_arena.reset();
+
+    // Reserve everything up front, so nothing is reallocated during the deal.
+    cards_on_table.reserve(4);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        cards[i].reserve(13);
+        deal[i].reserve(13);
+    }
+    taken_tricks.reserve(13);
+    taken_takers.reserve(13);
+}
+
+size_t Serwer::copy_cards_on_table(array<string, 4>& destination)
+{
+    size_t count = std::min(cards_on_table.size(), destination.size());
+    std::copy_n(cards_on_table.begin(), count, destination.begin());
+    return count;
+}
+
+void Serwer::setup_deal(int16_t trick_type, Seat seat,
+    const array<string, 4>& raw_cards)
+{
+    reset_deal_state();
+    deal_starter = seat;
+    for (size_t i = 0; i < 4; ++i) 
+    { 
+        regex::extract_cards(raw_cards[i], cards[i]);
+        deal[i].assign(cards[i].begin(), cards[i].end());
+    }
     trick_type_global = trick_type;
     start_seat_global = seat;
     last_taker = seat;
     trick_number = 0;
+    round_scores = {};
+}
+
+int16_t Serwer::recover_game()
+{
+    uint64_t started_at = metrics::now();
+    game_log::RecoveredGame game;
+    int16_t result = game_log::recover(game_log_path, game);
+    if (result < 0) {return -1;}
+    deals_finished = game.deals_finished;
+    total_scores = game.total_scores;
+    if (!game.events.empty() && replay_deal(game.events) < 0) {return -1;}
+    if (game_log.open(game_log_path, game) < 0) {return -1;}
+
+    if (result > 0)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "Game log: %lu deals finished, "
+            "resuming at trick %d in %.3f ms\n", deals_finished,
+            b_is_deal_resumed ? trick_number : 0,
+            (metrics::now() - started_at) / 1e6);
+        cerr << line;
+    }
+    return 0;
+}
+
+int16_t Serwer::replay_deal(const vector<game_log::Event>& events)
+{
+    // The log of a deal always starts with its DEAL_START.
+    if (events[0].type != game_log::Record::DEAL_START ||
+        events[0].deal != deals_finished)
+    {
+        common::print_error("Game log does not match the game file.");
+        return -1;
+    }
+    FileReader fr(game_file_name);
+    for (uint64_t i = 0; i <= deals_finished; ++i)
+    {
+        if (fr.read_next_deal() <= 0)
+        {
+            common::print_error("Game log does not match the game file.");
+            return -1;
+        }
+    }
+
+    memory_mutex.lock();
+    setup_deal(fr.get_trick_type(), seating::from_char(fr.get_seat()[0]),
+        fr.get_cards());
+    bool b_does_match = true;
+    for (size_t i = 1; i < events.size() && b_does_match; ++i)
+    {
+        const game_log::Event& event = events[i];
+        if (event.type == game_log::Record::PLAY)
+        {
+            // First card of a trick, as in run_deal.
+            if (taken_tricks.size() == (size_t)trick_number)
+            {
+                cards_on_table.clear();
+                ++trick_number;
+            }
+            cards_t& hand = cards[seating::index(event.seat)];
+            auto card = find(hand.begin(), hand.end(), event.card);
+            b_does_match = trick_number <= 13 && card != hand.end() &&
+                cards_on_table.size() < 4;
+            if (b_does_match)
+            {
+                hand.erase(card);
+                cards_on_table.push_back(event.card);
+            }
+        }
+        else if (event.type == game_log::Record::TRICK_END)
+        {
+            b_does_match = cards_on_table.size() == 4 &&
+                taken_tricks.size() < (size_t)trick_number;
+            if (b_does_match)
+            {
+                taken_tricks.emplace_back(cards_on_table.begin(),
+                    cards_on_table.end());
+                taken_takers.push_back(event.seat);
+                last_taker = event.seat;
+                round_scores[seating::index(event.seat)] += event.points;
+            }
+        }
+        else {b_does_match = false;}
+    }
     memory_mutex.unlock();
+    if (!b_does_match)
+    {
+        common::print_error("Game log does not match the game file.");
+        return -1;
+    }
+    b_is_deal_resumed = true;
+    return 0;
+}
 
-    // Send DEAL
-    for (int16_t i = 0; i < 4; ++i)
+int16_t Serwer::run_deal(int16_t trick_type, Seat seat,
+    const array<string, 4>& raw_cards, bool b_is_resumed)
+{
+    ALLOC_STATS_PROCESS_SCOPE(alloc_stats::Scope::PER_DEAL);
+    TRACE_SPAN("deal");
+    uint64_t started_at = metrics::now();
+    array<int32_t, 4> scores{};
+    // Where a resumed deal continues; the players got the deal, the taken
+    // tricks and the table in reserve_spot.
+    int16_t first_trick = 0;
+    int16_t first_card = 0;
+    if (b_is_resumed)
     {
-        ssize_t pipe_write = common::write_to_pipe
-            (server_write_pipes[i][1], DEAL);
-        if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+        memory_mutex.lock();
+        first_trick = taken_tricks.size();
+        if (trick_number > first_trick) {first_card = cards_on_table.size();}
+        scores = round_scores;
+        memory_mutex.unlock();
+    }
+    else
+    {
+        memory_mutex.lock();
+        setup_deal(trick_type, seat, raw_cards);
+        reclaim_bot_seats();
+        memory_mutex.unlock();
+        if (!game_log_path.empty()) {game_log.log_deal_start(deals_finished);}
+
+        // Send DEAL
+        for (int16_t i = 0; i < 4; ++i)
+        {
+            if (notify_seat(i, DEAL) < 0) {return -1;}
+        }
     }
 
     struct pollfd poll_descriptors[5];
@@ -374,14 +726,22 @@ int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
         poll_descriptors[i].fd = server_read_pipes[i][0];
         poll_descriptors[i].events = POLLIN;
     }
-    array<string, 4> seats = {"N", "E", "S", "W"};
-    map<string, int32_t> scores{{"N", 0}, {"E", 0}, {"S", 0}, {"W", 0}};
-    for (int16_t i = 0; i < 13; ++i)
+    // Set when the leader of the trick already got its TRICK together
+    // with the TAKEN of the previous one.
+    bool b_is_pipelined = false;
+    for (int16_t i = first_trick; i < 13; ++i)
     {
+        ALLOC_STATS_PROCESS_SCOPE(alloc_stats::Scope::PER_TRICK);
+        TRACE_SPAN("trick", i + 1);
         memory_mutex.lock();
-        cards_on_table.clear();
-        ++trick_number;
-        int16_t beginning = seats_to_array[last_taker];
+        if (first_card == 0 && !b_is_pipelined)
+        {
+            cards_on_table.clear();
+            ++trick_number;
+        }
+        Seat beginning = last_taker;
+        reclaim_bot_seats();
+        update_fast_table();
 
         // Join joinable threads.
         for (uint64_t id : joinable_threads)
@@ -397,15 +757,25 @@ int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
             }
         }
         memory_mutex.unlock();
-        for (int16_t i = 0; i < 4; ++i)
+        for (int16_t i = first_card; i < 4; ++i)
         {
+            Seat turn = seating::next(beginning, i);
+            // Pipe, client thread, player and back.
+            TRACE_SPAN("wait_card", trick_number, seating::to_char(turn));
             memory_mutex.lock();
-            player_turn = seats[(beginning + i) % 4];
+            if (!b_is_pipelined) {player_turn = turn;}
+            // The bot plays at once, no player ever sees its turn.
+            bool b_received_card = bot_seats[seating::index(turn)] &&
+                player_turn == turn;
+            if (b_received_card) {play_bot_card(turn);}
             memory_mutex.unlock();
-            ssize_t pipe_write = common::write_to_pipe
-                (server_write_pipes[(beginning + i) % 4][1], CARD_PLAY);
-            if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
-            bool b_received_card = false;
+            if (!b_received_card && !b_is_pipelined)
+            {
+                ssize_t pipe_write = common::write_to_pipe
+                    (server_write_pipes[seating::index(turn)][1], CARD_PLAY);
+                if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+            }
+            b_is_pipelined = false;
             while (!b_received_card)
             {
                 for (int j = 0; j < 5; ++j) { poll_descriptors[j]
@@ -429,8 +799,8 @@ int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
                             {
                                 return -1;
                             }
-                            if (thread_message == CARD_PLAY && j ==
-                                (beginning + i) % 4)
+                            if (thread_message == CARD_PLAY &&
+                                (size_t)j == seating::index(turn))
                             {
                                 // Client played a card.
                                 b_received_card = true;
@@ -448,6 +818,16 @@ int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
                                     // Wait for threads.
                                     int16_t result = barrier();
                                     if (result < 0) {return -1;}
+                                    // The bot may have taken the seat
+                                    // whose card we wait for.
+                                    memory_mutex.lock();
+                                    if (bot_seats[seating::index(turn)] &&
+                                        player_turn == turn)
+                                    {
+                                        play_bot_card(turn);
+                                        b_received_card = true;
+                                    }
+                                    memory_mutex.unlock();
                                 }
                             }
                             else
@@ -467,44 +847,83 @@ int16_t Serwer::run_deal(int16_t trick_type, const string& seat)
                     }
                 }
             }
+            if (!game_log_path.empty())
+            {
+                memory_mutex.lock();
+                string card = cards_on_table.back();
+                memory_mutex.unlock();
+                game_log.log_play(turn, card);
+            }
         }
+        first_card = 0;
 
         // Got four cards.
+        tracing::Span points_span("points", i + 1);
         memory_mutex.lock();
-        string queue;
         PointsCalculator calculator(cards_on_table,
-            seats[beginning], trick_type, i + 1);
-        pair<string, int32_t> result = calculator.calculate_points();
+            beginning, trick_type, i + 1);
+        pair<Seat, int32_t> result = calculator.calculate_points();
         last_taker = result.first;
-        scores[result.first] += result.second;
-        taken_tricks.push_back({cards_on_table});
+        scores[seating::index(result.first)] += result.second;
+        taken_tricks.emplace_back(cards_on_table.begin(),
+            cards_on_table.end());
         taken_takers.push_back(result.first);
+        uint64_t last_card_loc = last_card_at;
+        reclaim_bot_seats();
+        // The taker leads the next trick; on a bot table it gets its TRICK
+        // right away, together with the TAKEN.
+        b_is_pipelined = b_is_fast_table && i < 12 &&
+            !bot_seats[seating::index(result.first)];
+        if (b_is_pipelined)
+        {
+            cards_on_table.clear();
+            ++trick_number;
+            player_turn = result.first;
+        }
+        bool b_needs_barrier = !b_is_fast_table || b_is_barrier_ongoing;
         memory_mutex.unlock();
+        if (!game_log_path.empty())
+        {
+            game_log.log_trick_end(result.first, result.second);
+        }
+        points_span.end();
+        tracing::Span notify_span("notify_taken", i + 1);
         for (int16_t i = 0; i < 4; ++i)
         {
-            ssize_t pipe_write = common::write_to_pipe
-                (server_write_pipes[i][1], TAKEN);
-            if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+            bool b_leads = b_is_pipelined &&
+                (size_t)i == seating::index(result.first);
+            if (notify_seat(i, b_leads ? TAKEN_AND_TRICK : TAKEN) < 0)
+            {
+                return -1;
+            }
         }
+        notify_span.end();
+        // Once per trick; the seat threads only write what they are given.
+        metrics::record_since(metrics::Latency::CARD_TO_TAKEN, last_card_loc);
 
         // Barrier.
-        if (barrier() < 0) {return -1;}
+        if (b_needs_barrier && barrier() < 0) {return -1;}
     }
 
     // End of the deal.
     memory_mutex.lock();
-    for (const auto& [key, value] : scores) { total_scores[key] += value; }
-    for (const auto& [key, value] : scores) { round_scores[key] = value; }
+    for (size_t i = 0; i < 4; ++i) { total_scores[i] += scores[i]; }
+    round_scores = scores;
+    array<int32_t, 4> total_scores_loc{total_scores};
+    reclaim_bot_seats();
     memory_mutex.unlock();
+    ++deals_finished;
+    if (!game_log_path.empty())
+    {
+        game_log.snapshot(deals_finished, total_scores_loc);
+    }
     for (int16_t i = 0; i < 4; ++i)
     {
-        string message = SCORES;
-        ssize_t pipe_write = common::write_to_pipe
-            (server_write_pipes[i][1], message.data());
-        if (assert_server_write_pipe(pipe_write) < 0) {return -1;}
+        if (notify_seat(i, SCORES) < 0) {return -1;}
     }
 
     if (barrier() < 0) {return -1;}
+    metrics::record_since(metrics::Latency::DEAL_DURATION, started_at);
     return 0;
 }
 
@@ -512,30 +931,32 @@ int16_t Serwer::run_game()
 {
     // Here we should have all 4 clients.
     FileReader fr(game_file_name);
+    // Deals finished before a restart are skipped.
+    for (uint64_t i = 0; i < deals_finished; ++i)
+    {
+        if (fr.read_next_deal() <= 0) {break;}
+    }
     // First operation after being waken up should run normally.
     while (fr.read_next_deal() > 0) 
     {
         int16_t trick_type = fr.get_trick_type();
-        string starting_seat = fr.get_seat();
-        array<string, 4> raw_cards = fr.get_cards();
-        memory_mutex.lock();
-        deal_starter = starting_seat;
-        taken_tricks.clear();
-        taken_takers.clear();
-        for (int16_t i = 0; i < 4; ++i) 
-        { 
-            cards[i] = regex::extract_cards(raw_cards[i]); 
-            deal[i] = regex::extract_cards(raw_cards[i]);
+        Seat starting_seat = seating::from_char(fr.get_seat()[0]);
+        if (run_deal(trick_type, starting_seat, fr.get_cards(),
+            b_is_deal_resumed) < 0)
+        {
+            return 1;
         }
-        memory_mutex.unlock();
-        if (run_deal(trick_type, starting_seat) < 0) {return 1;}
+        b_is_deal_resumed = false;
     }
 
+    // The game is over, there is nothing to resume.
+    if (!game_log_path.empty()) {game_log.finish();}
     return close_server();
 }
 
 void Serwer::handle_connections()
 {
+    tracing::set_thread_name("connections");
     // Create a socket.
     int32_t socket_fd = common::setup_server_socket
         (port, QUEUE_SIZE, server_address);
@@ -566,7 +987,7 @@ void Serwer::handle_connections()
         {
             // Poll failed (we don't expect timeout here).
             close_thread("Failed to poll.", {socket_fd},
-                CONNECTIONS_THREAD, false);
+                Seat::K, false);
             return;
         }
         else
@@ -577,25 +998,31 @@ void Serwer::handle_connections()
                 struct sockaddr_in6 client_address;
                 int32_t client_fd = common::accept_client
                     (socket_fd, client_address);
+                uint64_t accepted_at = metrics::now();
                 if (client_fd < 0) 
                 {
                     close_thread("Failed to accept connection.",
-                        {socket_fd}, CONNECTIONS_THREAD, false);
+                        {socket_fd}, Seat::K, false);
                 }
                 else
                 {
                     memory_mutex.lock();
+                    if (!journal_path.empty())
+                    {
+                        journal_writer.record_accept(thread_id);
+                    }
                     try 
                     {
                         thread client_thread(&Serwer::handle_client,
-                            this, client_fd, client_address, thread_id);
+                            this, client_fd, client_address, thread_id,
+                            accepted_at);
                         client_threads[thread_id] = move(client_thread); 
                     }
                     catch (const system_error& e) 
                     {
                         memory_mutex.unlock();
                         close_thread(e.what(), {socket_fd, client_fd},
-                            CONNECTIONS_THREAD, false);
+                            Seat::K, false);
                         return;
                     }
                     ++thread_id;
@@ -605,7 +1032,7 @@ void Serwer::handle_connections()
             else if (poll_descriptors[0].revents & POLLERR)
             {
                 close_thread("Poll error on server socket.", {socket_fd},
-                    CONNECTIONS_THREAD, false);
+                    Seat::K, false);
                 return;
             }
 
@@ -616,7 +1043,7 @@ void Serwer::handle_connections()
                 ssize_t pipe_read = common::read_from_pipe
                     (server_write_pipes[4][0], server_message);
                 if (assert_client_read_pipe(pipe_read, {socket_fd},
-                    CONNECTIONS_THREAD, false) < 0) { return; }
+                    Seat::K, false) < 0) { return; }
                 if (server_message == DISCONNECTED || server_message == END)
                 {
                     // Server wants to close the connection.
@@ -633,19 +1060,18 @@ void Serwer::handle_connections()
             else if (poll_descriptors[1].revents & POLLERR)
             {
                 close_thread("Poll error on server pipe.", {socket_fd},
-                    CONNECTIONS_THREAD, false);
+                    Seat::K, false);
                 return;
             }
         }
     }
 }
 
-int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
+int16_t Serwer::reserve_spot(int32_t client_fd, Seat& seat,
     const struct sockaddr_in6& client_addr, bool& b_is_my_turn,
-    bool& b_is_barrier)
+    bool& b_is_barrier, uint64_t accepted_at, string& message)
 {
     // Read the message from the client.
-    string message;
     struct timeval timeout_val;
 
     timeout_val.tv_sec = timeout / 1000;
@@ -658,9 +1084,14 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
         return -1;
     }
     ssize_t socket_read = common::read_from_socket(client_fd, message);
+    if (socket_read > 0 && !journal_path.empty())
+    {
+        journal_writer.record_data(message);
+    }
     common::print_log(client_addr, server_address, message, print_mutex);
     if (assert_client_read_socket(socket_read, {client_fd},
         seat, false) < 0) {return -1;}
+    metrics::increment(metrics::Counter::MESSAGES_RECEIVED);
 
     // Turn off the timeout.
     timeout_val.tv_sec = 0;
@@ -672,30 +1103,59 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
         return -1;
     }
     
-    if (regex::IAM_check(message))
+    if (regex::MUX_check(message))
+    {
+        // Seats are taken on the channels of the connection.
+        return 2;
+    }
+    else if (regex::IAM_check(message))
     {
-        seat = message.substr(3, 1);
+        metrics::record_since(metrics::Latency::ACCEPT_TO_IAM, accepted_at);
+        seat = seating::from_char(message[3]);
+        // Everything the server sends to a BIN player is a frame.
+        string frame;
+        string* frame_ptr = regex::has_capability(message, "BIN") ?
+            &frame : nullptr;
         memory_mutex.lock();
-        if (seats_status[seat] == -1) 
+        if (seats_status[seating::index(seat)] == -1) 
         {
-            seats_status[seat] = client_fd;
-            array<vector<string>, 4> deal_loc{deal};
+            seats_status[seating::index(seat)] = client_fd;
+            bool b_is_bot = regex::has_capability(message, "BOT");
+            bot_capable[seating::index(seat)] = b_is_bot;
+            pre_capable[seating::index(seat)] =
+                regex::has_capability(message, "PRE");
+            pre_commits[seating::index(seat)].b_is_valid = false;
+            binary_seats[seating::index(seat)] = frame_ptr != nullptr;
+            if (b_is_bot || b_is_bot_table)
+            {
+                // Bots answer at once, small writes must not wait.
+                int32_t flag = 1;
+                setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag,
+                    sizeof(flag));
+            }
+            bool b_is_deal_ongoing = !deal[0].empty();
+            vector<string> hand_loc(deal[seating::index(seat)].begin(),
+                deal[seating::index(seat)].end());
             int16_t trick_type_loc = trick_type_global;
-            string deal_starter_loc = deal_starter;
-            string last_taker_loc = last_taker;
+            Seat deal_starter_loc = deal_starter;
 
             memory_mutex.unlock();
 
             // Send data from the game.
             string msg;
-            if (deal_loc[0].size() != 0)
+            if (b_is_deal_ongoing)
             {
+                metrics::increment(metrics::Counter::RECONNECTS);
                 socket_read = senders::send_deal(client_fd, trick_type_loc,
-                    deal_starter_loc, deal[seats_to_array[seat]] , msg);
+                    deal_starter_loc, hand_loc, msg, frame_ptr);
                 common::print_log(server_address,
                     client_addr, msg, print_mutex);
-                if (assert_client_write_socket(socket_read, msg.size(), 
-                    {client_fd}, seat, false) < 0) {return -1;}
+                if (assert_client_write_socket(socket_read,
+                    senders::wire_size(msg, frame_ptr),
+                    {client_fd}, seat, false) < 0)
+                {
+                    return -1;
+                }
                 memory_mutex.lock();
                 auto trick_iter = taken_tricks.begin();
                 auto taker_iter = taken_takers.begin();
@@ -704,11 +1164,15 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
                 {
                     memory_mutex.unlock();
                     socket_read = senders::send_taken(client_fd, i + 1,
-                        *trick_iter, *taker_iter, msg);
+                        *trick_iter, *taker_iter, msg, frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_read, msg.size(),
-                         {client_fd}, seat, false) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_read,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, false) < 0)
+                    {
+                        return -1;
+                    }
                     memory_mutex.lock();
                     ++trick_iter;
                     ++taker_iter;
@@ -717,14 +1181,20 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
                 {
                     b_is_my_turn = true;
                     int trick_nr_loc = trick_number;
-                    vector<string> cards_on_table_loc{cards_on_table};
+                    array<string, 4> table_loc;
+                    size_t table_size = copy_cards_on_table(table_loc);
                     memory_mutex.unlock();
+                    trick_sent_at[seating::index(seat)] = metrics::now();
                     socket_read = senders::send_trick(client_fd, trick_nr_loc,
-                        cards_on_table_loc, msg);
+                        {table_loc.data(), table_size}, msg, frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_read, msg.size(),
-                         {client_fd}, seat, false) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_read,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, false) < 0)
+                    {
+                        return -1;
+                    }
                 }
                 else {memory_mutex.unlock();}
             }
@@ -732,17 +1202,24 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
         else
         {
             string occupied_seats;
-            for (auto& [key, value] : seats_status)
+            for (Seat taken : seating::ALL_SEATS)
             {
-                if (value != -1) {occupied_seats += key;}
+                if (seats_status[seating::index(taken)] != -1)
+                {
+                    occupied_seats += seating::to_char(taken);
+                }
             }
             memory_mutex.unlock();
             string msg;
             ssize_t socket_write = senders::send_busy(client_fd,
-                occupied_seats, msg);
+                occupied_seats, msg, frame_ptr);
             common::print_log(server_address, client_addr, msg, print_mutex);
-            if (assert_client_write_socket(socket_write, msg.size(),
-                {client_fd}, seat, false) < 0) { return -1; }
+            if (assert_client_write_socket(socket_write,
+                senders::wire_size(msg, frame_ptr),
+                {client_fd}, seat, false) < 0)
+            {
+                return -1;
+            }
             else 
             {
                 close_fds({client_fd});
@@ -764,98 +1241,180 @@ int16_t Serwer::reserve_spot(int32_t client_fd, string& seat,
     return 1;
 }
 
-int16_t Serwer::parse_message(string& message, int32_t client_fd,
-    const string& seat, const struct sockaddr_in6& client_addr,
+ParsedMessage Serwer::extract_message(const string& message)
+{
+    ParsedMessage parsed{false, -1, {}};
+    if (!regex::TRICK_client_check(message)) { return parsed; }
+
+    // Card is at the end, before the delimeter; "10" is the only
+    // two-character figure and the only one that ends with '0'.
+    size_t card_end = message.size() - 2;
+    size_t card_begin = card_end - 2;
+    if (message[card_end - 2] == '0') { card_begin = card_end - 3; }
+    parsed.trick_number = stoi(message.substr(5, card_begin - 5));
+    message.copy(parsed.card, card_end - card_begin, card_begin);
+    parsed.card[card_end - card_begin] = '\0';
+    parsed.b_is_valid = true;
+    return parsed;
+}
+
+bool Serwer::play_card(Seat seat, const string& card)
+{
+    cards_t& hand = cards[seating::index(seat)];
+    auto received_card = find(hand.begin(), hand.end(), card);
+    if (received_card == hand.end()) { return false; }
+    if (cards_on_table.size() > 0)
+    {
+        char main_color = cards_on_table[0][cards_on_table[0].size() - 1];
+        if (main_color != card[card.size() - 1])
+        {
+            // Didn't play the right color. Check if he had it.
+            for (const string& held : hand)
+            {
+                if (held[held.size() - 1] == main_color) { return false; }
+            }
+        }
+    }
+
+    hand.erase(received_card);
+    cards_on_table.push_back(card);
+    player_turn = Seat::NONE;
+    last_card_at = metrics::now();
+    return true;
+}
+
+int16_t Serwer::report_card(const initializer_list<int32_t>& fds, Seat seat)
+{
+    memory_mutex.lock();
+    uint64_t last_card_loc = last_card_at;
+    memory_mutex.unlock();
+    uint64_t sent_at = trick_sent_at[seating::index(seat)];
+    // Clamped as in metrics::record_since.
+    metrics::record(static_cast<metrics::Latency>(static_cast
+        <size_t>(metrics::Latency::TRICK_TO_CARD_N) +
+        seating::index(seat)),
+        last_card_loc > sent_at ? last_card_loc - sent_at : 0);
+    // Notify server that the client played a card.
+    ssize_t pipe_write = common::write_to_pipe(server_read_pipes
+        [seating::index(seat)][1], CARD_PLAY);
+    return assert_client_write_pipe(pipe_write, fds, seat, true);
+}
+
+int16_t Serwer::play_pre_commit(const initializer_list<int32_t>& fds,
+    Seat seat, int16_t current_trick)
+{
+    ParsedMessage& pre_commit = pre_commits[seating::index(seat)];
+    // A card for a later trick waits for its turn.
+    if (!pre_commit.b_is_valid || pre_commit.trick_number > current_trick)
+    {
+        return 0;
+    }
+    pre_commit.b_is_valid = false;
+    if (pre_commit.trick_number < current_trick)
+    {
+        metrics::increment(metrics::Counter::PRE_COMMIT_MISSES);
+        return 0;
+    }
+
+    // The turn starts now, before play_card stamps the card; a TRICK
+    // sent instead stamps it again.
+    trick_sent_at[seating::index(seat)] = metrics::now();
+    memory_mutex.lock();
+    bool b_was_played = trick_number == current_trick &&
+        play_card(seat, pre_commit.card);
+    memory_mutex.unlock();
+    if (!b_was_played)
+    {
+        // Not legal any more; the player gets a normal TRICK.
+        metrics::increment(metrics::Counter::PRE_COMMIT_MISSES);
+        return 0;
+    }
+    metrics::increment(metrics::Counter::PRE_COMMITS);
+    if (report_card(fds, seat) < 0) { return -1; }
+    return 1;
+}
+
+ParsedMessage Serwer::extract_frame(const string& frame, string& message)
+{
+    ParsedMessage parsed{false, -1, {}};
+    parsed.b_is_valid = frames::decode_trick(frame, parsed.trick_number,
+        parsed.card);
+    if (!parsed.b_is_valid)
+    {
+        message.assign("(invalid frame)\r\n");
+        return parsed;
+    }
+    message.assign("TRICK");
+    message += std::to_string(parsed.trick_number);
+    message += parsed.card;
+    message += DELIMETER;
+    return parsed;
+}
+
+int16_t Serwer::parse_message(const ParsedMessage& parsed, int32_t client_fd,
+    Seat seat, const struct sockaddr_in6& client_addr,
     bool& b_was_destined_to_play, int16_t current_trick,
     int32_t& timeout_copy)
 {
+    TRACE_SPAN("parse_message", current_trick, seating::to_char(seat));
     ssize_t socket_write = -1;
-    ssize_t pipe_write = -1;
-    common::print_log(client_addr, server_address, message, print_mutex);
-    if (regex::TRICK_client_check(message))
+    string frame;
+    string* frame_ptr = binary_seats[seating::index(seat)] ? &frame : nullptr;
+    if (parsed.b_is_valid)
     {
         if (b_was_destined_to_play)
         {
-            // Set current message;
             memory_mutex.lock();
             timeout_copy = timeout;
-            int16_t extracted_trick = -1;
-            if (current_trick < 10) 
-            {
-                extracted_trick = stoi(message.substr(5, 1));
-                message = message.substr(6, message.size() - 8);
-            }
-            else 
-            {
-                extracted_trick = stoi(message.substr(5, 2));
-                message = message.substr(7, message.size() - 9);
-            }
-            // Check if the client has the card.
-            auto received_card = find(cards[seats_to_array[seat]]
-                .begin(), cards[seats_to_array[seat]].end(), message);
-            bool b_played_right_color = (extracted_trick == current_trick);
-            if(cards_on_table.size() > 0 && b_played_right_color)
-            {
-                char main_color = cards_on_table[0]
-                    [cards_on_table[0].size() - 1];
-                b_played_right_color = (main_color == 
-                    message[message.size() - 1]);
-                if (!b_played_right_color) 
-                {
-                    b_played_right_color = true;
-                    // Didn't play the right color. Check if he had it.
-                    for (const string& card : cards[seats_to_array[seat]])
-                    {
-                        if (card[card.size() - 1] == main_color)
-                        {
-                            b_played_right_color = false;
-                            break;
-                        }
-                    }
-                }
-            }
+            bool b_was_played = parsed.trick_number == current_trick &&
+                play_card(seat, parsed.card);
+            memory_mutex.unlock();
 
-            if (received_card == cards[seats_to_array[seat]].end() ||
-                !b_played_right_color)
+            if (!b_was_played)
             {
-                memory_mutex.unlock();
                 // Client send something he didn't have; send back wrong.
+                metrics::increment(metrics::Counter::WRONGS);
                 string msg;
                 socket_write = senders::send_wrong(client_fd,
-                    current_trick, msg);
+                    current_trick, msg, frame_ptr);
                 common::print_log(server_address,
                     client_addr, msg, print_mutex);
-                if (assert_client_write_socket(socket_write, msg.size(),
-                    {client_fd}, seat, true) < 0) {return -1;}
+                if (assert_client_write_socket(socket_write,
+                    senders::wire_size(msg, frame_ptr),
+                    {client_fd}, seat, true) < 0)
+                {
+                    return -1;
+                }
             }
             else
             {
                 // We received a valid card. Noice.
-                cards[seats_to_array[seat]].erase(received_card);
-                cards_on_table.push_back(message);
-
-                /* I had a strange warning on student's server
-                 * regarding giant offsets of the built-in memcpy.
-                 * This is a solution that is not producing a warning.
-                */
-                player_turn = string("x");
-                memory_mutex.unlock();
-                // Notify server that the client played a card.
-                pipe_write = common::write_to_pipe(server_read_pipes
-                    [seats_to_array[seat]][1], CARD_PLAY);
-                if (assert_client_write_pipe(pipe_write, {client_fd},
-                    seat, true) < 0) {return -1;}
+                if (report_card({client_fd}, seat) < 0) {return -1;}
                 b_was_destined_to_play = false;
             }
         }
+        else if (pre_capable[seating::index(seat)] &&
+            (parsed.trick_number == current_trick ||
+            parsed.trick_number == current_trick + 1))
+        {
+            // Card for the upcoming turn of the seat, the last one sent
+            // counts. It is checked when the turn comes.
+            pre_commits[seating::index(seat)] = parsed;
+        }
         else
         {
             // Client send a message out of order.
+            metrics::increment(metrics::Counter::WRONGS);
             string msg;
-            socket_write = senders::send_wrong(client_fd, current_trick, msg);
+            socket_write = senders::send_wrong(client_fd, current_trick, msg,
+                frame_ptr);
             common::print_log(server_address, client_addr, msg, print_mutex);
-            if (assert_client_write_socket(socket_write, msg.size(),
-                {client_fd}, seat, true) < 0) {return -1;}
+            if (assert_client_write_socket(socket_write,
+                senders::wire_size(msg, frame_ptr),
+                {client_fd}, seat, true) < 0)
+            {
+                return -1;
+            }
         }
         
     }
@@ -869,7 +1428,7 @@ int16_t Serwer::parse_message(string& message, int32_t client_fd,
     return 0;
 }
 
-int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
+int16_t Serwer::client_poll(int32_t client_fd, Seat seat,
     const struct sockaddr_in6& client_addr, bool b_is_my_turn,
     bool b_is_barrier)
 {
@@ -880,12 +1439,27 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
     std::array<struct pollfd, 2> poll_descriptors{};
     poll_descriptors[0].fd = client_fd;
     poll_descriptors[0].events = POLLIN;
-    poll_descriptors[1].fd = server_write_pipes[seats_to_array[seat]][0];
+    poll_descriptors[1].fd = server_write_pipes[seating::index(seat)][0];
     poll_descriptors[1].events = POLLIN;
     int32_t timeout_copy = timeout;
 
     bool b_was_destined_to_play = false;
     if (b_is_my_turn) {b_was_destined_to_play = true;}
+    bool b_was_queue_overflowed = false;
+
+    // Buffers reused by every message, so they allocate only once.
+    string msg;
+    msg.reserve(MAX_BUFFER_SIZE);
+    string client_message;
+    client_message.reserve(MAX_BUFFER_SIZE + 1);
+    array<string, 4> table_loc;
+    array<string, 13> hand_loc;
+    string trick_msg;
+    trick_msg.reserve(MAX_BUFFER_SIZE);
+    // Set for a BIN player, messages go as frames built here.
+    string frame;
+    frame.reserve(2 * MAX_FRAME_SIZE);
+    string* frame_ptr = binary_seats[seating::index(seat)] ? &frame : nullptr;
 
     // Read messages from the client.
     for(;;)
@@ -897,23 +1471,26 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
         memory_mutex.lock();
         int16_t current_trick = trick_number;
         if ( b_is_barrier_ongoing) { b_is_barrier = true; }
+        // Bots do not lose messages, a TRICK is never resent to them.
+        bool b_has_timer = b_was_destined_to_play && !b_is_fast_table;
         memory_mutex.unlock();
         if (!b_is_barrier)
         {
-            while (barrier_messages[seats_to_array[seat]].size() > 0)
+            while (!barrier_messages[seating::index(seat)].empty())
             {
-                string message{ barrier_messages
-                    [seats_to_array[seat]].front() };
-                barrier_messages[seats_to_array[seat]].pop();
+                ParsedMessage message{ barrier_messages
+                    [seating::index(seat)].front() };
+                barrier_messages[seating::index(seat)].pop();
                 if (parse_message(message, client_fd, seat, client_addr,
                     b_was_destined_to_play, current_trick,
                     timeout_copy) < 0) {return -1;}
             }
+            b_was_queue_overflowed = false;
         }
 
         int32_t poll_result = -1;
         struct timeval start, end;
-        if (!b_was_destined_to_play)
+        if (!b_has_timer)
         {
             poll_result = poll(&poll_descriptors[0], 2, -1);
         }
@@ -922,22 +1499,27 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
             gettimeofday(&start, NULL);
             poll_result = poll(&poll_descriptors[0], 2, timeout_copy);
         }
-        if (poll_result == 0 && b_was_destined_to_play)
+        if (poll_result == 0 && b_has_timer)
         { // Timeout.
             if (!b_is_barrier)
             {
-                string msg;
                 memory_mutex.lock();
-                vector<string> cards_on_table_loc{cards_on_table};
+                size_t table_size = copy_cards_on_table(table_loc);
                 timeout_copy = timeout;
                 memory_mutex.unlock();
+                metrics::increment(metrics::Counter::RESENDS);
                 socket_write = senders::send_trick(client_fd,
-                    current_trick, cards_on_table_loc, msg);
+                    current_trick, {table_loc.data(), table_size}, msg,
+                    frame_ptr);
                 common::print_log(server_address,
                     client_addr, msg, print_mutex);
-                if (assert_client_write_socket(socket_write, msg.size(),
-                    {client_fd}, seat, true) < 0) {return -1;}
-            }
+                if (assert_client_write_socket(socket_write,
+                    senders::wire_size(msg, frame_ptr),
+                    {client_fd}, seat, true) < 0)
+                {
+                    return -1;
+                }
+            }
         }
         else if (poll_result <= 0)
         {
@@ -949,19 +1531,57 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
             gettimeofday(&end, NULL);
             if (poll_descriptors[0].revents & POLLIN)
             { // Client sent a message.
-                string client_message;
-                socket_read = common::read_from_socket
-                    (client_fd, client_message);
+                ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::RECEIVE);
+                TRACE_SPAN("receive", current_trick, seating::to_char(seat));
+                client_message.clear();
+                if (frame_ptr != nullptr)
+                {
+                    socket_read = frames::read_frame(client_fd,
+                        client_message);
+                }
+                else
+                {
+                    socket_read = common::read_from_socket(client_fd,
+                        client_message);
+                }
+                if (socket_read > 0 && !journal_path.empty())
+                {
+                    journal_writer.record_data(client_message);
+                }
                 if (assert_client_read_socket(socket_read,
                     {client_fd}, seat, true) < 0) {return -1;}
+                metrics::increment(metrics::Counter::MESSAGES_RECEIVED);
+                ParsedMessage parsed{};
+                if (frame_ptr != nullptr)
+                {
+                    // The frame is logged as the text it stands for.
+                    parsed = extract_frame(client_message, msg);
+                    common::print_log(client_addr, server_address,
+                        msg, print_mutex);
+                }
+                else
+                {
+                    common::print_log(client_addr, server_address,
+                        client_message, print_mutex);
+                    parsed = extract_message(client_message);
+                }
                 if (b_is_barrier)
                 {
                     memory_mutex.lock();
-                    barrier_messages[seats_to_array[seat]]
-                        .push(client_message);
+                    bool b_was_pushed = barrier_messages
+                        [seating::index(seat)].push(parsed);
                     memory_mutex.unlock();
+                    // Overflow policy: keep the oldest messages, drop
+                    // the new one and report it once per barrier.
+                    if (!b_was_pushed && !b_was_queue_overflowed)
+                    {
+                        common::print_error(string("Barrier queue of ") +
+                            seating::to_char(seat) +
+                            " is full, dropping messages.", print_mutex);
+                        b_was_queue_overflowed = true;
+                    }
                 }
-                else if (parse_message(client_message, client_fd, seat,
+                else if (parse_message(parsed, client_fd, seat,
                     client_addr, b_was_destined_to_play, current_trick,
                     timeout_copy) < 0) {return -1;}
             }
@@ -971,7 +1591,7 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                     seat, true);
                 return -1;
             }
-            else if (b_was_destined_to_play)
+            else if (b_has_timer)
             {
                 // Update timeout; if <= 0, resend a request for a card.
                 int32_t passed_ms = (end.tv_sec - start.tv_sec) * 1000 +
@@ -979,17 +1599,22 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                 timeout_copy -= passed_ms;
                 if (timeout_copy <= 0)
                 {
-                    string msg;
                     memory_mutex.lock();
-                    vector<string> cards_on_table_loc{cards_on_table};
+                    size_t table_size = copy_cards_on_table(table_loc);
                     timeout_copy = timeout;
                     memory_mutex.unlock();
-                    socket_write = senders::send_trick
-                        (client_fd, current_trick, cards_on_table_loc, msg);
+                    metrics::increment(metrics::Counter::RESENDS);
+                    socket_write = senders::send_trick(client_fd,
+                        current_trick, {table_loc.data(), table_size}, msg,
+                        frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_write,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
                 }
             }
             
@@ -1004,34 +1629,57 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                 if (server_message == CARD_PLAY)
                 {
                     // Server wants the client to play a card.
-                    string msg;
                     memory_mutex.lock();
-                    vector<string> cards_on_table_loc{cards_on_table};
+                    size_t table_size = copy_cards_on_table(table_loc);
                     current_trick = trick_number;
                     memory_mutex.unlock();
-                    socket_write = senders::send_trick(client_fd,
-                        current_trick, cards_on_table_loc, msg);
-                    common::print_log(server_address,
-                        client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
-                    b_was_destined_to_play = true;
+                    int16_t pre_result = play_pre_commit({client_fd}, seat,
+                        current_trick);
+                    if (pre_result < 0) {return -1;}
+                    // No TRICK if the card sent ahead was played.
+                    b_was_destined_to_play = pre_result == 0;
+                    if (b_was_destined_to_play)
+                    {
+                        TRACE_SPAN("send_trick", current_trick,
+                            seating::to_char(seat));
+                        trick_sent_at[seating::index(seat)] = metrics::now();
+                        socket_write = senders::send_trick(client_fd,
+                            current_trick, {table_loc.data(), table_size},
+                            msg, frame_ptr);
+                        common::print_log(server_address,
+                            client_addr, msg, print_mutex);
+                        if (assert_client_write_socket(socket_write,
+                            senders::wire_size(msg, frame_ptr),
+                            {client_fd}, seat, true) < 0)
+                        {
+                            return -1;
+                        }
+                    }
                 }
                 else if(server_message == DEAL)
                 {
                     // Server wants the client to play a deal.
-                    string msg;
+                    TRACE_SPAN("send_deal", -1, seating::to_char(seat));
+                    // Cards sent ahead belong to the previous deal.
+                    pre_commits[seating::index(seat)].b_is_valid = false;
                     memory_mutex.lock();
-                    vector<string> cards_loc{cards[seats_to_array[seat]]};
-                    string seat_loc = last_taker;
+                    const cards_t& hand = cards[seating::index(seat)];
+                    size_t hand_size = std::min(hand.size(), hand_loc.size());
+                    std::copy_n(hand.begin(), hand_size, hand_loc.begin());
+                    Seat seat_loc = last_taker;
                     int16_t trick_loc = trick_type_global;
                     memory_mutex.unlock();
                     socket_write = senders::send_deal(client_fd, trick_loc,
-                        seat_loc, cards_loc, msg);
+                        seat_loc, {hand_loc.data(), hand_size}, msg,
+                        frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_write,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
                 }
                 else if (server_message == DISCONNECTED)
                 {
@@ -1039,44 +1687,105 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                     close_thread("", {client_fd}, seat, true, true);
                     return 0;
                 }
+                else if ((server_message == TAKEN ||
+                    server_message == TAKEN_AND_TRICK) &&
+                    !has_taken_trick())
+                {
+                    // Left in the pipe of a vacant seat before the deal
+                    // was reset; the player caught up in reserve_spot.
+                }
                 else if (server_message == TAKEN)
                 {
                     // Server wants the client to send "TAKEN".
+                    TRACE_SPAN("send_taken", current_trick,
+                        seating::to_char(seat));
+                    // On a bot table the next trick may have started,
+                    // the taken trick is the last one stored.
                     memory_mutex.lock();
-                    string taker_loc{last_taker};
-                    vector<string> cards_on_table_loc{cards_on_table};
+                    Seat taker_loc{taken_takers.back()};
+                    int16_t taken_loc = taken_tricks.size();
+                    const cards_t& taken_cards = taken_tricks.back();
+                    size_t table_size = std::min(taken_cards.size(),
+                        table_loc.size());
+                    std::copy_n(taken_cards.begin(), table_size,
+                        table_loc.begin());
                     memory_mutex.unlock();
-                    string msg;
                     socket_write = senders::send_taken(client_fd,
-                        current_trick, cards_on_table_loc, taker_loc, msg);
+                        taken_loc, {table_loc.data(), table_size},
+                        taker_loc, msg, frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_write,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
+                }
+                else if (server_message == TAKEN_AND_TRICK)
+                {
+                    // Bot table: this seat took the trick and leads the
+                    // next one, nobody has played in it yet.
+                    TRACE_SPAN("send_taken", current_trick,
+                        seating::to_char(seat));
+                    memory_mutex.lock();
+                    const cards_t& taken_cards = taken_tricks.back();
+                    size_t taken_size = std::min(taken_cards.size(),
+                        table_loc.size());
+                    std::copy_n(taken_cards.begin(), taken_size,
+                        table_loc.begin());
+                    int16_t taken_loc = taken_tricks.size();
+                    current_trick = trick_number;
+                    memory_mutex.unlock();
+                    trick_sent_at[seating::index(seat)] = metrics::now();
+                    socket_write = senders::send_taken_and_trick(client_fd,
+                        taken_loc, {table_loc.data(), taken_size}, seat, {},
+                        msg, trick_msg, frame_ptr);
+                    common::print_log(server_address,
+                        client_addr, msg, print_mutex);
+                    common::print_log(server_address,
+                        client_addr, trick_msg, print_mutex);
+                    size_t written_loc = frame_ptr != nullptr ?
+                        frame.size() : msg.size() + trick_msg.size();
+                    if (assert_client_write_socket(socket_write,
+                        written_loc, {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
+                    metrics::increment(metrics::Counter::MESSAGES_SENT);
+                    b_was_destined_to_play = true;
                 }
                 else if(server_message == SCORES)
                 {
                     memory_mutex.lock();
-                    map<string, int32_t> round_scores_loc{round_scores};
-                    map<string, int32_t> total_scores_loc{total_scores};
+                    TRACE_SPAN("send_score", -1, seating::to_char(seat));
+                    array<int32_t, 4> round_scores_loc{round_scores};
+                    array<int32_t, 4> total_scores_loc{total_scores};
                     memory_mutex.unlock();
 
-                    string msg;
                     // Score.
                     socket_write = senders::send_score(client_fd,
-                        round_scores_loc, msg);
+                        round_scores_loc, msg, frame_ptr);
                     common::print_log(server_address,
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_write,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
 
                     // Total score.
                     socket_write = senders::send_total(client_fd,
-                        total_scores_loc, msg);
+                        total_scores_loc, msg, frame_ptr);
                     common::print_log(server_address, 
                         client_addr, msg, print_mutex);
-                    if (assert_client_write_socket(socket_write, msg.size(),
-                        {client_fd}, seat, true) < 0) {return -1;}
+                    if (assert_client_write_socket(socket_write,
+                        senders::wire_size(msg, frame_ptr),
+                        {client_fd}, seat, true) < 0)
+                    {
+                        return -1;
+                    }
                 }
                 else if (server_message == BARRIER_RESPONSE)
                 {
@@ -1089,7 +1798,7 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                     if (local_occ == 4)
                     {
                         pipe_write = common::write_to_pipe
-                            (server_read_pipes[seats_to_array[seat]][1],
+                            (server_read_pipes[seating::index(seat)][1],
                             BARRIER_RESPONSE);
                         if (assert_client_write_pipe(pipe_write, {client_fd},
                             seat, true) < 0) {return -1;}
@@ -1098,11 +1807,12 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
                 else if (server_message == BARRIER_END)
                 {
                     b_is_barrier = false;
-                    while (barrier_messages[seats_to_array[seat]].size() > 0)
+                    b_was_queue_overflowed = false;
+                    while (!barrier_messages[seating::index(seat)].empty())
                     {
-                        string message{ barrier_messages
-                            [seats_to_array[seat]].front() };
-                        barrier_messages[seats_to_array[seat]].pop();
+                        ParsedMessage message{ barrier_messages
+                            [seating::index(seat)].front() };
+                        barrier_messages[seating::index(seat)].pop();
                         if (parse_message(message, client_fd, seat,
                             client_addr, b_was_destined_to_play, current_trick,
                             timeout_copy) < 0) {return -1;}
@@ -1128,20 +1838,648 @@ int16_t Serwer::client_poll(int32_t client_fd, const string& seat,
     return 1;
 }
 
+
 void Serwer::handle_client(int32_t client_fd,
-    struct sockaddr_in6 client_addr, uint64_t thread_id)
+    struct sockaddr_in6 client_addr, uint64_t thread_id, uint64_t accepted_at)
 {
-    string seat;
+    Seat seat = Seat::NONE;
     bool b_is_my_turn = false;
     bool b_is_barrier = false;
+    string message;
+    tracing::set_thread_name("client");
+    journal::bind_connection(thread_id);
     // Reserve a spot at the table.
-    if (reserve_spot(client_fd, seat, client_addr,
-        b_is_my_turn, b_is_barrier) > 0) 
+    int16_t result = reserve_spot(client_fd, seat, client_addr,
+        b_is_my_turn, b_is_barrier, accepted_at, message);
+    if (result == 1) 
     {   
+        tracing::set_thread_name("client", seating::to_char(seat));
         client_poll(client_fd, seat, client_addr,
             b_is_my_turn, b_is_barrier);
     }
+    else if (result == 2)
+    {
+        serve_channels(client_fd, client_addr, message, accepted_at);
+    }
+    if (!journal_path.empty()) { journal_writer.record_close(); }
     memory_mutex.lock();
     joinable_threads.push_back(thread_id);
     memory_mutex.unlock();
-}
\ No newline at end of file
+}
+
+void Serwer::queue_message(uint8_t id, const string& message,
+    const string* frame, const struct sockaddr_in6& client_addr,
+    string& output)
+{
+    common::print_log(server_address, client_addr, message, print_mutex);
+    mux::encode(output, id, frame != nullptr ? *frame : message);
+    metrics::increment(metrics::Counter::MESSAGES_SENT);
+}
+
+void Serwer::close_channel(Channel& channel, const string& error_message,
+    bool b_was_ended_by_server)
+{
+    if (channel.seat == Seat::NONE) { return; }
+    close_thread(error_message, {}, channel.seat, true,
+        b_was_ended_by_server);
+    channel.seat = Seat::NONE;
+}
+
+int16_t Serwer::open_channel(Channel& channel, uint8_t id, int32_t mux_fd,
+    const string& iam, const struct sockaddr_in6& client_addr,
+    uint64_t opened_at, string& output)
+{
+    if (!regex::IAM_check(iam))
+    {
+        common::print_error("Client send invalid message.", print_mutex);
+        return -1;
+    }
+    metrics::record_since(metrics::Latency::ACCEPT_TO_IAM, opened_at);
+    Seat seat = seating::from_char(iam[3]);
+    size_t index = seating::index(seat);
+    string* frame_ptr = regex::has_capability(iam, "BIN") ?
+        &channel.frame : nullptr;
+    string& msg = channel.message;
+
+    memory_mutex.lock();
+    if (seats_status[index] != -1)
+    {
+        string occupied_seats;
+        for (Seat taken : seating::ALL_SEATS)
+        {
+            if (seats_status[seating::index(taken)] != -1)
+            {
+                occupied_seats += seating::to_char(taken);
+            }
+        }
+        memory_mutex.unlock();
+        senders::send_busy(senders::NO_SOCKET, occupied_seats, msg,
+            frame_ptr);
+        queue_message(id, msg, frame_ptr, client_addr, output);
+        return 0;
+    }
+    seats_status[index] = mux_fd;
+    bot_capable[index] = regex::has_capability(iam, "BOT");
+    pre_capable[index] = regex::has_capability(iam, "PRE");
+    pre_commits[index].b_is_valid = false;
+    binary_seats[index] = frame_ptr != nullptr;
+    channel.seat = seat;
+    channel.b_was_destined_to_play = false;
+    channel.b_is_barrier = b_is_barrier_ongoing;
+    channel.b_was_queue_overflowed = false;
+
+    // Send data from the game. Nothing is written here, so the state is
+    // read in one go.
+    if (!deal[0].empty())
+    {
+        metrics::increment(metrics::Counter::RECONNECTS);
+        senders::send_deal(senders::NO_SOCKET, trick_type_global,
+            deal_starter, {deal[index].data(), deal[index].size()}, msg,
+            frame_ptr);
+        queue_message(id, msg, frame_ptr, client_addr, output);
+        for (size_t i = 0; i < taken_tricks.size(); ++i)
+        {
+            senders::send_taken(senders::NO_SOCKET, i + 1,
+                {taken_tricks[i].data(), taken_tricks[i].size()},
+                taken_takers[i], msg, frame_ptr);
+            queue_message(id, msg, frame_ptr, client_addr, output);
+        }
+        if (player_turn == seat)
+        {
+            channel.b_was_destined_to_play = true;
+            array<string, 4> table_loc;
+            size_t table_size = copy_cards_on_table(table_loc);
+            trick_sent_at[index] = metrics::now();
+            channel.resend_at = trick_sent_at[index] + timeout * 1000000ull;
+            senders::send_trick(senders::NO_SOCKET, trick_number,
+                {table_loc.data(), table_size}, msg, frame_ptr);
+            queue_message(id, msg, frame_ptr, client_addr, output);
+        }
+    }
+    memory_mutex.unlock();
+    return 1;
+}
+
+int16_t Serwer::read_channel(Channel& channel, uint8_t id,
+    const ParsedMessage& parsed, int16_t current_trick,
+    const struct sockaddr_in6& client_addr, string& output)
+{
+    size_t index = seating::index(channel.seat);
+    if (!parsed.b_is_valid)
+    {
+        // Invalid message, close the channel.
+        close_channel(channel, "Client send invalid message.");
+        return -1;
+    }
+    if (channel.b_was_destined_to_play)
+    {
+        memory_mutex.lock();
+        channel.resend_at = metrics::now() + timeout * 1000000ull;
+        bool b_was_played = parsed.trick_number == current_trick &&
+            play_card(channel.seat, parsed.card);
+        memory_mutex.unlock();
+        if (b_was_played)
+        {
+            channel.b_was_destined_to_play = false;
+            if (report_card({}, channel.seat) < 0)
+            {
+                channel.seat = Seat::NONE;
+                return -1;
+            }
+            return 0;
+        }
+    }
+    else if (pre_capable[index] &&
+        (parsed.trick_number == current_trick ||
+        parsed.trick_number == current_trick + 1))
+    {
+        // Card for the upcoming turn of the seat, see parse_message.
+        pre_commits[index] = parsed;
+        return 0;
+    }
+
+    // Wrong card, or a message out of order.
+    metrics::increment(metrics::Counter::WRONGS);
+    string* frame_ptr = binary_seats[index] ? &channel.frame : nullptr;
+    senders::send_wrong(senders::NO_SOCKET, current_trick, channel.message,
+        frame_ptr);
+    queue_message(id, channel.message, frame_ptr, client_addr, output);
+    return 0;
+}
+
+int16_t Serwer::notify_channel(Channel& channel, uint8_t id,
+    const string& server_message, const struct sockaddr_in6& client_addr,
+    string& output)
+{
+    Seat seat = channel.seat;
+    size_t index = seating::index(seat);
+    string* frame_ptr = binary_seats[index] ? &channel.frame : nullptr;
+    string& msg = channel.message;
+    array<string, 4> table_loc;
+
+    if (server_message == CARD_PLAY)
+    {
+        // Server wants the client to play a card.
+        memory_mutex.lock();
+        size_t table_size = copy_cards_on_table(table_loc);
+        int16_t current_trick = trick_number;
+        memory_mutex.unlock();
+        int16_t pre_result = play_pre_commit({}, seat, current_trick);
+        if (pre_result < 0)
+        {
+            channel.seat = Seat::NONE;
+            return -1;
+        }
+        // No TRICK if the card sent ahead was played.
+        channel.b_was_destined_to_play = pre_result == 0;
+        if (channel.b_was_destined_to_play)
+        {
+            TRACE_SPAN("send_trick", current_trick, seating::to_char(seat));
+            trick_sent_at[index] = metrics::now();
+            channel.resend_at = trick_sent_at[index] +
+                timeout * 1000000ull;
+            senders::send_trick(senders::NO_SOCKET, current_trick,
+                {table_loc.data(), table_size}, msg, frame_ptr);
+            queue_message(id, msg, frame_ptr, client_addr, output);
+        }
+    }
+    else if (server_message == DEAL)
+    {
+        // Server wants the client to play a deal.
+        TRACE_SPAN("send_deal", -1, seating::to_char(seat));
+        // Cards sent ahead belong to the previous deal.
+        pre_commits[index].b_is_valid = false;
+        array<string, 13> hand_loc;
+        memory_mutex.lock();
+        const cards_t& hand = cards[index];
+        size_t hand_size = std::min(hand.size(), hand_loc.size());
+        std::copy_n(hand.begin(), hand_size, hand_loc.begin());
+        Seat seat_loc = last_taker;
+        int16_t trick_loc = trick_type_global;
+        memory_mutex.unlock();
+        senders::send_deal(senders::NO_SOCKET, trick_loc, seat_loc,
+            {hand_loc.data(), hand_size}, msg, frame_ptr);
+        queue_message(id, msg, frame_ptr, client_addr, output);
+    }
+    else if (server_message == DISCONNECTED)
+    {
+        // Server wants the client to disconnect.
+        close_channel(channel, "", true);
+        return -1;
+    }
+    else if ((server_message == TAKEN ||
+        server_message == TAKEN_AND_TRICK) && !has_taken_trick())
+    {
+        // Left in the pipe of a vacant seat before the deal was reset;
+        // the player caught up in open_channel.
+    }
+    else if (server_message == TAKEN || server_message == TAKEN_AND_TRICK)
+    {
+        // On a bot table the next trick may have started, the taken
+        // trick is the last one stored.
+        memory_mutex.lock();
+        Seat taker_loc{taken_takers.back()};
+        int16_t taken_loc = taken_tricks.size();
+        const cards_t& taken_cards = taken_tricks.back();
+        size_t taken_size = std::min(taken_cards.size(), table_loc.size());
+        std::copy_n(taken_cards.begin(), taken_size, table_loc.begin());
+        memory_mutex.unlock();
+        TRACE_SPAN("send_taken", taken_loc, seating::to_char(seat));
+        if (server_message == TAKEN)
+        {
+            senders::send_taken(senders::NO_SOCKET, taken_loc,
+                {table_loc.data(), taken_size}, taker_loc, msg, frame_ptr);
+            queue_message(id, msg, frame_ptr, client_addr, output);
+            return 0;
+        }
+
+        // Bot table: this seat took the trick and leads the next one,
+        // nobody has played in it yet.
+        trick_sent_at[index] = metrics::now();
+        senders::send_taken_and_trick(senders::NO_SOCKET, taken_loc,
+            {table_loc.data(), taken_size}, seat, {}, msg,
+            channel.trick_message, frame_ptr);
+        common::print_log(server_address, client_addr, msg, print_mutex);
+        common::print_log(server_address, client_addr,
+            channel.trick_message, print_mutex);
+        if (frame_ptr != nullptr) { mux::encode(output, id, *frame_ptr); }
+        else
+        {
+            mux::encode(output, id, msg);
+            mux::encode(output, id, channel.trick_message);
+        }
+        metrics::increment(metrics::Counter::MESSAGES_SENT);
+        metrics::increment(metrics::Counter::MESSAGES_SENT);
+        channel.b_was_destined_to_play = true;
+        channel.resend_at = trick_sent_at[index] + timeout * 1000000ull;
+    }
+    else if (server_message == SCORES)
+    {
+        memory_mutex.lock();
+        TRACE_SPAN("send_score", -1, seating::to_char(seat));
+        array<int32_t, 4> round_scores_loc{round_scores};
+        array<int32_t, 4> total_scores_loc{total_scores};
+        memory_mutex.unlock();
+        senders::send_score(senders::NO_SOCKET, round_scores_loc, msg,
+            frame_ptr);
+        queue_message(id, msg, frame_ptr, client_addr, output);
+        senders::send_total(senders::NO_SOCKET, total_scores_loc, msg,
+            frame_ptr);
+        queue_message(id, msg, frame_ptr, client_addr, output);
+    }
+    else if (server_message == BARRIER_RESPONSE)
+    {
+        channel.b_is_barrier = true;
+        memory_mutex.lock();
+        ++occupied;
+        int16_t local_occ = occupied;
+        memory_mutex.unlock();
+        if (local_occ == 4 && common::write_to_pipe(server_read_pipes
+            [index][1], BARRIER_RESPONSE) != 1)
+        {
+            close_channel(channel, "Failed to notify server.");
+            return -1;
+        }
+    }
+    else if (server_message == BARRIER_END)
+    {
+        channel.b_is_barrier = false;
+        channel.b_was_queue_overflowed = false;
+        memory_mutex.lock();
+        int16_t current_trick = trick_number;
+        memory_mutex.unlock();
+        while (!barrier_messages[index].empty())
+        {
+            ParsedMessage message{barrier_messages[index].front()};
+            barrier_messages[index].pop();
+            if (read_channel(channel, id, message, current_trick,
+                client_addr, output) < 0) { return -1; }
+        }
+    }
+    else
+    {
+        // Invalid message, close the channel.
+        close_channel(channel, "Server send invalid message.");
+        return -1;
+    }
+    return 0;
+}
+
+void Serwer::serve_channels(int32_t mux_fd,
+    const struct sockaddr_in6& client_addr, const string& hello,
+    uint64_t accepted_at)
+{
+    tracing::set_thread_name("mux");
+    // Channels carry bots, small writes must not wait. The thread does
+    // not wait for the socket either, what it does not take stays in
+    // output until it does.
+    int32_t flag = 1;
+    setsockopt(mux_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    fcntl(mux_fd, F_SETFL, fcntl(mux_fd, F_GETFL) | O_NONBLOCK);
+    string output = MUX_HELLO;
+    common::print_log(server_address, client_addr, output, print_mutex);
+
+    map<uint8_t, Channel> channels;
+    auto add_channel = [&](uint8_t id) -> Channel&
+    {
+        return channels.try_emplace(id, Channel{Seat::NONE, "", false,
+            false, false, 0, "", "", ""}).first->second;
+    };
+    auto end_channel = [&](auto iter)
+    {
+        mux::encode_close(output, iter->first);
+        return channels.erase(iter);
+    };
+
+    // Seats named in the hello, each with all of its capabilities.
+    size_t seats_end = hello.find_first_of("+\r", 3);
+    string capabilities = hello.substr(seats_end,
+        hello.size() - 2 - seats_end);
+    for (size_t i = 3; i < seats_end; ++i)
+    {
+        uint8_t id = i - 3;
+        string iam = "IAM" + string(1, hello[i]) + capabilities + DELIMETER;
+        if (open_channel(add_channel(id), id, mux_fd, iam, client_addr,
+            accepted_at, output) < 1) { end_channel(channels.find(id)); }
+    }
+
+    // Takes the complete messages of the channel; the first one is its
+    // IAM. Returns false if the channel has to be closed.
+    string received;
+    string text;
+    auto read_messages = [&](uint8_t id, Channel& channel,
+        int16_t current_trick, uint64_t read_at)
+    {
+        size_t position = 0;
+        int16_t result;
+        while ((result = frames::next_message(channel.input, position,
+            channel.seat != Seat::NONE &&
+            binary_seats[seating::index(channel.seat)], received)) > 0)
+        {
+            metrics::increment(metrics::Counter::MESSAGES_RECEIVED);
+            if (channel.seat == Seat::NONE)
+            {
+                common::print_log(client_addr, server_address, received,
+                    print_mutex);
+                if (open_channel(channel, id, mux_fd, received, client_addr,
+                    read_at, output) < 1) { return false; }
+                continue;
+            }
+            ALLOC_STATS_THREAD_SCOPE(alloc_stats::Scope::RECEIVE);
+            TRACE_SPAN("receive", current_trick,
+                seating::to_char(channel.seat));
+            ParsedMessage parsed{};
+            if (binary_seats[seating::index(channel.seat)])
+            {
+                // The frame is logged as the text it stands for.
+                parsed = extract_frame(received, text);
+                common::print_log(client_addr, server_address, text,
+                    print_mutex);
+            }
+            else
+            {
+                common::print_log(client_addr, server_address, received,
+                    print_mutex);
+                parsed = extract_message(received);
+            }
+            if (!channel.b_is_barrier)
+            {
+                if (read_channel(channel, id, parsed, current_trick,
+                    client_addr, output) < 0) { return false; }
+                continue;
+            }
+            size_t index = seating::index(channel.seat);
+            memory_mutex.lock();
+            bool b_was_pushed = barrier_messages[index].push(parsed);
+            memory_mutex.unlock();
+            // Overflow policy of client_poll.
+            if (!b_was_pushed && !channel.b_was_queue_overflowed)
+            {
+                common::print_error(string("Barrier queue of ") +
+                    seating::to_char(channel.seat) +
+                    " is full, dropping messages.", print_mutex);
+                channel.b_was_queue_overflowed = true;
+            }
+        }
+        channel.input.erase(0, position);
+        if (result < 0)
+        {
+            close_channel(channel, "Client send invalid message.");
+            return false;
+        }
+        return true;
+    };
+
+    // Writes what the socket takes now. Returns false on an error.
+    auto flush = [&]()
+    {
+        while (!output.empty())
+        {
+            ssize_t written = write(mux_fd, output.data(), output.size());
+            if (written < 0 && errno == EINTR) { continue; }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return true;
+            }
+            if (written <= 0) { return false; }
+            journal::count_sent(written);
+            output.erase(0, written);
+        }
+        return true;
+    };
+
+    string input;
+    char buffer[4096];
+    string server_message;
+    array<string, 4> table_loc;
+    vector<struct pollfd> poll_descriptors;
+    vector<uint8_t> polled_channels;
+    bool b_is_client_gone = !flush();
+    // Once the server closes, the seats are told to leave and the
+    // connection ends when they have.
+    bool b_is_closing = false;
+    while (!b_is_client_gone && !(b_is_closing && channels.empty()))
+    {
+        memory_mutex.lock();
+        int16_t current_trick = trick_number;
+        bool b_is_barrier_loc = b_is_barrier_ongoing;
+        // Bots do not lose messages, a TRICK is never resent to them.
+        bool b_has_timers = !b_is_fast_table;
+        memory_mutex.unlock();
+
+        uint64_t current = metrics::now();
+        int32_t poll_timeout = -1;
+        // A negative fd is skipped by poll.
+        poll_descriptors.assign({{mux_fd, (short)(output.empty() ? POLLIN :
+            POLLIN | POLLOUT), 0},
+            {b_is_closing ? -1 : mux_close_pipe[0], POLLIN, 0}});
+        polled_channels.clear();
+        for (auto iter = channels.begin(); iter != channels.end();)
+        {
+            auto& [id, channel] = *iter;
+            if (channel.seat == Seat::NONE)
+            {
+                // Its IAM did not come whole yet.
+                if (b_is_closing) { iter = end_channel(iter); }
+                else { ++iter; }
+                continue;
+            }
+            size_t index = seating::index(channel.seat);
+            if (b_is_barrier_loc) { channel.b_is_barrier = true; }
+            bool b_is_open = true;
+            while (b_is_open && !channel.b_is_barrier &&
+                !barrier_messages[index].empty())
+            {
+                ParsedMessage message{barrier_messages[index].front()};
+                barrier_messages[index].pop();
+                b_is_open = read_channel(channel, id, message,
+                    current_trick, client_addr, output) == 0;
+            }
+            if (!channel.b_is_barrier)
+            {
+                channel.b_was_queue_overflowed = false;
+            }
+            if (!b_is_open)
+            {
+                iter = end_channel(iter);
+                continue;
+            }
+
+            if (b_has_timers && channel.b_was_destined_to_play)
+            {
+                if (current >= channel.resend_at)
+                {
+                    if (!channel.b_is_barrier)
+                    {
+                        memory_mutex.lock();
+                        size_t table_size = copy_cards_on_table(table_loc);
+                        memory_mutex.unlock();
+                        metrics::increment(metrics::Counter::RESENDS);
+                        string* frame_ptr = binary_seats[index] ?
+                            &channel.frame : nullptr;
+                        senders::send_trick(senders::NO_SOCKET,
+                            current_trick, {table_loc.data(), table_size},
+                            channel.message, frame_ptr);
+                        queue_message(id, channel.message, frame_ptr,
+                            client_addr, output);
+                    }
+                    channel.resend_at = current + timeout * 1000000ull;
+                }
+                int32_t left = (channel.resend_at - current) / 1000000 + 1;
+                if (poll_timeout < 0 || left < poll_timeout)
+                {
+                    poll_timeout = left;
+                }
+            }
+            poll_descriptors.push_back({server_write_pipes[index][0],
+                POLLIN, 0});
+            polled_channels.push_back(id);
+            ++iter;
+        }
+
+        if (poll(poll_descriptors.data(), poll_descriptors.size(),
+            poll_timeout) < 0)
+        {
+            if (errno == EINTR) { continue; }
+            common::print_error("Failed to poll channels.", print_mutex);
+            break;
+        }
+        if (poll_descriptors[1].revents & POLLIN) { b_is_closing = true; }
+
+        if (poll_descriptors[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            for (;;)
+            {
+                ssize_t bytes_read = read(mux_fd, buffer, sizeof(buffer));
+                if (bytes_read < 0 && errno == EINTR) { continue; }
+                if (bytes_read < 0 &&
+                    (errno == EAGAIN || errno == EWOULDBLOCK)) { break; }
+                if (bytes_read <= 0)
+                {
+                    b_is_client_gone = true;
+                    break;
+                }
+                input.append(buffer, bytes_read);
+                if (!journal_path.empty())
+                {
+                    journal_writer.record_data(string(buffer, bytes_read));
+                }
+            }
+            uint64_t read_at = metrics::now();
+            size_t position = 0;
+            uint8_t id;
+            std::string_view payload;
+            while (mux::next_frame(input, position, id, payload))
+            {
+                auto iter = channels.find(id);
+                if (payload.empty())
+                {
+                    // The client closed the channel.
+                    if (iter != channels.end())
+                    {
+                        close_channel(iter->second, "Client disconnected.");
+                        channels.erase(iter);
+                    }
+                    continue;
+                }
+                // A seat whose IAM comes now would not get DISCONNECTED.
+                if (iter == channels.end() && b_is_closing) { continue; }
+                Channel& channel = add_channel(id);
+                channel.input.append(payload);
+                if (!read_messages(id, channel, current_trick, read_at))
+                {
+                    end_channel(channels.find(id));
+                }
+            }
+            input.erase(0, position);
+        }
+
+        for (size_t i = 0; i < polled_channels.size(); ++i)
+        {
+            const struct pollfd& descriptor = poll_descriptors[i + 2];
+            if (!(descriptor.revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            // The client may have closed, or even reopened, the channel.
+            auto iter = channels.find(polled_channels[i]);
+            if (iter == channels.end() || iter->second.seat == Seat::NONE ||
+                server_write_pipes[seating::index(iter->second.seat)][0] !=
+                descriptor.fd) { continue; }
+            server_message.clear();
+            if (common::read_from_pipe(descriptor.fd, server_message) <= 0)
+            {
+                close_channel(iter->second,
+                    "Failed to read from server pipe.");
+                end_channel(iter);
+            }
+            else if (notify_channel(iter->second, iter->first,
+                server_message, client_addr, output) < 0)
+            {
+                end_channel(iter);
+            }
+        }
+
+        if (!flush()) { b_is_client_gone = true; }
+        else if (output.size() > MUX_OUTPUT_LIMIT)
+        {
+            common::print_error("Multiplexed client does not read.",
+                print_mutex);
+            b_is_client_gone = true;
+        }
+    }
+
+    for (auto iter = channels.begin(); iter != channels.end();)
+    {
+        close_channel(iter->second, "Client disconnected.");
+        iter = end_channel(iter);
+    }
+    // What is left, SCORE and TOTAL at the end of the game, gets as long
+    // as a TRICK would to go out.
+    while (!b_is_client_gone && !output.empty())
+    {
+        struct pollfd descriptor{mux_fd, POLLOUT, 0};
+        if (poll(&descriptor, 1, timeout) <= 0 || !flush()) { break; }
+    }
+    close_fds({mux_fd});
+}
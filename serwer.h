@@ -16,12 +16,21 @@
 #include <initializer_list>
 #include <algorithm>
 #include <signal.h>
+#include <netinet/tcp.h>
 
 #include "common.h"
 #include "regex.h"
 #include "senders.h"
 #include "file_reader.h"
 #include "points_calculator.h"
+#include "ring_buffer.h"
+#include "seat.h"
+#include "deal_arena.h"
+#include "metrics.h"
+#include "journal.h"
+#include "game_log.h"
+#include "frames.h"
+#include "mux.h"
 #include <sys/time.h>
 
 using std::thread;
@@ -38,12 +47,36 @@ using std::system_error;
 using std::stoi;
 
 using poll_size = vector<struct pollfd>::size_type;
+// Containers of the per-deal state, they allocate from the deal arena.
+using cards_t = std::pmr::vector<string>;
+
+// Messages stored per seat while a barrier is ongoing; must be a power
+// of two. Anything above that is dropped, see client_poll.
+#define BARRIER_QUEUE_SIZE 8
+// Bytes a multiplexed connection may have waiting for the socket; a client
+// that reads slower than the game goes is dropped past that.
+#define MUX_OUTPUT_LIMIT (1 << 20)
+
+/*
+* TRICK message received from a client, already checked against the regex
+* and split into parts. Fixed size, so it can be stored without allocating.
+*/
+struct ParsedMessage
+{
+    bool b_is_valid;
+    int16_t trick_number;
+    char card[4]; // Null-terminated, the longest card is "10H".
+};
 
 class Serwer
 {
 public:
     Serwer() = delete;
-    Serwer(int32_t port, int32_t timeout, const std::string& game_file_name);
+    Serwer(int32_t port, int32_t timeout, const std::string& game_file_name,
+        const std::string& metrics_path = "",
+        const std::string& journal_path = "",
+        const std::string& game_log_path = "", int32_t bot_grace = -1,
+        bool b_is_bot_table = false);
     ~Serwer();
 
     /*
@@ -60,10 +93,91 @@ public:
 
 private:
     /*
-    * Function that runs a logic for one deal.
+    * Function that runs a logic for one deal. A resumed deal continues
+    * from the state rebuilt by recover_game, without sending DEAL.
     * Returns 0 if successful, -1 otherwise.
     */
-    int16_t run_deal(int16_t trick_type, const string& seat);
+    int16_t run_deal(int16_t trick_type, Seat seat,
+        const array<string, 4>& raw_cards, bool b_is_resumed = false);
+
+    /*
+    * Sets up the state of a new deal from the game file.
+    * Must be called with memory_mutex locked.
+    */
+    void setup_deal(int16_t trick_type, Seat seat,
+        const array<string, 4>& raw_cards);
+
+    /*
+    * Rebuilds the game from the game log, if there is one, and opens
+    * the log for writing. Called before any thread is started.
+    * Returns 0 if successful, -1 otherwise.
+    */
+    int16_t recover_game();
+
+    /*
+    * Replays the records of the deal in progress on top of its setup.
+    * Returns 0 if successful, -1 if they do not fit the game file.
+    */
+    int16_t replay_deal(const vector<game_log::Event>& events);
+
+    /*
+    * Lets the server play every seat that has been vacant for longer
+    * than the grace period, so the table does not wait for a reconnect.
+    * Must be called with memory_mutex locked, by the main thread.
+    */
+    void substitute_bots();
+
+    /*
+    * Gives back to the players the seats they reclaimed from the bot.
+    * Called where the next message of the game is about to be sent, so
+    * a reclaimed seat gets it. Must be called with memory_mutex locked,
+    * by the main thread.
+    */
+    void reclaim_bot_seats();
+
+    /*
+    * Plays a legal card from the hand of a seat played by the bot:
+    * the first card of the led color, otherwise the last one.
+    * Must be called with memory_mutex locked.
+    */
+    void play_bot_card(Seat seat);
+
+    /*
+    * Sends a message to the thread of the seat, unless the bot plays it.
+    * Returns 0 if successful, -1 otherwise.
+    */
+    int16_t notify_seat(size_t seat_index, const string& message);
+
+    /*
+    * Decides if the table runs the fast path of bot tables: forced on
+    * the command line, or every seat is a bot. Must be called with
+    * memory_mutex locked, by the main thread.
+    */
+    void update_fast_table();
+
+    /*
+    * Checks if a trick was taken in the current deal.
+    */
+    bool has_taken_trick();
+
+    /*
+    * Empties every container of the per-deal state and releases
+    * the deal arena in one step. Must be called with memory_mutex locked.
+    */
+    void reset_deal_state();
+
+    /*
+    * With ALLOC_STATS, writes the allocations of the current deal made
+    * through the arena and the ones that went over its buffer.
+    */
+    void report_deal_arena();
+
+    /*
+    * Copies the cards lying on the table into the given array without
+    * allocating. Must be called with memory_mutex locked.
+    * Returns the number of copied cards.
+    */
+    size_t copy_cards_on_table(array<string, 4>& destination);
 
     /*
     * Utility function to handle barriers; they occur
@@ -82,18 +196,53 @@ private:
     /*
     * Used by the new client to check if the seat is available.
     * If so, it reserves it and returns 1, 0 if there is no seat,
-    * -1 on error.
+    * 2 if the client multiplexes seats over the connection (its hello
+    * is left in message), -1 on error.
     */
-    int16_t reserve_spot(int client_fd, string& seat,
+    int16_t reserve_spot(int client_fd, Seat& seat,
         const struct sockaddr_in6& client_addr,
-        bool& b_is_my_turn, bool& b_is_barrier);
+        bool& b_is_my_turn, bool& b_is_barrier, uint64_t accepted_at,
+        string& message);
+
+    /*
+    * Checks if the message is a valid TRICK message and extracts
+    * the trick number and the card from it.
+    */
+    ParsedMessage extract_message(const string& message);
+
+    /*
+    * Same as above, for a TRICK in a binary frame; also writes the text
+    * of the message, for the logs.
+    */
+    ParsedMessage extract_frame(const string& frame, string& message);
+
+    /*
+    * Checks that the seat holds the card and follows the led color if it
+    * can; if so, moves the card to the table. Must be called with
+    * memory_mutex locked. Returns true if the card was played.
+    */
+    bool play_card(Seat seat, const string& card);
+
+    /*
+    * Tells the main thread that the seat played a card.
+    * Returns 0 if successful, -1 otherwise; the seat is released then.
+    */
+    int16_t report_card(const initializer_list<int32_t>& fds, Seat seat);
+
+    /*
+    * Plays the card the seat pre-committed for the current trick, if it
+    * is still legal. Returns 1 if it was played, 0 if the seat has to
+    * get a TRICK, -1 on error (the seat is released).
+    */
+    int16_t play_pre_commit(const initializer_list<int32_t>& fds, Seat seat,
+        int16_t current_trick);
 
     /*
     * Used by the client to check if he received a TRICK message.
     * Returns -1 on error otherwise 0.
     */
-    int16_t parse_message(string& message, int32_t client_fd,
-        const string& seat, const struct sockaddr_in6& client_addr,
+    int16_t parse_message(const ParsedMessage& message, int32_t client_fd,
+        Seat seat, const struct sockaddr_in6& client_addr,
         bool& b_was_destined_to_play, int16_t current_trick,
         int32_t& timeout_copy);
 
@@ -101,7 +250,7 @@ private:
     * Used by the client thread to wathc for messages from the server
     * and main server thread. Returns -1 on error, 0 otherwise.
     */
-    int16_t client_poll(int32_t client_fd, const string& seat,
+    int16_t client_poll(int32_t client_fd, Seat seat,
         const struct sockaddr_in6& client_addr, bool b_is_my_turn,
         bool b_is_barrier);
 
@@ -110,14 +259,88 @@ private:
     * client_poll if the first one was successful.
     */
     void handle_client(int32_t client_fd, struct sockaddr_in6 client_addr,
-        uint64_t thread_id);
+        uint64_t thread_id, uint64_t accepted_at);
+
+    /*
+    * Seat played on a channel of a multiplexed connection, with what
+    * client_poll keeps in its locals for a connection of its own.
+    */
+    struct Channel
+    {
+        // Seat::NONE until the channel has taken one.
+        Seat seat;
+        // Bytes of the channel not yet split into messages.
+        string input;
+        bool b_was_destined_to_play;
+        bool b_is_barrier;
+        bool b_was_queue_overflowed;
+        // When the TRICK is sent again, as metrics::now().
+        uint64_t resend_at;
+        // Buffers reused by every message, so they allocate only once.
+        string message;
+        string trick_message;
+        string frame;
+    };
+
+    /*
+    * Plays every seat of a multiplexed connection from the thread of
+    * the connection: channel frames go straight into the state of their
+    * seats, and what the main thread tells the seats is queued as
+    * channel frames and written without blocking, so a seat whose
+    * messages wait does not hold up the others. Ends when the client
+    * leaves or the server closes.
+    */
+    void serve_channels(int32_t mux_fd, const struct sockaddr_in6&
+        client_addr, const string& hello, uint64_t accepted_at);
+
+    /*
+    * Takes the seat of the IAM for the channel as reserve_spot does,
+    * queueing what the seat missed of the deal, or BUSY.
+    * Returns 1 if the seat was taken, 0 if it is busy, -1 if the IAM is
+    * not valid.
+    */
+    int16_t open_channel(Channel& channel, uint8_t id, int32_t mux_fd,
+        const string& iam, const struct sockaddr_in6& client_addr,
+        uint64_t opened_at, string& output);
+
+    /*
+    * Handles the TRICK of a channel as parse_message does for
+    * a connection. Returns -1 if the channel has to be closed, 0 otherwise.
+    */
+    int16_t read_channel(Channel& channel, uint8_t id,
+        const ParsedMessage& parsed, int16_t current_trick,
+        const struct sockaddr_in6& client_addr, string& output);
+
+    /*
+    * Handles a message of the main thread to the seat of the channel as
+    * client_poll does. Returns -1 if the channel has to be closed,
+    * 0 otherwise.
+    */
+    int16_t notify_channel(Channel& channel, uint8_t id,
+        const string& server_message, const struct sockaddr_in6&
+        client_addr, string& output);
+
+    /*
+    * Logs the message and queues it, or the frame if there is one, on
+    * the channel.
+    */
+    void queue_message(uint8_t id, const string& message,
+        const string* frame, const struct sockaddr_in6& client_addr,
+        string& output);
+
+    /*
+    * Releases the seat of the channel, if it has one, as close_thread
+    * does for a connection.
+    */
+    void close_channel(Channel& channel, const string& error_message,
+        bool b_was_ended_by_server = false);
 
     /*
     * Utility function to close a thread (client or connection_handler,
     * depending on the arguments).
     */
     void close_thread(const string& error_message,
-        const initializer_list<int>& fds, const string& seat,
+        const initializer_list<int>& fds, Seat seat,
         bool b_was_occupying, bool b_was_ended_by_server);
 
     /*
@@ -137,7 +360,7 @@ private:
     * closes the thread that failed and returns -1.
     */
     int16_t assert_client_read_socket(ssize_t result,
-        const initializer_list<int32_t>& fds, const string& seat,
+        const initializer_list<int32_t>& fds, Seat seat,
         bool b_was_occupying);
 
     /*
@@ -145,7 +368,7 @@ private:
     * closes the thread that failed and returns -1.
     */
     int16_t assert_client_write_socket(ssize_t result, ssize_t expected,
-        const initializer_list<int32_t>& fds, const string& seat,
+        const initializer_list<int32_t>& fds, Seat seat,
         bool b_was_occupying);
 
     /*
@@ -153,7 +376,7 @@ private:
     * closes the thread that failed and returns -1.
     */
     int16_t assert_client_read_pipe(ssize_t result,
-        const initializer_list<int32_t>& fds, const string& seat,
+        const initializer_list<int32_t>& fds, Seat seat,
         bool b_was_occupying);
 
     /*
@@ -161,7 +384,7 @@ private:
     * closes the thread that failed and returns -1.
     */  
     int16_t assert_client_write_pipe(ssize_t result,
-        const initializer_list<int32_t>& fds, const string& seat,
+        const initializer_list<int32_t>& fds, Seat seat,
         bool b_was_occupying);
 
     /*
@@ -188,49 +411,110 @@ private:
     map<uint64_t, thread> client_threads;
     vector<uint64_t> joinable_threads;
 
-    mutex memory_mutex;
-    mutex print_mutex;
+    ProfiledMutex memory_mutex;
+    ProfiledMutex print_mutex;
 
     int32_t port;
     int32_t timeout;
     string game_file_name;
 
+    // Empty if the metrics socket is disabled.
+    string metrics_path;
+    metrics::MetricsServer metrics_server;
+
+    // Empty if the network input is not recorded.
+    string journal_path;
+    journal::JournalWriter journal_writer;
+
+    // Empty if the game state is not logged.
+    string game_log_path;
+    game_log::GameLog game_log;
+    // Deals of the game file already played; used by the main thread only.
+    uint64_t deals_finished;
+    // Set by recover_game when the first deal to run is half-played.
+    bool b_is_deal_resumed;
+
+    // Milliseconds a seat stays vacant before the bot plays it, -1 if
+    // disabled.
+    int32_t bot_grace;
+    // Seats played by the bot; written by the main thread only.
+    array<bool, 4> bot_seats;
+    // When each seat was left by its player, 0 if never; protected by
+    // memory_mutex.
+    array<uint64_t, 4> vacant_since;
+
+    // Bot-table mode forced on the command line.
+    bool b_is_bot_table;
+    // Seats whose player announced the BOT capability in IAM; protected
+    // by memory_mutex.
+    array<bool, 4> bot_capable;
+    // Fast path of bot tables: TAKEN and the next TRICK go in one write,
+    // TRICK is never resent and there is no barrier after a trick unless
+    // a seat dropped. Set by the main thread at the start of every trick;
+    // protected by memory_mutex.
+    bool b_is_fast_table;
+
+    // Seats whose player announced the PRE capability, and the TRICK each
+    // of them sent ahead of its turn. Reset in reserve_spot or
+    // open_channel, under memory_mutex, by the thread taking the seat;
+    // then used without the mutex only by that thread. A thread releases
+    // its seat under the mutex and touches them no more, so the next one
+    // sees them whole.
+    array<bool, 4> pre_capable;
+    array<ParsedMessage, 4> pre_commits;
+    // Seats whose player announced the BIN capability and talks in binary
+    // frames; owned like pre_capable.
+    array<bool, 4> binary_seats;
+
     thread connection_manager_thread;
 
     int16_t occupied;
-    map<string, int32_t> seats_status;
+    // Client socket of every seat (the multiplexed one for a channel), -1
+    // if the seat is free.
+    array<int32_t, 4> seats_status;
 
     // 0 - read; 1 - write
     array<int32_t[2], 5> server_read_pipes;
     array<int32_t[2], 5> server_write_pipes;
-
-    map<string, int16_t> seats_to_array;
+    // Written once, by close_server; the threads of multiplexed
+    // connections end when its read end becomes readable.
+    int32_t mux_close_pipe[2];
 
     string current_message;
 
-    vector<string> cards_on_table;
+    // Declared before every container that allocates from it.
+    DealArena deal_arena;
 
-    map<string, int32_t> round_scores;
-    map<string, int32_t> total_scores;
+    cards_t cards_on_table;
+
+    array<int32_t, 4> round_scores;
+    array<int32_t, 4> total_scores;
     
     int16_t trick_number;
 
-    array<vector<string>, 4> cards;
-    array<vector<string>, 4> deal;
-    vector<vector<string>> taken_tricks;
-    vector<string> taken_takers;
-    string deal_starter;
+    array<cards_t, 4> cards;
+    array<cards_t, 4> deal;
+    std::pmr::vector<cards_t> taken_tricks;
+    std::pmr::vector<Seat> taken_takers;
+    Seat deal_starter;
     int16_t trick_type_global;
-    string start_seat_global;
+    Seat start_seat_global;
 
-    string last_taker;
+    Seat last_taker;
 
-    string player_turn;
+    Seat player_turn;
 
     int16_t waiting_on_barrier;
     bool b_is_barrier_ongoing;
 
-    array<queue<string>, 4> barrier_messages;
+    // When the last TRICK was sent to each seat; used only by the thread
+    // of that seat, for the TRICK_TO_CARD latencies.
+    array<uint64_t, 4> trick_sent_at;
+    // When the last accepted card arrived, protected by memory_mutex.
+    uint64_t last_card_at;
+
+    // Hard cap on the memory used by messages received during a barrier.
+    array<RingBuffer<ParsedMessage, BARRIER_QUEUE_SIZE>, 4> barrier_messages;
 };
 
 #endif // SERWER_H
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "solver.h"
+
+#include <climits>
+
+namespace
+{
+    // Fields of the data word of an entry.
+    constexpr int32_t LOWER_SHIFT = 0;
+    constexpr int32_t UPPER_SHIFT = 16;
+    constexpr int32_t BEST_SHIFT = 32;
+
+    uint64_t mix(uint64_t value)
+    {
+        // The finalizer of splitmix64.
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    card_set_t legal_cards(card_set_t hand, uint8_t led_suit)
+    {
+        card_set_t following = hand & CardModel::suit_cards(led_suit);
+        return following != 0 ? following : hand;
+    }
+} // namespace
+
+TranspositionTable::TranspositionTable(int32_t size_log2)
+    : entries{new Entry[1ULL << size_log2]()},
+    mask{(1ULL << size_log2) - 1} {}
+
+bool TranspositionTable::probe(uint64_t key, int16_t& lower,
+    int16_t& upper, uint8_t& best) const
+{
+    const Entry& entry = entries[key & mask];
+    uint64_t check = entry.check.load(std::memory_order_relaxed);
+    uint64_t data = entry.data.load(std::memory_order_relaxed);
+    if ((check ^ data) != key) { return false; }
+    lower = (int16_t)(data >> LOWER_SHIFT);
+    upper = (int16_t)(data >> UPPER_SHIFT);
+    best = (uint8_t)(data >> BEST_SHIFT);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, int16_t lower, int16_t upper,
+    uint8_t best)
+{
+    uint64_t data = ((uint64_t)(uint16_t)lower << LOWER_SHIFT) |
+        ((uint64_t)(uint16_t)upper << UPPER_SHIFT) |
+        ((uint64_t)best << BEST_SHIFT);
+    Entry& entry = entries[key & mask];
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+Solver::Solver(TranspositionTable& table)
+    : table{table}, nodes{0}, deal_type{0}, seat{Seat::NONE}, weights{},
+    hands{}, leader{Seat::NONE}, trick{1}, on_table{0}, played{0},
+    led_suit{0}, top{NO_CARD}, taker{Seat::NONE} {}
+
+int32_t Solver::solve(const array<card_set_t, 4>& hands, Seat first,
+    int16_t deal_type, Seat seat)
+{
+    this->deal_type = deal_type;
+    this->seat = seat;
+    int32_t base = CardModel::trick_points(deal_type, 1, 0);
+    for (uint8_t card = 0; card < NO_CARD; ++card)
+    {
+        weights[card] = CardModel::trick_points(deal_type, 1, 1ULL << card) -
+            base;
+    }
+    this->hands = hands;
+    leader = first;
+    trick = 14 - __builtin_popcountll(hands[seating::index(first)]);
+    on_table = 0;
+    played = 0;
+    // Searches with null windows, each telling if the points reach
+    // a value, until the bounds meet.
+    int32_t lower = 0;
+    int32_t upper = points_left();
+    while (lower < upper)
+    {
+        int32_t value = (lower + upper + 1) / 2;
+        int32_t result = search(value - 1, value);
+        if (result >= value) { lower = result; }
+        else { upper = result; }
+    }
+    return lower;
+}
+
+uint64_t Solver::get_nodes() const { return nodes; }
+
+int32_t Solver::search(int32_t alpha, int32_t beta)
+{
+    ++nodes;
+    uint64_t key = 0;
+    int16_t lower = 0;
+    int16_t upper = SHRT_MAX;
+    uint8_t best = NO_CARD;
+    if (played == 0)
+    {
+        if (trick > 13) { return 0; }
+        int32_t left = points_left();
+        if (left == 0 || beta <= 0) { return 0; }
+        if (left <= alpha) { return left; }
+        upper = left;
+        key = position_key();
+        int16_t stored_lower;
+        int16_t stored_upper;
+        if (table.probe(key, stored_lower, stored_upper, best))
+        {
+            lower = std::max(lower, stored_lower);
+            upper = std::min(upper, stored_upper);
+            if (lower >= beta) { return lower; }
+            if (upper <= alpha) { return upper; }
+            alpha = std::max<int32_t>(alpha, lower);
+            beta = std::min<int32_t>(beta, upper);
+            if (lower == upper) { return lower; }
+        }
+    }
+
+    array<uint8_t, 13> moves;
+    size_t moves_number = order_moves(best, moves);
+    Seat mover = seating::next(leader, played);
+    bool b_minimizes = mover == seat;
+    int32_t best_value = b_minimizes ? INT_MAX : INT_MIN;
+    uint8_t best_card = NO_CARD;
+    int32_t window_alpha = alpha;
+    int32_t window_beta = beta;
+
+    for (size_t i = 0; i < moves_number; ++i)
+    {
+        uint8_t card = moves[i];
+        // What the move changes, to take it back.
+        Seat saved_leader = leader;
+        uint8_t saved_led_suit = led_suit;
+        uint8_t saved_top = top;
+        Seat saved_taker = taker;
+        card_set_t saved_table = on_table;
+
+        hands[seating::index(mover)] &= ~(1ULL << card);
+        on_table |= 1ULL << card;
+        if (played == 0)
+        {
+            led_suit = card % 4;
+            top = card;
+            taker = mover;
+        }
+        // Cards of a suit grow with the rank.
+        else if (card % 4 == led_suit && card > top)
+        {
+            top = card;
+            taker = mover;
+        }
+        ++played;
+
+        int32_t value;
+        if (played == 4)
+        {
+            int32_t points = taker == seat ?
+                CardModel::trick_points(deal_type, trick, on_table) : 0;
+            leader = taker;
+            ++trick;
+            on_table = 0;
+            played = 0;
+            value = points + search(window_alpha - points,
+                window_beta - points);
+            --trick;
+            played = 4;
+        }
+        else { value = search(window_alpha, window_beta); }
+
+        --played;
+        leader = saved_leader;
+        led_suit = saved_led_suit;
+        top = saved_top;
+        taker = saved_taker;
+        on_table = saved_table;
+        hands[seating::index(mover)] |= 1ULL << card;
+
+        if (b_minimizes ? value < best_value : value > best_value)
+        {
+            best_value = value;
+            best_card = card;
+        }
+        if (b_minimizes)
+        {
+            if (best_value <= window_alpha) { break; }
+            window_beta = std::min(window_beta, best_value);
+        }
+        else
+        {
+            if (best_value >= window_beta) { break; }
+            window_alpha = std::max(window_alpha, best_value);
+        }
+    }
+
+    if (played == 0)
+    {
+        if (best_value <= alpha) { upper = best_value; }
+        else if (best_value >= beta) { lower = best_value; }
+        else
+        {
+            lower = best_value;
+            upper = best_value;
+        }
+        table.store(key, lower, upper, best_card);
+    }
+    return best_value;
+}
+
+int32_t Solver::points_left() const
+{
+    card_set_t live = hands[0] | hands[1] | hands[2] | hands[3] | on_table;
+    int32_t base = CardModel::trick_points(deal_type, 1, 0);
+    int32_t points = CardModel::trick_points(deal_type, 1, live) - base;
+    for (int16_t left = trick; left <= 13; ++left)
+    {
+        points += CardModel::trick_points(deal_type, left, 0);
+    }
+    return points;
+}
+
+size_t Solver::order_moves(uint8_t best, array<uint8_t, 13>& moves) const
+{
+    Seat mover = seating::next(leader, played);
+    card_set_t hand = hands[seating::index(mover)];
+    card_set_t legal = played == 0 ? hand : legal_cards(hand, led_suit);
+    card_set_t live = hands[0] | hands[1] | hands[2] | hands[3] | on_table;
+    bool b_is_seat = mover == seat;
+
+    array<int32_t, 13> scores;
+    size_t moves_number = 0;
+    for (card_set_t left = legal; left != 0; left &= left - 1)
+    {
+        uint8_t card = __builtin_ctzll(left);
+        uint8_t suit = card % 4;
+        // The next lower card still in play; if the mover holds it and
+        // it is worth the same, this card plays the same.
+        card_set_t below = live & CardModel::suit_cards(suit) &
+            ((1ULL << card) - 1);
+        if (below != 0)
+        {
+            uint8_t lower = 63 - __builtin_clzll(below);
+            if (((legal >> lower) & 1) && weights[lower] == weights[card])
+            {
+                continue;
+            }
+        }
+
+        int32_t rank = card / 4;
+        int32_t weight = weights[card];
+        card_set_t seat_suit = hands[seating::index(seat)] &
+            CardModel::suit_cards(suit);
+        int32_t score;
+        if (card == best) { score = INT_MAX; }
+        else if (played == 0)
+        {
+            if (b_is_seat) { score = -rank - 16 * weight; }
+            // The others lead under the lowest card of the seat, so that
+            // it has to take the trick.
+            else if (seat_suit != 0)
+            {
+                score = (int32_t)__builtin_ctzll(seat_suit) / 4 - rank;
+            }
+            else { score = -100 - rank; }
+        }
+        else if (suit != led_suit)
+        {
+            // Points and high cards go when a suit is missing.
+            score = 16 * weight + rank;
+        }
+        else if (card < top)
+        {
+            // Under the top card: the seat keeps the trick off itself,
+            // the others leave it with the seat and add points to it.
+            score = 1000 + rank + (!b_is_seat && taker == seat ?
+                16 * weight : 0);
+        }
+        // Taking the trick: as the last, the seat plays its highest card;
+        // the others keep the top low while the seat is still to play.
+        else if (b_is_seat && played == 3) { score = rank; }
+        else { score = -rank; }
+
+        // Insertion by score, highest first.
+        size_t position = moves_number++;
+        while (position > 0 && scores[position - 1] < score)
+        {
+            scores[position] = scores[position - 1];
+            moves[position] = moves[position - 1];
+            --position;
+        }
+        scores[position] = score;
+        moves[position] = card;
+    }
+    return moves_number;
+}
+
+uint64_t Solver::position_key() const
+{
+    // Only the order of the cards in play matters, not which cards were
+    // played: the key has, suit by suit and from the lowest card, the
+    // seat holding each card in play and its points.
+    uint64_t key = mix(((uint64_t)deal_type << 8) |
+        (seating::index(seat) << 4) | seating::index(leader));
+    for (uint8_t suit = 0; suit < 4; ++suit)
+    {
+        uint64_t code = 1;
+        for (uint8_t card = suit; card < NO_CARD; card += 4)
+        {
+            for (size_t holder = 0; holder < 4; ++holder)
+            {
+                if ((hands[holder] >> card) & 1)
+                {
+                    code = code * 0x100000001B3ULL ^
+                        (holder | (weights[card] << 2));
+                    break;
+                }
+            }
+        }
+        key = mix(key ^ code);
+    }
+    return key;
+}
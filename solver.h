@@ -0,0 +1,122 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "card_model.h"
+#include "seat.h"
+
+using std::array;
+
+/*
+* Bounds of the points of positions at the start of a trick, shared by
+* any number of solvers and threads without locks: an entry is two atomic
+* words, the data and the key xored with the data, so an entry torn by
+* two writers no longer matches its key and is simply missed.
+*/
+class TranspositionTable
+{
+public:
+    TranspositionTable() = delete;
+    // The table has 2^size_log2 entries of 16 bytes.
+    explicit TranspositionTable(int32_t size_log2);
+    ~TranspositionTable() = default;
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    /*
+    * Gets the bounds and the best card stored for the key.
+    * Returns false if there are none.
+    */
+    bool probe(uint64_t key, int16_t& lower, int16_t& upper,
+        uint8_t& best) const;
+
+    void store(uint64_t key, int16_t lower, int16_t upper, uint8_t best);
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    uint64_t mask;
+};
+
+/*
+* Double-dummy solver: with every hand known, finds how few points a seat
+* can be sure to take from a deal when the three others play together
+* against it, by alpha-beta search over the cards played. Points are
+* counted as PointsCalculator counts them (CardModel::trick_points).
+*
+* Hands are card sets. Of the cards of a suit that follow each other
+* among the cards still in play and are worth the same points, only one
+* is searched, as they end any trick the same way. Cards are tried in an
+* order that finds cut-offs early, and the bounds of every position at
+* the start of a trick go to the transposition table.
+*/
+class Solver
+{
+public:
+    Solver() = delete;
+    explicit Solver(TranspositionTable& table);
+    ~Solver() = default;
+
+    /*
+    * Points the seat takes from the deal with the given hands, whatever
+    * the others do, if it plays its best; first leads the first trick.
+    */
+    int32_t solve(const array<card_set_t, 4>& hands, Seat first,
+        int16_t deal_type, Seat seat);
+
+    /*
+    * Positions searched since the solver was created.
+    */
+    uint64_t get_nodes() const;
+
+private:
+    /*
+    * Points the seat takes from the current position on; fail-soft:
+    * a result outside (alpha, beta) is only a bound.
+    */
+    int32_t search(int32_t alpha, int32_t beta);
+
+    /*
+    * Most points the seat may still take: every card and trick left.
+    */
+    int32_t points_left() const;
+
+    /*
+    * Cards of the seat to move worth searching, best first, in moves;
+    * the card from the table first, if it is one of them.
+    * Returns their number.
+    */
+    size_t order_moves(uint8_t best, array<uint8_t, 13>& moves) const;
+
+    uint64_t position_key() const;
+
+    TranspositionTable& table;
+    uint64_t nodes;
+
+    // The deal being solved.
+    int16_t deal_type;
+    Seat seat;
+    // Points of every card apart from those of the trick itself.
+    array<int16_t, NO_CARD> weights;
+
+    // The current position.
+    array<card_set_t, 4> hands;
+    Seat leader;
+    int16_t trick;
+    card_set_t on_table;
+    uint8_t played;
+    uint8_t led_suit;
+    uint8_t top;
+    Seat taker;
+};
+
+#endif // SOLVER_H
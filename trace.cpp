@@ -0,0 +1,206 @@
+#include "trace.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common.h"
+
+using std::array;
+using std::atomic;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;
+        int16_t trick;
+        char seat;
+    };
+
+    /*
+    * Written only by its thread; size is published with release
+    * so the exporter never reads a half-written event.
+    */
+    struct ThreadBuffer
+    {
+        uint32_t id = 0;
+        const char* name = nullptr;
+        char seat = 0;
+        atomic<size_t> size{0};
+        atomic<uint64_t> dropped{0};
+        array<Event, TRACE_BUFFER_EVENTS> events;
+    };
+
+    atomic<bool> b_is_enabled{false};
+    std::chrono::steady_clock::time_point epoch;
+
+    // Buffers outlive their threads, so the export sees reconnected seats.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    // Taken only when a thread records its first span and on export.
+    std::mutex registration_mutex;
+
+    thread_local ThreadBuffer* thread_buffer = nullptr;
+
+    uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    ThreadBuffer* get_buffer()
+    {
+        if (thread_buffer == nullptr)
+        {
+            std::lock_guard<std::mutex> guard(registration_mutex);
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            thread_buffer = buffers.back().get();
+            thread_buffer->id = buffers.size();
+        }
+        return thread_buffer;
+    }
+
+    void add(const Event& event)
+    {
+        ThreadBuffer* buffer = get_buffer();
+        size_t size = buffer->size.load(memory_order_relaxed);
+        if (size == TRACE_BUFFER_EVENTS)
+        {
+            buffer->dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        buffer->events[size] = event;
+        buffer->size.store(size + 1, memory_order_release);
+    }
+} // namespace
+
+void tracing::enable()
+{
+    epoch = std::chrono::steady_clock::now();
+    b_is_enabled.store(true, memory_order_release);
+}
+
+bool tracing::is_enabled()
+{
+    return b_is_enabled.load(memory_order_relaxed);
+}
+
+void tracing::set_thread_name(const char* name)
+{
+    if (is_enabled()) { get_buffer()->name = name; }
+}
+
+void tracing::set_thread_name(const char* name, char seat)
+{
+    if (is_enabled())
+    {
+        ThreadBuffer* buffer = get_buffer();
+        buffer->name = name;
+        buffer->seat = seat;
+    }
+}
+
+int16_t tracing::export_chrome_trace(const string& file_name)
+{
+    std::ofstream file(file_name);
+    if (!file.is_open())
+    {
+        common::print_error("Failed to open trace file.");
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> guard(registration_mutex);
+    char line[256];
+    uint64_t dropped = 0;
+    bool b_is_first = true;
+    file << "{\"traceEvents\":[\n";
+    for (const auto& buffer : buffers)
+    {
+        dropped += buffer->dropped.load(memory_order_relaxed);
+        if (buffer->name != nullptr)
+        {
+            if (buffer->seat != 0)
+            {
+                snprintf(line, sizeof(line), "{\"name\":\"thread_name\","
+                    "\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":"
+                    "\"%s %c\"}}", buffer->id, buffer->name, buffer->seat);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "{\"name\":\"thread_name\","
+                    "\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":"
+                    "\"%s\"}}", buffer->id, buffer->name);
+            }
+            file << (b_is_first ? "" : ",\n") << line;
+            b_is_first = false;
+        }
+
+        size_t size = buffer->size.load(memory_order_acquire);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const Event& event = buffer->events[i];
+            // Chrome expects microseconds.
+            int length = snprintf(line, sizeof(line), "{\"name\":\"%s\","
+                "\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                event.name, buffer->id, event.start / 1000.0,
+                event.duration / 1000.0);
+            if (event.trick >= 0 && event.seat != 0)
+            {
+                snprintf(line + length, sizeof(line) - length,
+                    ",\"args\":{\"trick\":%d,\"seat\":\"%c\"}}",
+                    event.trick, event.seat);
+            }
+            else if (event.trick >= 0)
+            {
+                snprintf(line + length, sizeof(line) - length,
+                    ",\"args\":{\"trick\":%d}}", event.trick);
+            }
+            else if (event.seat != 0)
+            {
+                snprintf(line + length, sizeof(line) - length,
+                    ",\"args\":{\"seat\":\"%c\"}}", event.seat);
+            }
+            else { snprintf(line + length, sizeof(line) - length, "}"); }
+            file << (b_is_first ? "" : ",\n") << line;
+            b_is_first = false;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":"
+        << dropped << "}}\n";
+
+    if (!file.good())
+    {
+        common::print_error("Failed to write trace file.");
+        return -1;
+    }
+    if (dropped > 0)
+    {
+        cerr << "Trace buffers were full, " << dropped
+            << " spans were dropped.\n";
+    }
+    return 0;
+}
+
+tracing::Span::Span(const char* name, int16_t trick, char seat)
+    : name{name}, trick{trick}, seat{seat},
+    start{is_enabled() ? ::now() : 0} {}
+
+tracing::Span::~Span() { end(); }
+
+void tracing::Span::end()
+{
+    if (start == 0) { return; }
+    uint64_t finish = ::now();
+    add(Event{name, start, finish - start, trick, seat});
+    start = 0;
+}
@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+// Events kept per thread; anything above that is counted and dropped.
+#define TRACE_BUFFER_EVENTS 16384
+
+/*
+* Span tracing of the server, enabled at runtime (kierki-serwer -T <file>).
+* Every thread writes complete spans into its own fixed-size buffer without
+* locking; at exit the buffers are exported as Chrome trace-event JSON,
+* which chrome://tracing and Perfetto show as a timeline. Spans carry the
+* trick number and the seat, so one trick can be followed across threads.
+* When tracing is disabled a span costs one relaxed atomic load.
+*/
+namespace tracing
+{
+    using std::string;
+
+    /*
+    * Starts recording. Must be called before the threads that
+    * should be traced start.
+    */
+    void enable();
+
+    bool is_enabled();
+
+    /*
+    * Names the calling thread in the exported timeline.
+    * The name must be a string literal or otherwise outlive the export.
+    */
+    void set_thread_name(const char* name);
+
+    /*
+    * Same as above, with a seat letter appended ("client N").
+    */
+    void set_thread_name(const char* name, char seat);
+
+    /*
+    * Writes every recorded span to the file as Chrome trace JSON.
+    * Should be called after the traced threads are joined.
+    * Returns 0 if successful, -1 otherwise.
+    */
+    int16_t export_chrome_trace(const string& file_name);
+
+    /*
+    * Records the time between its construction and end()
+    * (or destruction) as one span of the calling thread.
+    */
+    class Span
+    {
+    public:
+        /*
+        * The name must be a string literal. Trick number and seat
+        * are optional arguments shown with the span (-1 and 0 = none).
+        */
+        explicit Span(const char* name, int16_t trick = -1, char seat = 0);
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        void end();
+
+    private:
+        const char* name;
+        int16_t trick;
+        char seat;
+        uint64_t start;
+    };
+} // namespace tracing
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/*
+* Span lasting until the end of the enclosing scope.
+*/
+#define TRACE_SPAN(...) tracing::Span \
+    TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_H
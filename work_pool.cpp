@@ -0,0 +1,117 @@
+#include "work_pool.h"
+
+#include <system_error>
+
+#include "common.h"
+
+WorkPool::WorkPool(int32_t threads)
+    : threads{threads > 0 ? threads : 1}, queues{new Queue[this->threads]},
+    steals{0} {}
+
+WorkPool::~WorkPool() { wait(); }
+
+void WorkPool::start(size_t jobs_number, Job job)
+{
+    this->job = std::move(job);
+    for (size_t index = 0; index < jobs_number; ++index)
+    {
+        queues[index % threads].jobs.push_back(index);
+    }
+    for (int32_t i = 0; i < threads; ++i)
+    {
+        try { workers.emplace_back(&WorkPool::work, this, i); }
+        catch (const std::system_error& e)
+        {
+            // Fewer threads then; the others steal the jobs of the rest.
+            common::print_error(e.what());
+            break;
+        }
+    }
+    if (workers.empty()) { work(0); }
+}
+
+void WorkPool::wait()
+{
+    for (std::thread& worker : workers) { worker.join(); }
+    workers.clear();
+    job = nullptr;
+}
+
+int32_t WorkPool::get_threads() const { return threads; }
+
+uint64_t WorkPool::get_steals() const
+{
+    return steals.load(std::memory_order_relaxed);
+}
+
+void WorkPool::work(size_t worker)
+{
+    size_t index;
+    while (next_job(worker, index)) { job(index, worker); }
+}
+
+bool WorkPool::next_job(size_t worker, size_t& index)
+{
+    {
+        Queue& own = queues[worker];
+        ProfiledLock lock(own.mutex);
+        if (!own.jobs.empty())
+        {
+            index = own.jobs.front();
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+    // No job is ever added, so queues found empty stay empty.
+    for (int32_t i = 1; i < threads; ++i)
+    {
+        Queue& victim = queues[(worker + i) % threads];
+        ProfiledLock lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            index = victim.jobs.back();
+            victim.jobs.pop_back();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+OrderedResults::OrderedResults(size_t size)
+    : results(size), b_is_put(size, false), next{0}, done{0} {}
+
+void OrderedResults::put(size_t index, string result)
+{
+    ProfiledLock lock(mutex);
+    results[index] = std::move(result);
+    b_is_put[index] = true;
+    ++done;
+    if (index == next) { next_ready.notify_one(); }
+}
+
+size_t OrderedResults::take(vector<string>& ready,
+    std::chrono::milliseconds timeout)
+{
+    ProfiledLock lock(mutex);
+    next_ready.wait_for(lock, timeout, [this]
+    {
+        return next == results.size() || b_is_put[next];
+    });
+    size_t taken = 0;
+    while (next < results.size() && b_is_put[next])
+    {
+        ready.push_back(std::move(results[next]));
+        // Frees the memory of the result.
+        string().swap(results[next]);
+        ++next;
+        ++taken;
+    }
+    return taken;
+}
+
+size_t OrderedResults::get_done()
+{
+    ProfiledLock lock(mutex);
+    return done;
+}
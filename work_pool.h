@@ -0,0 +1,116 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lock_stats.h"
+
+using std::string;
+using std::vector;
+
+/*
+* Threads running numbered jobs with work stealing. The jobs are dealt
+* round-robin to a queue per thread; a thread takes the oldest job of its
+* own queue and, once that is empty, steals the newest job of another
+* queue, so a thread left with slow jobs hands the rest over and no
+* thread idles while jobs wait. Owners work from the oldest end and
+* thieves from the newest, so jobs end roughly in the order of their
+* numbers except for the stolen ones, which run early.
+*/
+class WorkPool
+{
+public:
+    // Index of the job and of the thread running it.
+    using Job = std::function<void(size_t, size_t)>;
+
+    WorkPool() = delete;
+    explicit WorkPool(int32_t threads);
+    // Waits for the jobs.
+    ~WorkPool();
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    /*
+    * Starts running the job for every index below jobs_number and
+    * returns at once. Threads that cannot be created leave their jobs
+    * to the others; if there are none, runs every job before returning.
+    */
+    void start(size_t jobs_number, Job job);
+
+    /*
+    * Waits until every job has run.
+    */
+    void wait();
+
+    int32_t get_threads() const;
+
+    /*
+    * Jobs taken from the queue of another thread.
+    */
+    uint64_t get_steals() const;
+
+private:
+    struct Queue
+    {
+        ProfiledMutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    void work(size_t worker);
+
+    /*
+    * Takes the next job of the worker, stealing if its queue is empty.
+    * Returns false when there are no jobs left at all.
+    */
+    bool next_job(size_t worker, size_t& index);
+
+    int32_t threads;
+    std::unique_ptr<Queue[]> queues;
+    vector<std::thread> workers;
+    Job job;
+    std::atomic<uint64_t> steals;
+};
+
+/*
+* Results of numbered jobs, finished in any order, handed on in the order
+* of their numbers as soon as all the results before them are there.
+*/
+class OrderedResults
+{
+public:
+    OrderedResults() = delete;
+    explicit OrderedResults(size_t size);
+    ~OrderedResults() = default;
+
+    void put(size_t index, string result);
+
+    /*
+    * Waits at most timeout for the next result, then moves every result
+    * that is next in order to ready. Returns their number.
+    */
+    size_t take(vector<string>& ready, std::chrono::milliseconds timeout);
+
+    /*
+    * Results put so far, in any order.
+    */
+    size_t get_done();
+
+private:
+    ProfiledMutex mutex;
+    std::condition_variable_any next_ready;
+    vector<string> results;
+    vector<bool> b_is_put;
+    size_t next;
+    size_t done;
+};
+
+#endif // WORK_POOL_H